@@ -0,0 +1,353 @@
+#include "rpc/buffer_pool.h"
+#include "rpc/client.h"
+#include "rpc/histogram.h"
+#include "rpc/value.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rpc;
+
+// ======================= 程序功能说明 =======================
+// 压测工具：对一个服务端施加负载，报告吞吐与延迟分布
+//
+// 两种模式：
+//   closed：concurrency 个线程各自“发一个、等回包、再发下一个”
+//           测的是系统在固定并发下的吞吐；服务端变慢时发送也随之变慢
+//   open  ：按固定速率 rate 发送，不等回包（每条连接一个发送线程，用回调收包）
+//           延迟从“计划发送时刻”算起：发送线程落后时，排队时间也计入延迟，
+//           避免 coordinated omission（慢的时候少发请求，从而低估尾延迟）
+//
+// 选项（--key value）：
+//   --host 127.0.0.1  --port 9000
+//   --endpoint E        覆盖 host/port：unix:/path（UNIX socket）或 shm:/path（共享内存），
+//                       用于对比同机 loopback / UDS / shm 三种传输的延迟
+//   --conns 1           连接数（closed 模式下线程轮流分配到各连接）
+//   --concurrency 16    closed 模式的并发调用数
+//   --mode closed|open
+//   --rate 10000        open 模式的总发送速率（次/秒）
+//   --duration 5        统计时长（秒），之前先跑 --warmup 1 秒不计入统计
+//   --payload 64        echo 的字符串字节数 / sum 的数组字节数（add 不用）
+//   --mix add=1         方法及权重，如 add=8,echo=1,sum=1（另有 fib：fib(25)，服务端缓存）
+//   --label x           原样写入报告（如 git 提交号），便于对比
+//   --out file          报告另存一份到文件
+//
+// 输出：过程信息写 stderr；报告为一行 JSON，写在 stdout 最后一行
+//   延迟单位微秒，来自对数-线性直方图（相对误差 < 1%）
+//   client_allocs_per_req：统计窗口内本进程每个请求摊到的堆分配次数（见 rpc::heap_allocs）
+// ============================================================
+
+using clock_type = std::chrono::steady_clock;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 9000;
+    std::string endpoint;
+    int conns = 1;
+    int concurrency = 16;
+    std::string mode = "closed";
+    double rate = 10000;
+    double duration = 5;
+    double warmup = 1;
+    size_t payload = 64;
+    std::string mix = "add=1";
+    std::string label;
+    std::string out;
+};
+
+// 一种调用：方法名 + 预先构造好的参数（压测期间只读共享）
+struct CallShape {
+    std::string method;
+    std::vector<Value> args;
+    uint32_t weight;
+};
+
+// 每个统计单元（closed：一个线程；open：一条连接的接收线程）独占一份，结束后合并
+struct Stats {
+    LatencyHistogram hist;
+    uint64_t errors{0};
+    clock_type::time_point last{};   // 最后一个计入统计的调用完成的时刻
+
+    void record(clock_type::time_point begin, bool ok){
+        last = clock_type::now();
+        hist.record(last > begin ? (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       last - begin).count() : 0);
+        if (!ok) ++errors;
+    }
+};
+
+static bool parse_options(int argc, char** argv, Options& o){
+    for (int i = 1; i < argc; ++i){
+        std::string k = argv[i];
+        if (k.rfind("--", 0) != 0 || i + 1 >= argc) return false;
+        std::string v = argv[++i];
+        if      (k == "--host")        o.host = v;
+        else if (k == "--port")        o.port = (uint16_t)std::stoi(v);
+        else if (k == "--endpoint")    o.endpoint = v;
+        else if (k == "--conns")       o.conns = std::stoi(v);
+        else if (k == "--concurrency") o.concurrency = std::stoi(v);
+        else if (k == "--mode")        o.mode = v;
+        else if (k == "--rate")        o.rate = std::stod(v);
+        else if (k == "--duration")    o.duration = std::stod(v);
+        else if (k == "--warmup")      o.warmup = std::stod(v);
+        else if (k == "--payload")     o.payload = (size_t)std::stoul(v);
+        else if (k == "--mix")         o.mix = v;
+        else if (k == "--label")       o.label = v;
+        else if (k == "--out")         o.out = v;
+        else return false;
+    }
+    return (o.mode == "closed" || o.mode == "open") && o.conns > 0 && o.concurrency > 0 &&
+           o.rate > 0 && o.duration > 0 && o.warmup >= 0;
+}
+
+// 解析 "add=8,echo=1"，为每个方法构造参数；不认识的方法 → throw
+static std::vector<CallShape> parse_mix(const std::string& mix, size_t payload){
+    std::vector<CallShape> shapes;
+    std::stringstream ss(mix);
+    std::string item;
+    while (std::getline(ss, item, ',')){
+        auto eq = item.find('=');
+        std::string name = item.substr(0, eq);
+        uint32_t w = eq == std::string::npos ? 1 : (uint32_t)std::stoul(item.substr(eq + 1));
+        if (!w) continue;
+        CallShape s{name, {}, w};
+        if (name == "add")       s.args = { Value::make_int(7), Value::make_int(35) };
+        else if (name == "echo") s.args = { Value::make_str(std::string(payload, 'x')) };
+        else if (name == "sum")  s.args = { Value::make_f64_array(Value::F64s(payload / 8 + 1, 1.0)) };
+        else if (name == "fib")  s.args = { Value::make_int(25) };
+        else throw std::runtime_error("unsupported method in mix: " + name);
+        shapes.push_back(std::move(s));
+    }
+    if (shapes.empty()) throw std::runtime_error("empty mix");
+    return shapes;
+}
+
+// 按权重挑一种调用（每个线程一个随机数发生器）
+static const CallShape& pick(const std::vector<CallShape>& shapes, uint32_t total_weight,
+                             std::minstd_rand& rng){
+    uint32_t r = (uint32_t)(rng() % total_weight);
+    for (auto& s : shapes){
+        if (r < s.weight) return s;
+        r -= s.weight;
+    }
+    return shapes.back();
+}
+
+// =====================================================
+// closed 模式：每个线程同步调用，直到 stop；
+// 只统计开始时刻在 measure_from 之后的调用
+// =====================================================
+static void run_closed(const Options& o, std::vector<std::unique_ptr<RpcClient>>& clients,
+                       const std::vector<CallShape>& shapes, uint32_t total_weight,
+                       clock_type::time_point measure_from, clock_type::time_point stop,
+                       std::vector<Stats>& stats){
+    stats.resize((size_t)o.concurrency);
+    std::vector<std::thread> ths;
+    for (int t = 0; t < o.concurrency; ++t){
+        ths.emplace_back([&, t]{
+            RpcClient& c = *clients[(size_t)t % clients.size()];
+            Stats& st = stats[(size_t)t];
+            std::minstd_rand rng((uint32_t)t + 1);
+            while (true){
+                auto t0 = clock_type::now();
+                if (t0 >= stop) break;
+                const CallShape& s = pick(shapes, total_weight, rng);
+                bool ok;
+                try{
+                    ok = c.call(s.method, s.args).status == 0;
+                }catch(const std::exception&){
+                    ok = false;
+                }
+                if (t0 >= measure_from) st.record(t0, ok);
+            }
+        });
+    }
+    for (auto& th : ths) th.join();
+}
+
+// =====================================================
+// open 模式：每条连接一个发送线程，速率 rate/conns，第 k 个请求计划在 start + k*interval 发出
+//   - 回调在该连接的接收线程上执行，只写该连接自己的 Stats，不需要加锁
+//   - 发送线程落后于计划时立即补发（不跳过），延迟仍从计划时刻算起
+//   - 结束后等待在途请求回完（最多 10 秒），再关闭连接
+// =====================================================
+static void run_open(const Options& o, std::vector<std::unique_ptr<RpcClient>>& clients,
+                     const std::vector<CallShape>& shapes, uint32_t total_weight,
+                     clock_type::time_point start, clock_type::time_point measure_from,
+                     clock_type::time_point stop, std::vector<Stats>& stats, uint64_t& sent,
+                     uint64_t& send_errors){
+    stats.resize(clients.size());
+    std::atomic<uint64_t> inflight{0}, total_sent{0}, failed_sends{0};
+    auto interval = std::chrono::duration<double>((double)clients.size() / o.rate);
+
+    std::vector<std::thread> ths;
+    for (size_t ci = 0; ci < clients.size(); ++ci){
+        ths.emplace_back([&, ci]{
+            RpcClient& c = *clients[ci];
+            Stats& st = stats[ci];
+            std::minstd_rand rng((uint32_t)ci + 1);
+            // 各连接的发送时刻错开（一个间隔以内），避免同时发送
+            auto phase = interval * ((double)ci / (double)clients.size());
+            for (uint64_t k = 0; ; ++k){
+                auto due = start + std::chrono::duration_cast<clock_type::duration>(phase + interval * (double)k);
+                if (due >= stop) break;
+                std::this_thread::sleep_until(due);
+                const CallShape& s = pick(shapes, total_weight, rng);
+                bool counted = due >= measure_from;
+                inflight.fetch_add(1, std::memory_order_relaxed);
+                try{
+                    c.call_async(s.method, s.args, [&st, &inflight, due, counted](std::future<Response> f){
+                        bool ok;
+                        try{ ok = f.get().status == 0; }catch(const std::exception&){ ok = false; }
+                        if (counted) st.record(due, ok);
+                        inflight.fetch_sub(1, std::memory_order_relaxed);
+                    });
+                    total_sent.fetch_add(1, std::memory_order_relaxed);
+                }catch(const std::exception&){
+                    // 连接已断：接收线程可能还在回调里写 st，这里单独计数
+                    inflight.fetch_sub(1, std::memory_order_relaxed);
+                    if (counted) failed_sends.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+            }
+        });
+    }
+    for (auto& th : ths) th.join();
+
+    auto drain_until = clock_type::now() + std::chrono::seconds(10);
+    while (inflight.load() && clock_type::now() < drain_until)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (inflight.load()) std::cerr << "[bench] " << inflight.load() << " requests still in flight\n";
+    // 关闭连接会 join 接收线程，之后再读 stats 才安全
+    for (auto& c : clients) c->close_client();
+    sent = total_sent.load();
+    send_errors = failed_sends.load();
+}
+
+static std::string json_escape(const std::string& s){
+    std::string r;
+    for (char ch : s){
+        if (ch == '"' || ch == '\\'){ r += '\\'; r += ch; }
+        else if ((unsigned char)ch < 0x20){ char buf[8]; std::snprintf(buf, sizeof(buf), "\\u%04x", ch); r += buf; }
+        else r += ch;
+    }
+    return r;
+}
+
+int main(int argc, char** argv){
+    Options o;
+    if (!parse_options(argc, argv, o)){
+        std::cerr << "Usage: " << argv[0]
+                  << " [--host H] [--port P] [--endpoint unix:PATH|shm:PATH] [--conns N] [--concurrency N] [--mode closed|open]\n"
+                     "       [--rate R] [--duration S] [--warmup S] [--payload BYTES]\n"
+                     "       [--mix add=8,echo=1,sum=1] [--label TEXT] [--out FILE]\n";
+        return 1;
+    }
+
+    std::vector<CallShape> shapes;
+    try{
+        shapes = parse_mix(o.mix, o.payload);
+    }catch(const std::exception& e){
+        std::cerr << "[bench] " << e.what() << "\n";
+        return 1;
+    }
+    uint32_t total_weight = 0;
+    for (auto& s : shapes) total_weight += s.weight;
+
+    Endpoint ep = Endpoint::tcp(o.host, o.port);
+    try{
+        if (!o.endpoint.empty()) ep = Endpoint::parse(o.endpoint);
+    }catch(const std::exception& e){
+        std::cerr << "[bench] " << e.what() << "\n";
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<RpcClient>> clients;
+    for (int i = 0; i < o.conns; ++i){
+        clients.push_back(std::make_unique<RpcClient>(ep));
+        if (!clients.back()->try_connect_server()){
+            std::cerr << "[bench] cannot connect to " << ep.str() << "\n";
+            return 1;
+        }
+    }
+
+    auto start = clock_type::now();
+    auto measure_from = start + std::chrono::duration_cast<clock_type::duration>(
+                                    std::chrono::duration<double>(o.warmup));
+    auto stop = measure_from + std::chrono::duration_cast<clock_type::duration>(
+                                   std::chrono::duration<double>(o.duration));
+    std::cerr << "[bench] " << o.mode << " loop, " << o.conns << " conns, "
+              << (o.mode == "closed" ? std::to_string(o.concurrency) + " concurrent"
+                                     : std::to_string((long long)o.rate) + " req/s")
+              << ", warmup " << o.warmup << "s, measure " << o.duration << "s\n";
+
+    // 统计窗口内本进程（客户端库 + 压测循环）的堆分配次数：窗口起止各取一次
+    HeapAllocs heap0, heap1;
+    std::thread heap_probe([&]{
+        std::this_thread::sleep_until(measure_from);
+        heap0 = heap_allocs();
+        std::this_thread::sleep_until(stop);
+        heap1 = heap_allocs();
+    });
+
+    std::vector<Stats> stats;
+    uint64_t sent = 0, send_errors = 0;
+    if (o.mode == "closed"){
+        run_closed(o, clients, shapes, total_weight, measure_from, stop, stats);
+        for (auto& c : clients) c->close_client();
+    }else{
+        run_open(o, clients, shapes, total_weight, start, measure_from, stop, stats, sent, send_errors);
+    }
+
+    heap_probe.join();
+
+    LatencyHistogram all;
+    uint64_t errors = send_errors;
+    auto last = stop;
+    for (auto& s : stats){
+        all.merge(s.hist);
+        errors += s.errors;
+        if (s.last > last) last = s.last;
+    }
+    // 吞吐按“统计窗口开始 → 最后一个调用完成”计算：open 模式过载时积压的请求在窗口之后才回完
+    uint64_t n = all.count() + send_errors;
+    double elapsed = std::chrono::duration<double>(last - measure_from).count();
+    double tput = (double)(n - errors) / elapsed;
+    auto us = [](uint64_t ns){ return (double)ns / 1000.0; };
+
+    std::ostringstream js;
+    js.setf(std::ios::fixed);
+    js.precision(1);
+    js << "{\"endpoint\":\"" << json_escape(ep.str()) << "\",\"mode\":\"" << o.mode << "\",\"conns\":" << o.conns
+       << ",\"concurrency\":" << (o.mode == "closed" ? o.concurrency : 0)
+       << ",\"target_rate\":" << (o.mode == "open" ? o.rate : 0.0)
+       << ",\"payload\":" << o.payload << ",\"mix\":\"" << json_escape(o.mix) << "\""
+       << ",\"duration_s\":" << o.duration << ",\"elapsed_s\":" << elapsed << ",\"requests\":" << n << ",\"errors\":" << errors
+       << ",\"throughput_rps\":" << tput
+       << ",\"latency_us\":{\"min\":" << us(all.min()) << ",\"mean\":" << us((uint64_t)all.mean())
+       << ",\"p50\":" << us(all.percentile(50)) << ",\"p90\":" << us(all.percentile(90))
+       << ",\"p99\":" << us(all.percentile(99)) << ",\"p999\":" << us(all.percentile(99.9))
+       << ",\"max\":" << us(all.max()) << "}"
+       << ",\"client_allocs_per_req\":" << std::setprecision(2)
+       << (n ? (double)(heap1.allocs - heap0.allocs) / (double)n : 0.0) << std::setprecision(1)
+       << ",\"label\":\"" << json_escape(o.label) << "\"}";
+
+    std::cerr << "[bench] requests=" << n << " errors=" << errors << " throughput=" << (uint64_t)tput
+              << " req/s";
+    if (o.mode == "open") std::cerr << " (sent " << sent << ")";
+    std::cerr << "\n[bench] latency us: p50=" << us(all.percentile(50)) << " p99=" << us(all.percentile(99))
+              << " p999=" << us(all.percentile(99.9)) << " max=" << us(all.max()) << "\n";
+    std::cout << js.str() << std::endl;
+    if (!o.out.empty()) std::ofstream(o.out) << js.str() << "\n";
+    return errors == 0 ? 0 : 2;
+}
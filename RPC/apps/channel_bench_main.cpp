@@ -0,0 +1,105 @@
+#include "rpc/channel.h"
+#include "rpc/histogram.h"
+#include "rpc/value.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace rpc;
+
+// ======================= 程序功能说明 =======================
+// 多副本负载均衡演示/压测：
+//   1. 用命令行给出的若干端点（host:port / unix:PATH / shm:PATH）建一个 RpcChannel（每副本 conns 条连接）
+//   2. 起 threads 个线程，每个线程通过同一个 channel 连续调用 add(i, t)
+//   3. 打印 QPS、失败数、延迟分位、各副本分到的调用数与最终健康副本数
+//   可选的第一个参数 --hedge P：用 call_hedged，在 P 分位延迟后发对冲请求（add 是幂等的），
+//   结束时打印对冲次数/胜出次数/令牌不足次数
+//
+// 用法：启动多个 tiny_rpc_server 副本（不同端口），运行中可 kill 掉其中一个，
+//       观察它被剔除（调用转到其余副本），重新启动后被重新加入；
+//       或周期性 kill -STOP / -CONT 其中一个模拟停顿，对比有无 --hedge 时的 p999。
+// ============================================================
+
+int main(int argc, char** argv){
+    double hedge_pct = 0;            // 0 = 不对冲
+    int a = 1;
+    if (argc >= 3 && std::strcmp(argv[1], "--hedge") == 0){
+        hedge_pct = std::stod(argv[2]);
+        a = 3;
+    }
+    if (argc - a < 4){
+        std::cerr << "Usage: " << argv[0]
+                  << " [--hedge P] <threads> <calls_per_thread> <conns_per_endpoint> <host:port|unix:PATH|shm:PATH>...\n";
+        return 1;
+    }
+    int threads = std::stoi(argv[a]);
+    int calls   = std::stoi(argv[a + 1]);
+    size_t conns = (size_t)std::stoi(argv[a + 2]);
+
+    std::vector<Endpoint> eps;
+    for (int i = a + 3; i < argc; ++i){
+        try{
+            eps.push_back(Endpoint::parse(argv[i]));
+        }catch(const std::exception& e){
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    RpcChannel ch(eps, conns);
+    if (hedge_pct > 0){
+        HedgePolicy hp;
+        hp.percentile = hedge_pct;
+        ch.set_hedging(hp);
+    }
+    std::cout << "[bench] healthy endpoints: " << ch.connect() << "/" << eps.size() << "\n";
+
+    std::atomic<long> ok{0}, failed{0};
+    std::mutex hist_mu;
+    LatencyHistogram hist;
+    std::vector<std::thread> ths;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t){
+        ths.emplace_back([&, t]{
+            LatencyHistogram local;
+            for (int i = 0; i < calls; ++i){
+                auto begin = std::chrono::steady_clock::now();
+                try{
+                    std::vector<Value> args{ Value::make_int(i), Value::make_int(t) };
+                    Response r = hedge_pct > 0 ? ch.call_hedged("add", args) : ch.call("add", args);
+                    if (r.status == 0 && r.result.i64() == i + t) ++ok;
+                    else ++failed;
+                }catch(const std::exception&){
+                    ++failed;   // 副本在请求途中断开
+                }
+                local.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - begin).count());
+            }
+            std::lock_guard<std::mutex> lk(hist_mu);
+            hist.merge(local);
+        });
+    }
+    for (auto& th : ths) th.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::cout << "[bench] calls ok=" << ok << " failed=" << failed
+              << " time=" << secs << "s qps=" << (double)ok / secs << "\n";
+    std::cout << "[bench] latency us: p50=" << hist.percentile(50) / 1000.0
+              << " p99=" << hist.percentile(99) / 1000.0 << " p999=" << hist.percentile(99.9) / 1000.0
+              << " max=" << hist.max() / 1000.0 << "\n";
+    if (hedge_pct > 0){
+        HedgeStats hs = ch.hedge_stats();
+        std::cout << "[bench] hedging p" << hedge_pct << ": delay=" << hs.delay.count() << "us hedges="
+                  << hs.hedges << " (" << (hs.calls ? 100.0 * (double)hs.hedges / (double)hs.calls : 0.0)
+                  << "%) wins=" << hs.hedge_wins << " denied=" << hs.budget_denied << "\n";
+    }
+    auto picks = ch.picks();
+    for (size_t i = 0; i < eps.size(); ++i)
+        std::cout << "[bench]   " << eps[i].str() << " picks=" << picks[i] << "\n";
+    std::cout << "[bench] healthy endpoints: " << ch.healthy() << "/" << eps.size() << "\n";
+    return failed == 0 ? 0 : 2;
+}
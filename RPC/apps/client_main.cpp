@@ -10,8 +10,15 @@ int main(int argc, char** argv){
     //  1. 从命令行参数中获取服务端的 host 和 port。
     //  2. 连接到 RPC 服务端。
     //  3. 发送两个调用请求：
-    //     (1) 调用远程方法 "add"，传入参数 (7, 35)，打印加法结果。
+    //     (1) 类型化调用 call<int64_t>("add", 7, 35)，打印加法结果。
     //     (2) 调用远程方法 "echo"，传入参数 "hello rpc"，打印回显结果。
+    //     (3) 用 call_async 在同一连接上连发多个 add，再依次取回结果。
+    //     (4) 调用远程方法 "sum"，传入 F64_ARRAY [1.5, 2.5, 3.0]，打印求和结果。
+    //     (5) 用 call_batch 把 add/echo/未知方法 三个调用合成一帧发出。
+    //     (6) 服务端流 range(5)：逐块迭代；客户端流 upload_sum：逐块上传 1..100。
+    //     (7) 带超时调用 sleep(200)：50ms 预算时服务端按剩余预算提前返回（或本地超时 status=4）；
+    //         500ms 预算正常返回。
+    //     (8) 调用内置的 "__stats"，打印服务端各方法的调用数与 p99 延迟。
     //  4. 打印服务端返回的结果或错误信息。
     //  5. 关闭连接并退出。
     //
@@ -19,6 +26,7 @@ int main(int argc, char** argv){
     // 外部输入：
     //   - 命令行参数 argv[1]: 服务端主机地址（如 "127.0.0.1"）
     //   - 命令行参数 argv[2]: 服务端端口号（如 "8080"）
+    //   - 或只给一个端点：unix:/path（UNIX socket）/ shm:/path（共享内存）
     //
     // 输出：
     //   - 如果调用成功，打印结果，例如：
@@ -27,35 +35,119 @@ int main(int argc, char** argv){
     //   - 如果调用失败，打印错误状态码和错误消息，例如：
     //       [client] add error: (1) function not found
 
-    if (argc < 3){
-        std::cerr << "Usage: " << argv[0] << " <host> <port>\n";
+    if (argc < 2){
+        std::cerr << "Usage: " << argv[0] << " <host> <port> | " << argv[0] << " <unix:PATH|shm:PATH>\n";
+        return 1;
+    }
+    Endpoint ep;
+    try{
+        ep = argc >= 3 ? Endpoint::tcp(argv[1], (uint16_t)std::stoi(argv[2])) : Endpoint::parse(argv[1]);
+    }catch(const std::exception& e){
+        std::cerr << e.what() << "\n";
         return 1;
     }
-    std::string host = argv[1];
-    uint16_t port = (uint16_t)std::stoi(argv[2]);
 
-    // 创建 RPC 客户端对象，连接到指定的 host:port
-    RpcClient c(host, port);
+    // 创建 RPC 客户端对象，连接到指定端点
+    RpcClient c(ep);
     c.connect_server();
 
-    // 1) 调用远程 add(7, 35)
-    {
-        Response r = c.call("add", { Value::make_int(7), Value::make_int(35) });
-        if (r.status == 0 && r.has_result && r.result.type == ValueType::INT64)
-            std::cout << "[client] add result = " << r.result.i64 << "\n";
-        else
-            std::cout << "[client] add error: (" << r.status << ") " << r.err_msg << "\n";
+    // 1) 调用远程 add(7, 35)：类型化调用，实参直接编码，结果直接是 int64_t
+    try{
+        std::cout << "[client] add result = " << c.call<int64_t>("add", 7, 35) << "\n";
+    }catch(const RpcError& e){
+        std::cout << "[client] add error: (" << e.status() << ") " << e.what() << "\n";
     }
 
     // 2) 调用远程 echo("hello rpc")
     {
         Response r = c.call("echo", { Value::make_str("hello rpc") });
-        if (r.status == 0 && r.has_result && r.result.type == ValueType::STRING)
-            std::cout << "[client] echo result = " << r.result.str << "\n";
+        if (r.status == 0 && r.has_result && r.result.type() == ValueType::STRING)
+            std::cout << "[client] echo result = " << r.result.str() << "\n";
         else
             std::cout << "[client] echo error: (" << r.status << ") " << r.err_msg << "\n";
     }
 
+    // 3) 流水线：先连发 add(i, i)，再统一等待（响应按 req_id 路由回各自的 future）
+    {
+        std::vector<std::future<Response>> futs;
+        for (int i = 1; i <= 3; ++i)
+            futs.push_back(c.call_async("add", { Value::make_int(i), Value::make_int(i) }));
+        for (auto& f : futs){
+            Response r = f.get();
+            std::cout << "[client] pipelined add #" << r.req_id << " = " << r.result.i64() << "\n";
+        }
+    }
+
+    // 4) 调用远程 sum([1.5, 2.5, 3.0])：定长数组一次编码
+    {
+        Response r = c.call("sum", { Value::make_f64_array({1.5, 2.5, 3.0}) });
+        if (r.status == 0 && r.has_result && r.result.type() == ValueType::DOUBLE)
+            std::cout << "[client] sum result = " << r.result.f64() << "\n";
+        else
+            std::cout << "[client] sum error: (" << r.status << ") " << r.err_msg << "\n";
+    }
+
+    // 5) 批量调用：一帧发出、一帧收回，响应与请求按序对应，各项独立成功/失败
+    {
+        std::vector<Request> batch(3);
+        batch[0].method = "add";  batch[0].args = { Value::make_int(40), Value::make_int(2) };
+        batch[1].method = "echo"; batch[1].args = { Value::make_str("batched") };
+        batch[2].method = "nope";
+        std::vector<Response> rs = c.call_batch(batch);
+        for (size_t i = 0; i < rs.size(); ++i){
+            const Response& r = rs[i];
+            std::cout << "[client] batch[" << i << "] " << batch[i].method << ": ";
+            if (r.status != 0)                             std::cout << "error (" << r.status << ") " << r.err_msg;
+            else if (r.result.type() == ValueType::INT64)    std::cout << r.result.i64();
+            else if (r.result.type() == ValueType::STRING)   std::cout << r.result.str();
+            std::cout << "\n";
+        }
+    }
+
+    // 6) 流式调用
+    {
+        StreamCall s = c.call_stream("range", { Value::make_int(5) });
+        std::cout << "[client] range:";
+        for (const Value& v : s) std::cout << " " << v.i64();
+        std::cout << " (status " << s.result().status << ", sent " << s.result().result.i64() << ")\n";
+
+        ClientStream up = c.open_client_stream("upload_sum", {});
+        for (int64_t i = 1; i <= 100; ++i)
+            if (!up.write(Value::make_int(i))) break;
+        Response r = up.finish();
+        std::cout << "[client] upload_sum = " << r.result.i64() << "\n";
+    }
+
+    // 7) 截止时间
+    for (int budget : { 50, 500 }){
+        Response r = c.call("sleep", { Value::make_int(200) }, std::chrono::milliseconds(budget));
+        if (r.status == 0) std::cout << "[client] sleep(200) within " << budget << "ms = " << r.result.i64() << "\n";
+        else std::cout << "[client] sleep(200) within " << budget << "ms error: ("
+                       << r.status << ") " << r.err_msg << "\n";
+    }
+
+    // 8) 服务端统计
+    {
+        Response r = c.call(STATS_METHOD, {});
+        if (r.status == 0){
+            for (auto& kv : r.result.map()){
+                if (kv.first != "methods") continue;
+                for (auto& m : kv.second.map()){
+                    int64_t calls = 0;
+                    double p99 = 0;
+                    for (auto& f : m.second.map()){
+                        if (f.first == "calls") calls = f.second.i64();
+                        else if (f.first == "p99_us") p99 = f.second.f64();
+                    }
+                    std::cout << "[client] stats " << m.first << ": calls=" << calls
+                              << " p99=" << p99 << "us\n";
+                }
+            }
+        }else{
+            std::cout << "[client] __stats error: (" << r.status << ") " << r.err_msg << "\n";
+        }
+    }
+
     // 关闭客户端连接
     c.close_client();
     return 0;
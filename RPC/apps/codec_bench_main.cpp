@@ -0,0 +1,161 @@
+#include "rpc/arena.h"
+#include "rpc/buffer_pool.h"
+#include "rpc/frame.h"
+#include "rpc/protocol.h"
+#include "rpc/value.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace rpc;
+
+// ======================= 程序功能说明 =======================
+// 编解码微基准：不经过网络，逐个测量 protocol.cpp / frame.cpp 的各个入口
+//   encode_value          : 逐个参数 encode_value 到复用的 out
+//   decode_value          : 逐个参数 decode_value（拥有内存的 Value）
+//   encode_payload        : Request::encode_payload（返回新 vector）
+//   parse_request_payload : payload → Request
+//   parse_request (arena) : payload → 复用的 Request，参数内容在 RequestArena 里（服务端路径）
+//   parse_body_to_frame   : 完整 body → RawFrame（拷贝 method/payload）
+//   以及零拷贝对照组 parse_body_to_view / parse_request_view
+// 参数形状：
+//   small_ints : 64 个小 INT64
+//   large_strs : 2 个 64KB STRING
+//   mixed      : INT64/DOUBLE/BOOL/短 STRING/ARRAY/MAP/F64_ARRAY 混合
+// 每项输出 ns/op、bytes/op（该操作产出或消费的编码字节数）、
+// allocs/op 与 alloc_bytes/op（测量循环内的堆分配，见 rpc::heap_allocs；
+// 编译选项 TINY_RPC_COUNT_ALLOCS 关闭时这两列为 0）
+//
+// 用法：tiny_rpc_codec_bench [每项最短测量毫秒数，默认 200]
+// ============================================================
+
+struct Result {
+    double ns;
+    double allocs;
+    double alloc_bytes;
+};
+
+// 先跑一次预热，再按翻倍的次数重复，直到单轮耗时不少于 min_ms；
+// 只统计最后一轮
+template <class F>
+static Result measure(double min_ms, F&& f){
+    f();
+    using clock = std::chrono::steady_clock;
+    for (uint64_t iters = 1; ; iters *= 2){
+        HeapAllocs h0 = heap_allocs();
+        auto t0 = clock::now();
+        for (uint64_t i = 0; i < iters; ++i) f();
+        double ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+        if (ms >= min_ms || iters >= (uint64_t(1) << 32)){
+            double n = (double)iters;
+            HeapAllocs h1 = heap_allocs();
+            return { ms * 1e6 / n, (double)(h1.allocs - h0.allocs) / n, (double)(h1.bytes - h0.bytes) / n };
+        }
+    }
+}
+
+static void print_row(const char* shape, const char* op, uint8_t ver, size_t bytes, const Result& r){
+    std::printf("%-11s %-22s v%d %12.1f %10zu %10.2f %14.1f\n",
+                shape, op, ver, r.ns, bytes, r.allocs, r.alloc_bytes);
+}
+
+static void run_shape(const char* shape, const Request& req, uint8_t ver, double min_ms){
+    volatile size_t sink = 0;
+
+    // 预先编码好各个输入
+    std::vector<std::vector<uint8_t>> encoded_args;
+    size_t args_bytes = 0;
+    for (auto& v : req.args){
+        std::vector<uint8_t> b;
+        encode_value(b, v, ver);
+        args_bytes += b.size();
+        encoded_args.push_back(std::move(b));
+    }
+    std::vector<uint8_t> payload = req.encode_payload(ver);
+    std::vector<uint8_t> frame;
+    build_request_frame(req, frame, ver);
+    const uint8_t* body = frame.data() + 4;
+    size_t body_len = frame.size() - 4;
+
+    std::vector<uint8_t> out;
+    out.reserve(args_bytes);
+    print_row(shape, "encode_value", ver, args_bytes, measure(min_ms, [&]{
+        out.clear();
+        for (auto& v : req.args) encode_value(out, v, ver);
+        sink = sink + out.size();
+    }));
+
+    print_row(shape, "decode_value", ver, args_bytes, measure(min_ms, [&]{
+        for (auto& b : encoded_args){
+            auto dec = decode_value(b.data(), b.size(), ver);
+            sink = sink + dec.second;
+        }
+    }));
+
+    print_row(shape, "encode_payload", ver, payload.size(), measure(min_ms, [&]{
+        std::vector<uint8_t> p = req.encode_payload(ver);
+        sink = sink + p.size();
+    }));
+
+    print_row(shape, "parse_request_payload", ver, payload.size(), measure(min_ms, [&]{
+        Request r = parse_request_payload(req.req_id, req.method, payload, ver);
+        sink = sink + r.args.size();
+    }));
+
+    // 服务端的做法：参数解码进每次请求新建的 RequestArena，Request 的容量跨迭代复用
+    Request reused;
+    print_row(shape, "parse_request (arena)", ver, payload.size(), measure(min_ms, [&]{
+        RequestArena arena;
+        parse_request_payload(req.req_id, req.method, payload.data(), payload.size(), reused,
+                              &arena, ver);
+        sink = sink + reused.args.size();
+        reused.args.clear();
+    }));
+
+    print_row(shape, "parse_body_to_frame", ver, body_len, measure(min_ms, [&]{
+        RawFrame rf = parse_body_to_frame(body, body_len);
+        sink = sink + rf.payload.size();
+    }));
+
+    // 零拷贝对照组：视图解析 + RequestView（args 容量跨迭代复用）
+    RequestView view;
+    print_row(shape, "view: body+request", ver, body_len, measure(min_ms, [&]{
+        RawFrameView rf = parse_body_to_view(body, body_len);
+        parse_request_view(rf.req_id, rf.method, rf.payload, rf.payload_len, view, rf.version);
+        sink = sink + view.args.size();
+    }));
+}
+
+int main(int argc, char** argv){
+    double min_ms = argc >= 2 ? std::stod(argv[1]) : 200.0;
+
+    Request small{1, "add", {}};
+    for (int i = 0; i < 64; ++i) small.args.push_back(Value::make_int(i % 100));
+
+    Request large{2, "echo", {}};
+    for (int i = 0; i < 2; ++i) large.args.push_back(Value::make_str(std::string(64 * 1024, 'x')));
+
+    Request mixed{3, "mixed", {}};
+    mixed.args.push_back(Value::make_int(42));
+    mixed.args.push_back(Value::make_int(-123456789));
+    mixed.args.push_back(Value::make_double(3.25));
+    mixed.args.push_back(Value::make_bool(true));
+    mixed.args.push_back(Value::make_str("user-0001"));
+    mixed.args.push_back(Value::make_str(std::string(200, 'y')));
+    mixed.args.push_back(Value::make_array({ Value::make_int(1), Value::make_int(2),
+                                             Value::make_str("three"), Value::make_double(4.0) }));
+    mixed.args.push_back(Value::make_map({ { "id", Value::make_int(7) },
+                                           { "name", Value::make_str("tiny") },
+                                           { "ok", Value::make_bool(false) } }));
+    mixed.args.push_back(Value::make_f64_array(Value::F64s(32, 0.5)));
+
+    std::printf("%-11s %-22s %-2s %12s %10s %10s %14s\n",
+                "shape", "op", "ver", "ns/op", "bytes/op", "allocs/op", "alloc_bytes/op");
+    for (uint8_t ver : {VERSION, VERSION_V2}){
+        run_shape("small_ints", small, ver, min_ms);
+        run_shape("large_strs", large, ver, min_ms);
+        run_shape("mixed", mixed, ver, min_ms);
+    }
+    return 0;
+}
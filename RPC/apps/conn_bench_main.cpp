@@ -0,0 +1,73 @@
+#include "rpc/client.h"
+#include "rpc/net.h"
+#include "rpc/value.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace rpc;
+
+// ======================= 程序功能说明 =======================
+// 连接数/吞吐对比工具：
+//   1. 先建立 idle_conns 条空闲 TCP 连接（只连不发，模拟大量长连接）
+//   2. 再起 active 个线程，每个线程一条 RpcClient 连接，连续调用 add(i, 1)
+//   3. 打印建连耗时、总调用数、耗时与 QPS
+//   可选第 6 个参数 shared：所有活跃线程共用一条 RpcClient 连接（多路复用）
+//
+// 用法：分别以 thread / epoll 模式启动 tiny_rpc_server，用相同参数运行本工具，
+//       对比 QPS 以及服务端进程的线程数/RSS（ps -o nlwp,rss -p <pid>）。
+// ============================================================
+
+int main(int argc, char** argv){
+    if (argc < 6){
+        std::cerr << "Usage: " << argv[0]
+                  << " <host> <port> <idle_conns> <active_threads> <calls_per_thread> [shared]\n";
+        return 1;
+    }
+    std::string host = argv[1];
+    uint16_t port    = (uint16_t)std::stoi(argv[2]);
+    int idle         = std::stoi(argv[3]);
+    int active       = std::stoi(argv[4]);
+    int calls        = std::stoi(argv[5]);
+    bool shared      = argc >= 7 && std::string(argv[6]) == "shared";
+
+    using clock = std::chrono::steady_clock;
+
+    // 1) 空闲连接
+    auto t0 = clock::now();
+    std::vector<socket_t> idle_fds;
+    idle_fds.reserve((size_t)idle);
+    for (int i = 0; i < idle; ++i) idle_fds.push_back(tcp_connect(host, port));
+    double connect_ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+    std::cout << "[bench] idle connections: " << idle << " in " << connect_ms << " ms\n";
+
+    // 2) 活跃调用
+    std::atomic<long> ok{0}, failed{0};
+    std::vector<std::thread> ths;
+    RpcClient shared_client(host, port);
+    if (shared) shared_client.connect_server();
+    auto t1 = clock::now();
+    for (int t = 0; t < active; ++t){
+        ths.emplace_back([&, t]{
+            RpcClient own(host, port);
+            if (!shared) own.connect_server();
+            RpcClient& c = shared ? shared_client : own;
+            for (int i = 0; i < calls; ++i){
+                Response r = c.call("add", { Value::make_int(i), Value::make_int(t) });
+                if (r.status == 0 && r.has_result && r.result.i64() == i + t) ++ok;
+                else ++failed;
+            }
+        });
+    }
+    for (auto& th : ths) th.join();
+    double secs = std::chrono::duration<double>(clock::now() - t1).count();
+
+    // 3) 报告
+    std::cout << "[bench] calls ok=" << ok << " failed=" << failed
+              << " time=" << secs << "s qps=" << (double)ok / secs << "\n";
+
+    for (auto fd : idle_fds) close_fd(fd);
+    return failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,106 @@
+#include "rpc/client.h"
+#include "rpc/coro.h"
+#include "rpc/server.h"
+#include "rpc/value.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rpc;
+
+// ======================= 程序功能说明 =======================
+// 协程扇出演示（需编译选项 TINY_RPC_COROUTINES）：
+//   1. 后端：epoll 模式的 RpcServer（port+1），方法 add(a, b)
+//   2. 前端：epoll 模式的 RpcServer（port），协程方法 fanout_sum(n)：
+//      经同一条连接同时发出 n 个 add(i, 1) 到后端，co_await 全部结果后求和
+//   3. 客户端依次调用 fanout_sum(1 / 10 / ... / max_n)，打印耗时与进程线程数
+//
+// 前端等待后端期间不占线程：n 从 1 到上万，线程数保持不变
+// （同步 handler 要同时挂起 n 个下游调用，就得有 n 个线程阻塞在 call 上）。
+// ============================================================
+
+static Response handle_add(const RequestView& req){
+    Response rsp;
+    rsp.status = 0;
+    rsp.has_result = true;
+    rsp.result = Value::make_int(as_i64(req.args, 0) + as_i64(req.args, 1));
+    return rsp;
+}
+
+// fanout_sum(n)：先全部发出再逐个等待，n 个调用同时在途；截止时间原样传给下游
+static Task<Response> fanout_sum(RpcClient& backend, const Request& req){
+    int64_t n = as_i64(req.args, 0);
+    std::vector<CallAwaitable> calls;
+    calls.reserve((size_t)std::max<int64_t>(n, 0));
+    for (int64_t i = 0; i < n; ++i)
+        calls.push_back(backend.co_call("add", { Value::make_int(i), Value::make_int(1) },
+                                        req.remaining()));
+    int64_t sum = 0;
+    for (auto& c : calls){
+        Response r = co_await c;
+        if (r.status != 0) co_return r;          // 下游出错：原样返回
+        sum += r.result.i64();
+    }
+    Response rsp;
+    rsp.status = 0;
+    rsp.has_result = true;
+    rsp.result = Value::make_int(sum);
+    co_return rsp;
+}
+
+// 当前进程的线程数（/proc/self/status 的 Threads 行；其它平台返回 -1）
+static int thread_count(){
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    while (std::getline(in, line))
+        if (line.compare(0, 8, "Threads:") == 0) return std::stoi(line.substr(8));
+    return -1;
+}
+
+// 服务端在后台线程里 serve()，这里重试到连得上为止
+static void connect_retry(RpcClient& c){
+    for (int i = 0; i < 200; ++i){
+        if (c.try_connect_server()) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    c.connect_server();   // 仍连不上：打印错误并退出
+}
+
+int main(int argc, char** argv){
+    uint16_t port = argc >= 2 ? (uint16_t)std::stoi(argv[1]) : 9100;
+    int64_t max_n = argc >= 3 ? std::stoll(argv[2]) : 10000;
+
+    // 两个服务端一直运行到进程退出（serve 不返回），因此不析构
+    auto* backend = new RpcServer((uint16_t)(port + 1), ServeMode::EPOLL);
+    backend->register_method_view("add", handle_add);
+    std::thread([backend]{ backend->serve(); }).detach();
+
+    auto* downstream = new RpcClient("127.0.0.1", (uint16_t)(port + 1));
+    connect_retry(*downstream);
+
+    auto* frontend = new RpcServer(port, ServeMode::EPOLL);
+    frontend->register_coro("fanout_sum", [downstream](const Request& req){
+        return fanout_sum(*downstream, req);
+    });
+    std::thread([frontend]{ frontend->serve(); }).detach();
+
+    RpcClient client("127.0.0.1", port);
+    connect_retry(client);
+
+    int rc = 0;
+    for (int64_t n = 1; n <= max_n; n *= 10){
+        auto t0 = std::chrono::steady_clock::now();
+        Response r = client.call("fanout_sum", { Value::make_int(n) });
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        bool ok = r.status == 0 && r.result.i64() == n * (n + 1) / 2;
+        if (!ok) rc = 2;
+        std::cout << "[coro] fanout_sum(" << n << ") = " << (r.status == 0 ? std::to_string(r.result.i64()) : r.err_msg)
+                  << (ok ? "" : "  MISMATCH") << "  time=" << ms << "ms threads=" << thread_count() << "\n";
+    }
+    std::cout.flush();
+    return rc;
+}
@@ -0,0 +1,155 @@
+#include "rpc/frame.h"
+#include "rpc/protocol.h"
+#include "rpc/value.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace rpc;
+
+// ======================= 程序功能说明 =======================
+// 帧编码微基准：对比旧的三次拷贝路径与单趟编码路径
+//   legacy : encode_payload() → 拼 body（逐字节 push_back）→ 再拷进 out
+//   single : build_request_frame()，先算总长，直接写入复用的 out
+// 参数形状：
+//   small_ints  : 16 个 INT64
+//   large_strs  : 4 个 64KB STRING
+//   mixed       : 8 个 INT64 + 8 个 256B STRING
+// 输出：每种形状两条路径的 ns/op 与 MB/s
+//
+// 第二部分对比线上编码版本 v1（定长大端）与 v2（varint/zigzag）：
+//   帧字节数、编码 ns/op（build_request_frame）、
+//   解码 ns/op（parse_body_to_view + parse_request_view）
+//
+// 第三部分对比 100 万个整数的两种表示：
+//   ARRAY of INT64（每个元素一个 Value）vs INT64_ARRAY（一个长度 + 连续 8B 元素）
+// ============================================================
+
+// 旧实现（仅用于对比）：与重构前 frame.cpp 的 build_request_frame 一致
+static void legacy_put_u32_be(std::vector<uint8_t>& out, uint32_t v){
+    out.push_back((v>>24)&0xFF); out.push_back((v>>16)&0xFF);
+    out.push_back((v>>8)&0xFF);  out.push_back((v    )&0xFF);
+}
+static void legacy_build_request_frame(const Request& req, std::vector<uint8_t>& out){
+    static const uint8_t MAGIC[4] = {'R','P','C','1'};
+    std::vector<uint8_t> payload = req.encode_payload();
+
+    std::vector<uint8_t> body;
+    body.insert(body.end(), MAGIC, MAGIC+4);
+    body.push_back(VERSION);
+    body.push_back((uint8_t)MsgType::REQUEST);
+    legacy_put_u32_be(body, req.req_id);
+    legacy_put_u32_be(body, (uint32_t)req.method.size());
+    legacy_put_u32_be(body, (uint32_t)payload.size());
+    body.insert(body.end(), req.method.begin(), req.method.end());
+    body.insert(body.end(), payload.begin(), payload.end());
+
+    out.clear();
+    legacy_put_u32_be(out, (uint32_t)body.size());
+    out.insert(out.end(), body.begin(), body.end());
+}
+
+template <class F>
+static double ns_per_op(int iters, F&& f){
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i) f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+}
+
+static void run_shape(const char* name, const Request& req, int iters){
+    std::vector<uint8_t> out;
+    volatile size_t sink = 0;
+
+    double legacy = ns_per_op(iters, [&]{ legacy_build_request_frame(req, out); sink = sink + out.size(); });
+    double single = ns_per_op(iters, [&]{ build_request_frame(req, out);        sink = sink + out.size(); });
+
+    double bytes = (double)out.size();
+    std::cout << name << ": frame=" << out.size() << "B"
+              << "  legacy=" << legacy << " ns/op (" << bytes / legacy * 1e3 << " MB/s)"
+              << "  single=" << single << " ns/op (" << bytes / single * 1e3 << " MB/s)"
+              << "  speedup=" << legacy / single << "x\n";
+}
+
+static void run_versions(const char* name, const Request& req, int iters){
+    std::vector<uint8_t> out;
+    RequestView view;
+    volatile size_t sink = 0;
+
+    std::cout << name << ":";
+    size_t v1_size = 0;
+    for (uint8_t ver : {VERSION, VERSION_V2}){
+        build_request_frame(req, out, ver);
+        double enc = ns_per_op(iters, [&]{ build_request_frame(req, out, ver); sink = sink + out.size(); });
+        double dec = ns_per_op(iters, [&]{
+            RawFrameView rf = parse_body_to_view(out.data() + 4, out.size() - 4);
+            parse_request_view(rf.req_id, rf.method, rf.payload, rf.payload_len, view, rf.version);
+            sink = sink + view.args.size();
+        });
+        if (ver == VERSION) v1_size = out.size();
+        std::cout << "  v" << int(ver) << " " << out.size() << "B enc=" << enc << "ns dec=" << dec << "ns";
+    }
+    std::cout << "  size_ratio=" << (double)v1_size / (double)out.size() << "x\n";
+}
+
+static void run_array_1m(){
+    const size_t N = 1000000;
+    std::vector<int64_t> nums(N);
+    for (size_t i = 0; i < N; ++i) nums[i] = (int64_t)(i * 7919);
+
+    Value::Array boxed;
+    boxed.reserve(N);
+    for (auto x : nums) boxed.push_back(Value::make_int(x));
+
+    Request as_values{6, "sum", { Value::make_array(std::move(boxed)) }};
+    Request as_typed {7, "sum", { Value::make_i64_array(Value::Int64s(nums.begin(), nums.end())) }};
+
+    std::vector<uint8_t> out;
+    volatile size_t sink = 0;
+    for (auto* req : {&as_values, &as_typed}){
+        const char* name = req == &as_values ? "ARRAY<INT64> " : "INT64_ARRAY  ";
+        double enc = ns_per_op(5, [&]{ build_request_frame(*req, out); sink = sink + out.size(); });
+        double dec = ns_per_op(5, [&]{
+            RawFrameView rf = parse_body_to_view(out.data() + 4, out.size() - 4);
+            Request r = parse_request_payload(rf.req_id, rf.method, rf.payload, rf.payload_len, rf.version);
+            sink = sink + r.args.size();
+        });
+        std::cout << name << " 1M ints: " << out.size() << "B enc=" << enc / 1e6 << "ms dec="
+                  << dec / 1e6 << "ms\n";
+    }
+}
+
+int main(int argc, char** argv){
+    int iters = argc >= 2 ? std::stoi(argv[1]) : 20000;
+
+    Request small{1, "add", {}};
+    for (int i = 0; i < 16; ++i) small.args.push_back(Value::make_int(i * 1000));
+
+    Request large{2, "echo", {}};
+    for (int i = 0; i < 4; ++i) large.args.push_back(Value::make_str(std::string(64 * 1024, 'x')));
+
+    Request mixed{3, "mixed", {}};
+    for (int i = 0; i < 8; ++i){
+        mixed.args.push_back(Value::make_int(i));
+        mixed.args.push_back(Value::make_str(std::string(256, 'y')));
+    }
+
+    run_shape("small_ints", small, iters * 10);
+    run_shape("large_strs", large, iters / 10);
+    run_shape("mixed     ", mixed, iters);
+
+    Request add{4, "add", { Value::make_int(7), Value::make_int(35) }};
+    Request echo{5, "echo", { Value::make_str("hello rpc") }};
+
+    std::cout << "\n-- wire version v1 vs v2 --\n";
+    run_versions("add(7,35)  ", add, iters * 10);
+    run_versions("echo(short)", echo, iters * 10);
+    run_versions("small_ints ", small, iters * 10);
+    run_versions("large_strs ", large, iters / 10);
+    run_versions("mixed      ", mixed, iters);
+
+    std::cout << "\n-- 1M element array --\n";
+    run_array_1m();
+    return 0;
+}
@@ -1,6 +1,12 @@
 #include "rpc/server.h"
 #include "rpc/value.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
 
 using namespace rpc;
 
@@ -8,25 +14,30 @@ using namespace rpc;
 // 这是一个 RPC 服务端示例程序，负责：
 //   1. 监听指定端口，接受客户端的 TCP 连接。
 //   2. 注册两个 RPC 方法：
-//        - "add": 接收两个 int64 参数，返回它们的和。
-//        - "echo": 接收一个字符串参数，返回 "echo: <参数>"。
+//        - "add": 接收两个 int64 参数，返回它们的和（类型化注册 bind）。
+//        - "echo": 接收一个字符串参数，返回 "echo: <参数>"（类型化注册 bind）。
+//        - "sum": 接收一个 F64_ARRAY，返回元素之和（DOUBLE）。
+//        - "fib": 递归计算斐波那契数（模拟昂贵的纯查询；响应缓存 1 秒）。
+//        - "sleep": 睡眠 ms 毫秒后返回 ms（模拟慢调用，并发上限 4；不超过请求的剩余预算）。
+//        - "range": 服务端流，逐块返回 [0, n) 每块一个 int64，结束时带上块数。
+//        - "upload_sum": 客户端流，累加客户端上传的每块 int64，返回总和。
 //   3. 在主循环中持续处理来自客户端的请求，并将结果或错误返回。
 // ============================================================
 
-// 示例方法：add(a:int64, b:int64) -> int64
-static Response handle_add(const Request& req){
+// 示例方法：sum(xs:f64[]) -> double
+// 定长数组整段批量转换到复用缓冲区，不逐个元素构造 Value
+static Response handle_sum(const RequestView& req){
+    thread_local std::vector<double> xs;
     Response rsp;
     try{
-        // 从请求参数中提取两个整数
-        int64_t a = as_i64(req.args, 0);
-        int64_t b = as_i64(req.args, 1);
+        copy_f64_array(req.args, 0, xs);
+        double total = 0;
+        for (double x : xs) total += x;
 
-        // 正常返回结果
         rsp.status = 0;
         rsp.has_result = true;
-        rsp.result = Value::make_int(a + b);
+        rsp.result = Value::make_double(total);
     }catch(const std::exception& e){
-        // 如果参数解析失败，返回错误状态和错误信息
         rsp.status = 1;
         rsp.err_msg = e.what();
         rsp.has_result = false;
@@ -34,47 +45,122 @@ static Response handle_add(const Request& req){
     return rsp;
 }
 
-// 示例方法：echo(s:string) -> string
-static Response handle_echo(const Request& req){
+// 示例方法：fib(n:int64) -> int64
+// 故意用指数级递归模拟“昂贵的纯查询”；注册时开启响应缓存，相同 n 的重复调用直接命中
+static int64_t fib(int64_t n){
+    if (n < 0 || n > 40) throw std::runtime_error("fib: n out of range [0, 40]");
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+// 示例方法：sleep(ms:int64) -> int64
+// 模拟慢 handler；启用工作线程池后不会阻塞同一连接上的其它请求
+// 请求带截止时间时最多睡到截止时间（调用方此后已不再等待），返回实际睡眠毫秒数
+static Response handle_sleep(const RequestView& req){
+    int64_t ms = as_i64(req.args, 0);     // 参数错误直接抛出，由框架转成 status=2
+    ms = std::min<int64_t>(ms, std::max<int64_t>(req.remaining().count(), 0));
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
     Response rsp;
-    try{
-        std::string s = as_str(req.args, 0);
+    rsp.status = 0;
+    rsp.has_result = true;
+    rsp.result = Value::make_int(ms);
+    return rsp;
+}
 
-        rsp.status = 0;
-        rsp.has_result = true;
-        rsp.result = Value::make_str("echo: " + s);
-    }catch(const std::exception& e){
-        rsp.status = 1;
-        rsp.err_msg = e.what();
-        rsp.has_result = false;
+// 示例服务端流：range(n:int64) -> stream<int64>，结束状态里带上已发送块数
+// 客户端消费慢时 write 会阻塞在额度上，服务端不会堆积未发送的块
+static Response handle_range(const Request& req, StreamWriter& w){
+    int64_t n = as_i64(req.args, 0);
+    int64_t sent = 0;
+    for (int64_t i = 0; i < n; ++i){
+        if (!w.write(Value::make_int(i))) break;   // 客户端取消或断开
+        ++sent;
     }
+    Response rsp;
+    rsp.status = 0;
+    rsp.has_result = true;
+    rsp.result = Value::make_int(sent);
+    return rsp;
+}
+
+// 示例客户端流：upload_sum(stream<int64>) -> int64
+static Response handle_upload_sum(const Request&, StreamReader& r){
+    int64_t total = 0;
+    Value v;
+    while (r.next(v)){
+        if (v.type() != ValueType::INT64) throw std::runtime_error("upload_sum expects int64 chunks");
+        total += v.i64();
+    }
+    Response rsp;
+    rsp.status = 0;
+    rsp.has_result = true;
+    rsp.result = Value::make_int(total);
     return rsp;
 }
 
 int main(int argc, char** argv){
     // ================ 输入 & 输出说明 =================
     // 外部输入：
-    //   - 命令行参数 argv[1]: 监听的端口号（如 "8080"）
+    //   - 命令行参数 argv[1]: 监听的端口号（如 "8080"，所有网卡）或 host:port（只监听该地址），
+    //                         或 unix:/path（UNIX socket）、
+    //                         shm:/path（共享内存，path 为握手用的 socket 文件）
+    //   - 命令行参数 argv[2]: 可选，服务模式 thread（默认）/ epoll / uring（io_uring，需编译选项 TINY_RPC_IO_URING）
+    //   - 命令行参数 argv[3]: 可选，工作线程数（默认 0 = handler 在 I/O 线程内联执行）
+    //   - 命令行参数 argv[4]: 可选，每隔多少秒向 stderr 输出一次统计（默认 0 = 不输出）
+    //   - 命令行参数 argv[5]: 可选，事件循环个数（epoll/uring + TCP；默认 1；>1 时各用一个 SO_REUSEPORT 监听 socket）
+    //   - 命令行参数 argv[6]: 可选，写 pin 则把各事件循环线程绑到不同 CPU
     //
     // 对外输出：
     //   - 服务端会在标准输出打印启动日志（如果你加了 log）。
     //   - 对客户端的 RPC 请求返回对应的结果，例如：
     //       "add" -> 返回整数和
     //       "echo" -> 返回带 "echo:" 前缀的字符串
+    //       "__stats" -> 返回各方法的调用数、错误数与延迟分位（内置）
     // ==================================================
 
     if (argc < 2){
-        std::cerr << "Usage: " << argv[0] << " <port>\n";
+        std::cerr << "Usage: " << argv[0] << " <[host:]port|unix:PATH|shm:PATH> [thread|epoll|uring] [workers] [stats_interval_s]"
+                     " [reactors] [pin]\n";
         return 1;
     }
-    uint16_t port = (uint16_t)std::stoi(argv[1]);
+    Endpoint ep;
+    try{
+        ep = Endpoint::parse(argv[1]);
+    }catch(const std::exception& e){
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    // 只给了端口时监听所有网卡；写成 host:port 则只监听该地址（如 127.0.0.1:9000）
+    if (ep.kind == TransportKind::TCP && std::string(argv[1]).find(':') == std::string::npos) ep.host = "0.0.0.0";
+    std::string mode = argc >= 3 ? argv[2] : "thread";
+    int workers      = argc >= 4 ? std::stoi(argv[3]) : 0;
+    int stats_s      = argc >= 5 ? std::stoi(argv[4]) : 0;
+    int reactors     = argc >= 6 ? std::stoi(argv[5]) : 1;
+    bool pin         = argc >= 7 && std::string(argv[6]) == "pin";
 
-    // 创建 RPC 服务端并监听指定端口
-    RpcServer s(port);
+    // 创建 RPC 服务端并监听指定端点
+    ServeMode sm = mode == "epoll" ? ServeMode::EPOLL
+                 : mode == "uring" ? ServeMode::URING
+                 : ServeMode::THREAD_PER_CONN;
+    RpcServer s(ep, sm);
 
     // 注册方法
-    s.register_method("add",  handle_add);
-    s.register_method("echo", handle_echo);
+    // add / echo 用类型化注册：参数解码与结果编码由 lambda 签名决定
+    s.bind("add", [](int64_t a, int64_t b){ return a + b; });
+    s.bind("echo", [](std::string_view msg){ return "echo: " + std::string(msg); });
+    s.register_method_view("sum", handle_sum);
+    s.register_method_view("sleep", handle_sleep, MethodOptions{4});
+    MethodOptions cached;
+    cached.cache_ttl = std::chrono::seconds(1);
+    cached.cache_max_bytes = 16u * 1024 * 1024;
+    s.bind("fib", fib, cached);
+    s.register_server_stream("range", handle_range);
+    s.register_client_stream("upload_sum", handle_upload_sum);
+
+    // 可选：handler 交给工作线程池执行，队列上限 1024
+    if (workers > 0) s.set_workers((size_t)workers, 1024);
+    if (stats_s > 0) s.set_stats_dump(std::chrono::seconds(stats_s));
+    // 可选：thread-per-core，多个事件循环各自 accept，由内核按连接分配
+    if (reactors > 1) s.set_reactors((size_t)reactors, pin);
 
     // 启动事件循环，阻塞等待并处理客户端请求
     s.serve();
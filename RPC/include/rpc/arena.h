@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+
+namespace rpc {
+
+/**
+ * RequestArena：一次请求专用的内存区（只增不减，析构时一次性释放）。
+ *   - 服务端把请求参数解码到这里：STRING/BYTES/数组/MAP 的内容不再各自分配
+ *   - 首块 BLOCK_BYTES 取自本线程缓存的空闲块，且只在第一次分配时才取
+ *     （只有标量参数的请求完全不碰它）；稳态下一次请求不做任何堆分配
+ *   - 首块用完后向普通堆按倍增申请，析构时随首块一起归还
+ *   - 单个 deallocate 是空操作；不是线程安全的，只在处理该请求的线程上使用
+ * 从这里分配的 Value 必须在 arena 析构前销毁；需要保留的参数拷贝一份即可（拷贝走普通堆）。
+ */
+class RequestArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t BLOCK_BYTES = 4096;
+
+    RequestArena() = default;
+    ~RequestArena() override;
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override;
+    void  do_deallocate(void*, size_t, size_t) override {}
+    bool  do_is_equal(const std::pmr::memory_resource& o) const noexcept override { return this == &o; }
+
+    unsigned char* block_{nullptr};                          // 首块（借自本线程缓存）
+    size_t used_{0};
+    std::optional<std::pmr::monotonic_buffer_resource> spill_; // 首块之外的部分
+};
+
+} // namespace rpc
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rpc {
+
+/**
+ * BufferPool：帧缓冲区池，按容量分级（256B、512B … 4MB，2 的幂）。
+ *   - acquire(n) 取一个容量 >= n、长度为 0 的缓冲区；池里没有才真正分配
+ *   - release(buf) 把缓冲区按它的容量归还到对应级别（超出分级范围的直接释放）
+ *   - 每个线程一份本地空闲表，无锁；本地满了溢出到全局仓库（加锁），本地空了先从全局取。
+ *     因此“worker 取、事件循环线程还”这种跨线程流动也能循环使用
+ * 缓冲区就是 std::vector<uint8_t>，可以直接交给各个 append_* / recv_body 使用。
+ */
+class BufferPool {
+public:
+    static constexpr size_t MIN_CLASS_BYTES = 256;
+    static constexpr size_t MAX_CLASS_BYTES = 4u * 1024 * 1024;
+
+    static std::vector<uint8_t> acquire(size_t min_capacity = MIN_CLASS_BYTES);
+    static void release(std::vector<uint8_t>&& buf);
+
+    struct Stats {
+        uint64_t hits{0};       // acquire 命中（本地或全局空闲表）
+        uint64_t misses{0};     // acquire 时没有可用缓冲区，新分配
+    };
+    static Stats stats();       // 全进程累计
+};
+
+// 进程内全局 operator new 的调用次数与字节数。用来确认稳态下每个请求几乎不再分配
+// 计数靠替换全局 operator new，放在单独的目标 tiny_rpc_count_allocs（src/count_allocs.cpp）里，
+// 只有链接了它的程序才计数（自带的 server / bench / codec_bench，CMake 选项 TINY_RPC_COUNT_ALLOCS）；
+// 否则不替换 operator new，计数恒为 0
+struct HeapAllocs {
+    uint64_t allocs{0};
+    uint64_t bytes{0};
+};
+HeapAllocs heap_allocs();
+bool heap_alloc_counting();     // 是否链接了计数
+
+// 以下只供 src/count_allocs.cpp 中替换的 operator new 使用
+void count_heap_alloc(size_t bytes);
+void set_heap_alloc_counting(bool on);
+
+} // namespace rpc
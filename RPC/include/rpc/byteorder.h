@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * byteorder：8 字节元素数组 ↔ 大端字节流的批量转换（定长数组类型使用）。
+ *   - 大端主机：整段 memcpy
+ *   - 小端主机：逐元素 bswap，循环体只有 load/bswap/store，编译器会向量化（pshufb 等）
+ * 元素经 memcpy 读写，对齐任意，也不违反严格别名规则。
+ */
+namespace rpc {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  #define RPC_HOST_BIG_ENDIAN 1
+#else
+  #define RPC_HOST_BIG_ENDIAN 0
+#endif
+
+inline uint64_t bswap64(uint64_t v){
+#if defined(_MSC_VER)
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+// n 个 8B 元素（int64_t / double）→ dst 处 n*8 字节大端
+template <class T>
+inline void store_be64_array(uint8_t* dst, const T* src, size_t n){
+    static_assert(sizeof(T) == 8, "8-byte elements only");
+#if RPC_HOST_BIG_ENDIAN
+    if (n) std::memcpy(dst, src, n * 8);
+#else
+    for (size_t i = 0; i < n; ++i){
+        uint64_t u; std::memcpy(&u, src + i, 8);
+        u = bswap64(u);
+        std::memcpy(dst + i * 8, &u, 8);
+    }
+#endif
+}
+
+// src 处 n*8 字节大端 → n 个 8B 元素
+template <class T>
+inline void load_be64_array(T* dst, const uint8_t* src, size_t n){
+    static_assert(sizeof(T) == 8, "8-byte elements only");
+#if RPC_HOST_BIG_ENDIAN
+    if (n) std::memcpy(dst, src, n * 8);
+#else
+    for (size_t i = 0; i < n; ++i){
+        uint64_t u; std::memcpy(&u, src + i * 8, 8);
+        u = bswap64(u);
+        std::memcpy(dst + i, &u, 8);
+    }
+#endif
+}
+
+} // namespace rpc
@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "rpc/client.h"
+#include "rpc/histogram.h"
+
+namespace rpc {
+
+// 一次对冲调用的共享状态，定义在 channel.cpp
+struct HedgeCall;
+
+// 对冲策略（RpcChannel::set_hedging）：主请求等到近期延迟的 percentile 分位仍无响应，
+// 就向另一个副本（只有一个健康副本时换一条连接）发一份副本，先到的响应胜出，另一份本地取消。
+// 额外负载由令牌桶限制：每个对冲调用存入 budget_ratio 个令牌（上限 budget_burst），
+// 发一次副本取 1 个，没有令牌就不对冲（只等主请求）
+struct HedgePolicy {
+    double percentile{95.0};
+    std::chrono::microseconds min_delay{500};       // 延迟下限；样本不足 min_samples 时也用它
+    std::chrono::microseconds max_delay{std::chrono::seconds(1)};
+    uint32_t min_samples{100};
+    double budget_ratio{0.05};                      // 平均至多多发 5% 的请求
+    double budget_burst{20.0};
+};
+
+struct HedgeStats {
+    uint64_t calls{0};              // call_hedged 调用数
+    uint64_t hedges{0};             // 发出的副本数
+    uint64_t hedge_wins{0};         // 副本先于主请求返回
+    uint64_t budget_denied{0};      // 到了对冲时间但令牌不足
+    std::chrono::microseconds delay{0};   // 当前对冲延迟
+};
+
+/**
+ * RpcChannel：面向多个服务端副本的客户端。
+ *   - 每个副本维持 conns_per_endpoint 条常驻连接（连接池，调用时不再建连）
+ *   - 挑选副本用 power-of-two-choices：随机取两个健康副本，选未完成调用数少的一个；
+ *     副本内再选未完成调用数最少的连接。热点/变慢的副本自然分到更少请求
+ *   - 连接断开的副本被剔除，后台线程按指数退避重连，成功后重新加入
+ *   - call 在请求尚未发出（连接已断）时换一个副本重试；已发出的请求不重试（可能已执行）
+ *   - call_hedged：幂等方法的尾延迟对冲（见 HedgePolicy），慢副本/停顿的 handler 不再决定 p999
+ */
+class RpcChannel {
+public:
+    explicit RpcChannel(std::vector<Endpoint> endpoints, size_t conns_per_endpoint = 2);
+    ~RpcChannel();
+
+    RpcChannel(const RpcChannel&) = delete;
+    RpcChannel& operator=(const RpcChannel&) = delete;
+
+    // 建立所有连接并启动后台健康检查；连不上的副本先剔除，之后自动重试
+    // 返回健康副本数（0 也不退出，等待副本上线）
+    size_t connect();
+    void close();
+
+    Response call(const std::string& method, const std::vector<Value>& args);
+    // 请求发出后的连接断开体现为 future 中的 runtime_error
+    std::future<Response> call_async(const std::string& method, const std::vector<Value>& args);
+
+    // 对冲调用：只用于幂等方法（副本可能和主请求都被执行）。未调用 set_hedging 时等同 call
+    Response call_hedged(const std::string& method, const std::vector<Value>& args);
+    void set_hedging(const HedgePolicy& p);      // 需在 connect 前调用
+    HedgeStats hedge_stats() const;
+
+    size_t healthy() const;            // 当前健康副本数
+    // 每个副本的累计分配调用数（与 endpoints 顺序一致），用于观察负载分布
+    std::vector<uint64_t> picks() const;
+
+private:
+    friend struct HedgeCall;
+    using clock = std::chrono::steady_clock;
+    using Pool  = std::vector<std::shared_ptr<RpcClient>>;
+
+    struct Replica {
+        Endpoint ep;
+        std::mutex mu;                      // 保护 pool（重连时整体替换）
+        std::shared_ptr<const Pool> pool;
+        std::atomic<bool> up{false};
+        std::atomic<uint64_t> picks{0};
+        // 以下只由后台线程访问
+        clock::time_point retry_at{};
+        std::chrono::milliseconds backoff{0};
+    };
+
+    std::shared_ptr<const Pool> pool_of(Replica& r);
+    uint32_t outstanding(Replica& r);
+    bool reconnect(Replica& r);
+    void eject(Replica& r);
+    // 选一条连接：p2c 选副本，副本内选最空闲的连接；没有健康副本返回 nullptr
+    // avoid 非空时尽量避开该副本/该连接（对冲的副本请求用）
+    std::shared_ptr<RpcClient> pick(Replica*& owner, const Replica* avoid = nullptr,
+                                    const RpcClient* avoid_conn = nullptr);
+    // 对冲：延迟样本 → 对冲延迟；令牌桶；到期未完成的调用由 hedge_loop 发副本
+    void record_latency(clock::duration d);
+    bool take_hedge_token();
+    void maybe_hedge(const std::shared_ptr<HedgeCall>& st);
+    void hedge_loop();
+    void health_loop();
+
+    size_t conns_per_ep_;
+    std::vector<std::unique_ptr<Replica>> replicas_;
+
+    bool hedging_{false};
+    HedgePolicy hedge_;
+    std::mutex lat_mu_;                          // 保护 lat_
+    LatencyHistogram lat_;                       // 当前窗口的调用延迟
+    std::atomic<int64_t> hedge_delay_us_{0};
+    std::atomic<int64_t> tokens_milli_{0};       // 令牌桶（千分之一个令牌为单位）
+    std::atomic<uint64_t> n_calls_{0}, n_hedges_{0}, n_wins_{0}, n_denied_{0};
+    // 等待对冲的调用，按到期时间先后排队（对冲延迟近似不变，入队顺序即到期顺序）
+    std::mutex hq_mu_;
+    std::condition_variable hq_cv_;
+    std::deque<std::shared_ptr<HedgeCall>> hq_;
+    bool hq_stop_{true};
+    std::thread hedger_;
+
+    std::mutex health_mu_;
+    std::condition_variable health_cv_;
+    bool stop_{true};
+    std::thread health_;
+};
+
+} // namespace rpc
@@ -1,31 +1,299 @@
 #pragma once
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
+#include "rpc/frame.h"
 #include "rpc/protocol.h"
+#include "rpc/transport.h"
+#include "rpc/typed.h"
+#ifdef TINY_RPC_COROUTINES
+#include "rpc/coro.h"
+#endif
 
 namespace rpc {
 
+class RpcClient;
+
+// 客户端一侧进行中的流（两种方向共用），由接收线程与调用方共享
+struct ClientStreamState {
+    std::mutex mu;
+    std::condition_variable cv;
+    std::deque<Value> q;        // 服务端流：已到达未消费的块（不超过 STREAM_WINDOW）
+    uint64_t credit{STREAM_WINDOW}; // 客户端流：还能上传的块数
+    bool done{false};           // 已收到结束帧（STREAM_END / RESPONSE）或连接断开
+    Response final;             // done 后有效：结束状态
+    std::string error;          // 非空：连接断开，next/write 抛出
+};
+
+/**
+ * StreamCall：服务端流的接收端，按块迭代：
+ *     StreamCall s = client.call_stream("range", {...});
+ *     for (const Value& v : s) { ... }
+ *     if (s.result().status != 0) { ... }
+ * 每消费 STREAM_WINDOW/2 块回一次额度；未读完就析构会通知服务端取消。
+ */
+class StreamCall {
+public:
+    StreamCall(StreamCall&&) noexcept = default;
+    StreamCall& operator=(StreamCall&&) = delete;
+    ~StreamCall();
+
+    // 阻塞取下一块；流已结束返回 false；连接断开 → throw runtime_error
+    bool next(Value& out);
+    // next 返回 false 后有效：结束状态（status/err_msg，可带一个尾部结果）
+    const Response& result() const { return st_->final; }
+    // 主动取消：发 STREAM_END，之后 next 只返回已缓存的块
+    void cancel();
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Value*;
+        using reference = const Value&;
+
+        iterator() = default;
+        explicit iterator(StreamCall* s) : s_(s) { ++*this; }
+        const Value& operator*() const { return cur_; }
+        const Value* operator->() const { return &cur_; }
+        iterator& operator++(){ if (s_ && !s_->next(cur_)) s_ = nullptr; return *this; }
+        bool operator==(const iterator& o) const { return s_ == o.s_; }
+        bool operator!=(const iterator& o) const { return s_ != o.s_; }
+    private:
+        StreamCall* s_{nullptr};
+        Value cur_;
+    };
+    iterator begin() { return iterator(this); }
+    iterator end()   { return iterator(); }
+
+private:
+    friend class RpcClient;
+    StreamCall(RpcClient* c, uint32_t id, std::shared_ptr<ClientStreamState> st)
+        : c_(c), id_(id), st_(std::move(st)) {}
+
+    RpcClient* c_;
+    uint32_t id_;
+    std::shared_ptr<ClientStreamState> st_;
+    uint32_t consumed_{0};      // 上次回额度后已消费的块数
+    bool finished_{false};      // 已读到结束或已取消
+};
+
+/**
+ * ClientStream：客户端流的发送端：逐块 write，最后 finish 取回服务端的响应。
+ * 服务端额度用尽时 write 阻塞；服务端提前结束（返回响应/出错）后 write 返回 false。
+ */
+class ClientStream {
+public:
+    ClientStream(ClientStream&&) noexcept = default;
+    ClientStream& operator=(ClientStream&&) = delete;
+    ~ClientStream();
+
+    bool write(const Value& chunk);
+    Response finish();          // 发 STREAM_END 并等待响应（只能调用一次）
+
+private:
+    friend class RpcClient;
+    ClientStream(RpcClient* c, uint32_t id, std::shared_ptr<ClientStreamState> st,
+                 std::future<Response> fut)
+        : c_(c), id_(id), st_(std::move(st)), fut_(std::move(fut)) {}
+
+    RpcClient* c_;
+    uint32_t id_;
+    std::shared_ptr<ClientStreamState> st_;
+    std::future<Response> fut_;
+    bool finished_{false};
+};
+
+#ifdef TINY_RPC_COROUTINES
 /**
- * RpcClient：同步调用示例。简化为“发一个等一个”，便于理解。
- * 后续可以增加接收线程 + promise/future 做并发路由。
+ * CallAwaitable：co_call 的返回值。请求在 co_call 时就已发出，co_await 取响应，
+ * 因此先发出多个再逐个等待就是并发扇出：
+ *     auto a = client.co_call("add", {...});
+ *     auto b = client.co_call("add", {...});      // 与 a 同时在途
+ *     Response ra = co_await a, rb = co_await b;
+ * 响应到达时经 co_await 那一刻本线程的执行器恢复协程（见 coro.h），连接断开 → co_await 处抛出。
+ * 只能 co_await 一次；不等待直接丢弃也安全（响应到达后被忽略）。
+ */
+class CallAwaitable {
+public:
+    bool await_ready() const;
+    bool await_suspend(std::coroutine_handle<> h);   // 响应已到 → false，不挂起
+    Response await_resume();
+
+private:
+    friend class RpcClient;
+    // 接收线程与等待的协程共享
+    struct State {
+        std::mutex mu;
+        std::future<Response> fut;
+        bool ready{false};
+        std::coroutine_handle<> waiter;
+        const Executor* exec{nullptr};
+    };
+    explicit CallAwaitable(std::shared_ptr<State> st) : st_(std::move(st)) {}
+    std::shared_ptr<State> st_;
+};
+#endif
+
+/**
+ * RpcClient：一条连接上的多路复用客户端。
+ *   - 连接可以是 TCP、UNIX socket 或共享内存环（见 transport.h 的 Endpoint）
+ *   - call_async 发出请求后立即返回 future，多个线程可在同一 socket 上流水线调用
+ *   - 后台接收线程按 req_id 把响应路由到 pending_ 中对应的 promise
+ *   - call = call_async(...).get()，保持原来的同步用法
+ *   - 也可以传完成回调（在接收线程上调用），适合大量并发调用不想逐个等 future 的场景
+ *   - 协程中用 co_await co_call(...)（编译选项 TINY_RPC_COROUTINES），等待时不占线程
+ *   - connect_server 时用 __hello 协商线上编码版本（v2 紧凑编码，老服务端回退 v1）
+ *     以及特性（方法 ID：请求帧只带 4B 哈希，不带方法名；BATCH：多个调用合成一帧）
+ *   - 流式调用：call_stream（服务端逐块返回）/ open_client_stream（客户端逐块上传）
+ *   - 超时：call(method, args, timeout) 把剩余预算写进帧头（服务端支持时），
+ *     服务端对已过期的请求不再执行；本地等到截止时间仍无响应则放弃，回 status=4
+ *   - 类型化调用：call<int64_t>("add", 7, 35)，实参直接编码进请求帧（见 typed.h）
  */
 class RpcClient {
 public:
+    // 完成回调：参数是已就绪的 future（get() 取响应，连接断开时抛异常）
+    // 在接收线程上调用：应尽快返回、不得抛异常，也不能在同一个客户端上做同步调用
+    using Callback = std::function<void(std::future<Response>)>;
+
     RpcClient(std::string host, uint16_t port);
+    explicit RpcClient(Endpoint ep);
     ~RpcClient();
 
+    // 协商时声明的最高版本（需在 connect_server 前设置；传 VERSION 即禁用 v2）
+    void set_max_version(uint8_t v) { max_version_ = v; }
+    uint8_t wire_version() const { return wire_version_; }
+    // 是否请求“按方法 ID 调用”特性（需在 connect_server 前设置，默认开启）
+    void set_method_ids(bool on) { want_method_ids_ = on; }
+    bool method_ids() const { return use_method_ids_; }
+
+    // 已连接时先关闭旧连接（旧连接上未完成的调用以连接断开失败）再重连
     void connect_server();
+    bool try_connect_server();   // 连接/协商失败返回 false 而不是退出进程
+    // 同上，但建立连接与 __hello 协商合计最多等 timeout（对端卡住也不会一直阻塞），超时算失败
+    bool try_connect_server(std::chrono::milliseconds timeout);
     void close_client();
+    bool connected() const;      // 接收线程仍在运行（连接未断开）
+    // 已发出、尚未收到响应的调用数（含批量）；无锁读取，供负载均衡使用
+    uint32_t outstanding() const { return outstanding_.load(std::memory_order_relaxed); }
 
     Response call(const std::string& method, const std::vector<Value>& args);
+    std::future<Response> call_async(const std::string& method, const std::vector<Value>& args);
+    // 带超时：timeout <= 0 直接回 status=4；milliseconds::max()（如 handler 的
+    // req.remaining() 在上游没有截止时间时）等同于不带超时
+    Response call(const std::string& method, const std::vector<Value>& args,
+                  std::chrono::milliseconds timeout);
+    // 只把截止时间带给服务端；本地不会放弃等待（调用方可自行 wait_for）
+    std::future<Response> call_async(const std::string& method, const std::vector<Value>& args,
+                                     std::chrono::milliseconds timeout);
+    // 回调版本：响应到达（或连接断开）时调用 done；连接已关闭 → throw，done 不会被调用
+    // 返回请求 id
+    uint32_t call_async(const std::string& method, const std::vector<Value>& args, Callback done,
+                        std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
+    // 放弃回调版本发出的调用 req_id：之后 done 不会再被调用（返回 false = 已完成或不存在，
+    // 此时 done 可能正在或已经被调用）。只是本地放弃，服务端不会因此中止执行，
+    // 响应到达前该调用仍计入 outstanding()
+    bool cancel(uint32_t req_id);
+    bool deadlines() const { return use_deadline_; }
+
+    // 类型化调用：实参按各自类型直接编码进请求帧（不构造 std::vector<Value>），
+    // 结果转换为 R；status != 0 → throw RpcError。R = void 丢弃结果，R = Response 原样返回
+    template <class R, class... A>
+    R call(const std::string& method, const A&... args){
+        uint8_t ver = wire_version_;
+        std::vector<uint8_t>& frame = frame_buffer();
+        frame.clear();
+        uint32_t id = next_id_++;
+        uint8_t* p = begin_request_frame(frame, id, method, wire_method_id(method),
+                                         detail::typed_payload_size(ver, args...), Deadline{}, ver);
+        detail::encode_typed_payload(p, ver, args...);
+        std::future<Response> fut;
+        send_encoded(id, frame, nullptr, &fut, {});
+        return detail::typed_result<R>(fut.get());
+    }
+#ifdef TINY_RPC_COROUTINES
+    // 协程版本（需 TINY_RPC_COROUTINES）：立即发出请求，返回可 co_await 的 CallAwaitable
+    // 等待期间不占线程；timeout 同回调版本，只带给服务端。连接已关闭 → throw
+    CallAwaitable co_call(const std::string& method, const std::vector<Value>& args,
+                          std::chrono::milliseconds timeout = std::chrono::milliseconds::max());
+#endif
+
+    // 批量调用：reqs 中每项只用 method/args（req_id 忽略），一帧发出、一帧收回，
+    // 返回与 reqs 按序对应的响应；服务端不支持 BATCH 时退化为逐个流水线调用
+    std::vector<Response> call_batch(const std::vector<Request>& reqs);
+    std::future<std::vector<Response>> call_batch_async(std::vector<Request> reqs);
+    bool batching() const { return use_batch_; }
+
+    // 服务端流：发出请求，返回可迭代的 StreamCall
+    StreamCall call_stream(const std::string& method, const std::vector<Value>& args);
+    // 客户端流：发出请求，返回用于上传的 ClientStream
+    ClientStream open_client_stream(const std::string& method, const std::vector<Value>& args);
 
 private:
-    std::string host_;
-    uint16_t port_;
-    int fd_{-1};
+    friend class StreamCall;
+    friend class ClientStream;
+
+    // 发出请求帧；stream 非空时同时登记到 streams_，want_reply 时登记 pending_
+    // deadline 非空且服务端支持时写进帧头；done 非空时登记回调（reply 应为空）
+    uint32_t send_request(const std::string& method, const std::vector<Value>& args,
+                          const std::shared_ptr<ClientStreamState>& stream,
+                          std::future<Response>* reply, Deadline deadline = {},
+                          Callback done = {});
+    // 发出已编码好的请求帧 id（登记规则同 send_request）
+    void send_encoded(uint32_t id, const std::vector<uint8_t>& frame,
+                      const std::shared_ptr<ClientStreamState>& stream,
+                      std::future<Response>* reply, Callback done);
+    uint32_t wire_method_id(const std::string& method) const;   // 0 = 按名字发送
+    static std::vector<uint8_t>& frame_buffer();                 // 线程局部的请求编码缓冲区
+    void send_raw(const std::vector<uint8_t>& frame);   // 发送控制帧（CREDIT/END/DATA）
+    void write_frame(const std::vector<uint8_t>& frame);
+    // hello_timeout：__hello 最多等多久（max = 不限）；超时抛 runtime_error
+    void start_session(std::chrono::milliseconds hello_timeout = std::chrono::milliseconds::max());
+    void note_outstanding();
+    void reader_loop();
+    void on_stream_frame(const RawFrameView& rf);           // STREAM_DATA/CREDIT/END
+    void fail_all_pending(const std::string& why);
+
+    Endpoint ep_;
+    std::unique_ptr<Conn> conn_;        // 连接存续期间不变；close_client 在接收线程退出后释放
     std::atomic<uint32_t> next_id_{1};
+    uint8_t max_version_{MAX_VERSION};
+    std::atomic<uint8_t> wire_version_{VERSION};
+    bool want_method_ids_{true};
+    std::atomic<bool> use_method_ids_{false};
+    std::atomic<bool> use_batch_{false};
+    std::atomic<bool> use_deadline_{false};
+
+    // 合并写（见 write_frame）：send_mu_ 保护下面三项，conn_->write 本身不持锁
+    std::mutex send_mu_;
+    bool writing_{false};                // 有线程正在写连接
+    std::vector<uint8_t> send_pending_;  // 写的期间其它线程交来的帧
+    std::vector<uint8_t> send_batch_;    // 正在写的那一批（只由 writing_ 的持有者访问）
+    mutable std::mutex pending_mu_;      // 保护 pending_ 与 closed_
+    // 未完成的普通调用：调用方等 future，或完成时由接收线程调用 done（fut 交给它）
+    struct PendingCall {
+        std::promise<Response> p;
+        std::future<Response> fut;
+        Callback done;
+    };
+    std::unordered_map<uint32_t, PendingCall> pending_;
+    std::unordered_map<uint32_t, std::promise<std::vector<Response>>> pending_batch_;
+    std::unordered_map<uint32_t, std::shared_ptr<ClientStreamState>> streams_;
+    bool closed_{true};
+    std::atomic<uint32_t> outstanding_{0};
+    std::thread reader_;
 };
 
 } // namespace rpc
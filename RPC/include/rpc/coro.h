@@ -0,0 +1,153 @@
+#pragma once
+// C++20 协程接口（CMake 选项 TINY_RPC_COROUTINES，开启后整个工程按 C++20 编译）
+#ifndef TINY_RPC_COROUTINES
+#error "rpc/coro.h requires building with TINY_RPC_COROUTINES=ON (C++20)"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+
+namespace rpc {
+
+// =====================================================
+// Executor：把一个可调用对象交给某个线程执行
+//   事件循环（serve_reactor）在运行期间把自己登记为本线程的当前执行器；
+//   co_await 一个 RPC 调用时记下当时的执行器，响应到达后经它把协程恢复回原线程。
+//   没有执行器（一连接一线程模式、普通线程）时，协程在客户端接收线程上直接恢复
+// =====================================================
+using Executor = std::function<void(std::function<void()>)>;
+
+// 本线程的当前执行器；没有则为空
+const Executor* current_executor();
+
+// 作用域内把 ex 设为本线程的当前执行器，离开时恢复原值
+class ExecutorScope {
+public:
+    explicit ExecutorScope(const Executor* ex);
+    ~ExecutorScope();
+    ExecutorScope(const ExecutorScope&) = delete;
+    ExecutorScope& operator=(const ExecutorScope&) = delete;
+private:
+    const Executor* prev_;
+};
+
+template <class T> class Task;
+
+namespace detail {
+
+// 协程结束时把控制权交给等待者（对称转移，嵌套多层也不会涨栈）
+struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <class P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+        auto next = h.promise().continuation;
+        return next ? next : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }   // 惰性：被 co_await 时才开始
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+// 自行销毁的顶层协程：Task 不能自己启动，由它来 co_await（见 spawn）
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+} // namespace detail
+
+/**
+ * Task<T>：惰性协程，只能被 co_await 一次（或交给 spawn 启动）。
+ *     Task<Response> handler(const Request& req) {
+ *         Response a = co_await client.co_call("add", {...});
+ *         co_return a;
+ *     }
+ * 协程体内抛出的异常在 co_await 处重新抛出。
+ */
+template <class T>
+class Task {
+public:
+    struct promise_type : detail::PromiseBase {
+        std::optional<T> value;
+        Task get_return_object() noexcept {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        template <class U>
+        void return_value(U&& v){ value.emplace(std::forward<U>(v)); }
+    };
+
+    Task(Task&& o) noexcept : h_(std::exchange(o.h_, {})) {}
+    Task& operator=(Task&& o) noexcept {
+        if (this != &o){ if (h_) h_.destroy(); h_ = std::exchange(o.h_, {}); }
+        return *this;
+    }
+    ~Task(){ if (h_) h_.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> waiter) noexcept {
+        h_.promise().continuation = waiter;
+        return h_;
+    }
+    T await_resume(){
+        auto& p = h_.promise();
+        if (p.error) std::rethrow_exception(p.error);
+        return std::move(*p.value);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : h_(h) {}
+    std::coroutine_handle<promise_type> h_;
+};
+
+template <>
+class Task<void> {
+public:
+    struct promise_type : detail::PromiseBase {
+        Task get_return_object() noexcept {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        void return_void() noexcept {}
+    };
+
+    Task(Task&& o) noexcept : h_(std::exchange(o.h_, {})) {}
+    Task& operator=(Task&& o) noexcept {
+        if (this != &o){ if (h_) h_.destroy(); h_ = std::exchange(o.h_, {}); }
+        return *this;
+    }
+    ~Task(){ if (h_) h_.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> waiter) noexcept {
+        h_.promise().continuation = waiter;
+        return h_;
+    }
+    void await_resume(){
+        if (h_.promise().error) std::rethrow_exception(h_.promise().error);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : h_(h) {}
+    std::coroutine_handle<promise_type> h_;
+};
+
+// 在当前线程启动 t，直到它第一次挂起才返回；t 中未捕获的异常会 terminate
+inline void spawn(Task<void> t){
+    [](Task<void> task) -> detail::Detached { co_await task; }(std::move(t));
+}
+
+} // namespace rpc
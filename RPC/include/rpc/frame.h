@@ -2,29 +2,108 @@
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "rpc/protocol.h"
 
 /**
- * 帧层：长度前缀 + 固定头（MAGIC、VERSION、TYPE、REQID、METHODLEN、PAYLOADLEN）
+ * 帧层：长度前缀 + 头（MAGIC、VERSION、TYPE、REQID、METHODLEN、PAYLOADLEN）
+ * v1 头为定长大端；v2 头里 REQID/METHODLEN 为 varint、省略 PAYLOADLEN（取 body 剩余部分）。
+ * TYPE 最高位置 1 表示 METHOD 段是 4B 大端方法 ID 而不是方法名；
+ * 次高位置 1 表示头部带 TIMEOUT_MS（请求的剩余预算）。
  * 与具体 socket 读写分离（读写在 net.h 中）。
  */
 namespace rpc {
 
+// 帧头没有超时字段
+constexpr uint32_t NO_TIMEOUT = 0xFFFFFFFFu;
+
 struct RawFrame {
     MsgType type;
     uint32_t req_id;
     std::string method;         // 仅 Request 用
     std::vector<uint8_t> payload;
+    uint8_t version{VERSION};   // 该帧的编码版本（payload 按此版本解析）
+    uint32_t method_id{};       // 非 0：请求按方法 ID 发送，method 为空
+    uint32_t timeout_ms{NO_TIMEOUT}; // 发送时刻的剩余预算（毫秒）
+};
+
+// RawFrame 的零拷贝视图：method/payload 直接指向接收缓冲区，
+// 只在该缓冲区未被修改/释放前有效（例如一次 handler 调用期间）
+struct RawFrameView {
+    MsgType type;
+    uint32_t req_id;
+    std::string_view method;
+    const uint8_t* payload;
+    size_t payload_len;
+    uint8_t version;
+    uint32_t method_id;         // 非 0：请求按方法 ID 发送，method 为空
+    uint32_t timeout_ms{NO_TIMEOUT};
 };
 
-constexpr uint8_t VERSION = 0x01;
+// build_*：清空 out 后写入一整帧；append_*：追加到 out 末尾（用于复用/合并发送缓冲区）
+// 两者都是单趟编码：先算总长，一次扩容，直接写入最终位置；ver 选择 v1/v2
+void build_request_frame(const Request& req, std::vector<uint8_t>& out, uint8_t ver = VERSION);
+void build_response_frame(const Response& rsp, std::vector<uint8_t>& out, uint8_t ver = VERSION);
+void append_request_frame(const Request& req, std::vector<uint8_t>& out, uint8_t ver = VERSION);
+void append_response_frame(const Response& rsp, std::vector<uint8_t>& out, uint8_t ver = VERSION);
+// 同 append_request_frame(Request)，各字段分开传入（调用方不必为编码构造 Request）
+void append_request_frame(uint32_t req_id, std::string_view method, uint32_t method_id,
+                          const std::vector<Value>& args, Deadline deadline,
+                          std::vector<uint8_t>& out, uint8_t ver = VERSION);
+// 追加一个响应帧，payload 是已编码好的响应 payload（Response::encode_payload_to 的输出）
+void append_encoded_response_frame(uint32_t req_id, const uint8_t* payload, size_t payload_len,
+                                   std::vector<uint8_t>& out, uint8_t ver = VERSION);
+// 追加请求帧头并预留 payload_len 字节，返回 payload 的起始位置（调用方自行写满 payload）
+uint8_t* begin_request_frame(std::vector<uint8_t>& out, uint32_t req_id, std::string_view method,
+                             uint32_t method_id, size_t payload_len, Deadline deadline,
+                             uint8_t ver = VERSION);
 
-void build_request_frame(const Request& req, std::vector<uint8_t>& out);
-void build_response_frame(const Response& rsp, std::vector<uint8_t>& out);
+// ======================= 批量帧（MsgType::BATCH） =======================
+// 帧头与普通帧相同（METHOD 段为空，REQ_ID 为整批的 id），payload 布局：
+//   请求：COUNT ( METHOD_LEN METHOD PAYLOAD_LEN PAYLOAD )*COUNT
+//         METHOD_LEN=0 表示 METHOD 段是 4B 大端方法 ID
+//   响应：COUNT ( PAYLOAD_LEN PAYLOAD )*COUNT，与请求一一按序对应
+//   COUNT/*_LEN：v1 为 4B 大端，v2 为 varint
+// 各项的 req_id 不上线，统一取整批的 id
+
+// 批量请求中的一项（视图，指向批量帧的 payload）
+struct BatchItemView {
+    std::string_view method;    // 按 ID 发送时为空
+    uint32_t method_id;
+    const uint8_t* payload;
+    size_t payload_len;
+};
+
+void append_batch_request_frame(uint32_t batch_id, const std::vector<Request>& reqs,
+                                std::vector<uint8_t>& out, uint8_t ver = VERSION);
+void append_batch_response_frame(uint32_t batch_id, const std::vector<Response>& rsps,
+                                 std::vector<uint8_t>& out, uint8_t ver = VERSION);
+// 把批量请求 payload 切成各项（复用 out 的容量）；格式错误 → throw runtime_error
+void parse_batch_requests(const uint8_t* pl, size_t n, uint8_t ver, std::vector<BatchItemView>& out);
+std::vector<Response> parse_batch_responses(uint32_t batch_id, const uint8_t* pl, size_t n,
+                                            uint8_t ver);
+
+// ======================= 流式帧 =======================
+// STREAM_DATA：payload = 一个 Value；STREAM_CREDIT：payload = INT64 Value（追加的块数）
+// STREAM_END ：带 Response（服务端流的结束状态）或空 payload（客户端流结束 / 接收方取消）
+void append_stream_data_frame(uint32_t req_id, const Value& chunk, std::vector<uint8_t>& out,
+                              uint8_t ver = VERSION);
+void append_stream_credit_frame(uint32_t req_id, uint32_t n, std::vector<uint8_t>& out,
+                                uint8_t ver = VERSION);
+void append_stream_end_frame(const Response& rsp, std::vector<uint8_t>& out, uint8_t ver = VERSION);
+void append_stream_end_frame(uint32_t req_id, std::vector<uint8_t>& out, uint8_t ver = VERSION);
 
 // 从完整的“帧体”（不含4字节长度前缀）解析出 RawFrame。
 // 注意：长度前缀的读取在 net 层负责；这里仅校验MAGIC/VERSION并切出method/payload。
+// v1/v2 帧都可解析，版本记录在返回值的 version 字段。
 RawFrame parse_body_to_frame(const std::vector<uint8_t>& body);
+// 同上，但直接解析一段连续内存（事件循环里的接收缓冲区无需再拷出一个 vector）
+RawFrame parse_body_to_frame(const uint8_t* body, size_t n);
+// 同样的校验，但不拷贝 method/payload
+RawFrameView parse_body_to_view(const uint8_t* body, size_t n);
+
+// 单帧 body 上限：事件驱动模式下用于拒绝异常长度前缀，避免一个连接撑爆内存
+constexpr uint32_t MAX_BODY_LEN = 64u * 1024 * 1024;
 
 } // namespace rpc
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace rpc {
+
+/**
+ * LatencyHistogram：HDR 风格的对数-线性直方图（单位纳秒）。
+ *   - 每个 2 的幂区间再均分 2^SUB_BITS 个子桶，任意值的相对误差 < 1/2^SUB_BITS（约 0.8%）
+ *   - 记录是一次下标计算 + 一次自增，不分配内存；桶数固定（约 4K 个 uint64）
+ *   - 不加锁：每个线程各用一个，结束后 merge
+ *   - 超出量程（约 18 分钟）的值记入最后一个桶
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t ns){
+        size_t i = index_of(ns);
+        ++counts_[i];
+        ++total_;
+        sum_ += ns;
+        if (ns < min_) min_ = ns;
+        if (ns > max_) max_ = ns;
+    }
+    void merge(const LatencyHistogram& o);
+    void reset();
+
+    uint64_t count() const { return total_; }
+    uint64_t min() const { return total_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double   mean() const { return total_ ? (double)sum_ / (double)total_ : 0.0; }
+    // p ∈ [0, 100]；返回该分位所在桶的上界（与 HDR 的 highest equivalent value 一致）
+    uint64_t percentile(double p) const;
+
+private:
+    static constexpr int SUB_BITS = 7;
+    static constexpr int MAX_BITS = 40;      // 2^40 ns ≈ 18 分钟
+    static constexpr size_t SUB_COUNT = size_t(1) << SUB_BITS;
+    static constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+    static size_t index_of(uint64_t v){
+        if (v < SUB_COUNT) return (size_t)v;
+        if (v >= (uint64_t(1) << MAX_BITS)) return BUCKETS - 1;
+        int e = highest_bit(v);
+        int shift = e - SUB_BITS;
+        return (size_t)(shift + 1) * SUB_COUNT + (size_t)((v >> shift) - SUB_COUNT);
+    }
+    static int highest_bit(uint64_t v){
+#if defined(_MSC_VER)
+        unsigned long r;
+        _BitScanReverse64(&r, v);
+        return (int)r;
+#else
+        return 63 - __builtin_clzll(v);
+#endif
+    }
+    static uint64_t upper_of(size_t i);
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_{0};
+    uint64_t sum_{0};
+    uint64_t min_{UINT64_MAX};
+    uint64_t max_{0};
+};
+
+} // namespace rpc
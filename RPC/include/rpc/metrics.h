@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "rpc/histogram.h"
+#include "rpc/value.h"
+
+namespace rpc {
+
+// 连接级 I/O 计数：事件循环 / 连接线程按系统调用累加（relaxed 原子），任意线程可读
+struct IoCounters {
+    std::atomic<int64_t>  connections{0};   // 当前活跃连接数
+    std::atomic<uint64_t> accepted{0};      // 累计接受的连接数
+    std::atomic<uint64_t> bytes_in{0};
+    std::atomic<uint64_t> bytes_out{0};
+    std::atomic<uint64_t> syscalls{0};      // 事件循环模式下的 I/O 系统调用次数（一连接一线程模式不统计）
+};
+
+// 一个方法的统计（所有分片合并后）
+struct MethodStats {
+    std::string name;
+    uint64_t started{0};        // 已接收（含排队中、执行中）的调用数
+    uint64_t completed{0};      // 已回包的调用数（含出错/被拒/过期）
+    uint64_t errors{0};         // handler 返回非 0 或抛异常
+    uint64_t rejected{0};       // 并发上限 / 队列已满（status=3）
+    uint64_t expired{0};        // 截止时间已过、未执行（status=4）
+    uint64_t cached{0};         // 响应缓存命中（计入 completed，未执行 handler）
+    LatencyHistogram latency;   // 收到请求 → 响应就绪（含排队），纳秒；被拒/过期不计
+
+    uint64_t inflight() const { return started > completed ? started - completed : 0; }
+};
+
+// 某一时刻的服务端统计：__stats 的返回值与周期性文本输出都由它生成
+struct StatsSnapshot {
+    uint64_t uptime_ms{0};
+    int64_t  connections{0};
+    uint64_t accepted{0};
+    uint64_t bytes_in{0};
+    uint64_t bytes_out{0};
+    uint64_t syscalls{0};
+    uint64_t heap_allocs{0};    // 进程累计堆分配次数（见 buffer_pool.h；未编译计数时为 0）
+    uint64_t pool_hits{0};      // BufferPool 命中 / 新分配次数
+    uint64_t pool_misses{0};
+    uint64_t queue_depth{0};    // 工作线程池排队数（未启用为 0）
+    uint64_t unknown{0};        // 未知方法的调用数
+    std::vector<MethodStats> methods;   // 按 completed 降序
+
+    uint64_t inflight() const;
+    // MAP：uptime_ms/connections/.../methods(MAP 方法名 → MAP 计数与 p50/p99/p999/max 微秒)
+    Value to_value() const;
+    // 多行文本；prev 非空时附带两次快照之间的调用速率
+    std::string to_text(const StatsSnapshot* prev = nullptr) const;
+};
+
+/**
+ * ServerMetrics：按方法的计数与延迟直方图。
+ *   - 分片数按 CPU 数固定，线程按首次写入的先后轮流落到分片上；同时写的线程不多于
+ *     分片数时各写各的，热路径基本只是一次无竞争加锁
+ *   - 方法按注册时分配的槽位索引（add_method）；同名方法重复注册时读取时按名字合并
+ *   - 线程退出不影响计数；线程再多（一连接一线程的短连接），内存与读取合并开销也不增长
+ */
+class ServerMetrics {
+public:
+    using clock = std::chrono::steady_clock;
+
+    ServerMetrics();
+    ~ServerMetrics();
+
+    ServerMetrics(const ServerMetrics&) = delete;
+    ServerMetrics& operator=(const ServerMetrics&) = delete;
+
+    uint32_t add_method(const std::string& name);     // 返回槽位号
+    void on_start(uint32_t slot);
+    // status：0=成功 3=被拒 4=过期 其它=出错；received 为收到请求的时刻
+    void on_finish(uint32_t slot, uint16_t status, clock::time_point received);
+    // 响应缓存命中：计为一次成功完成
+    void on_cached(uint32_t slot, clock::time_point received);
+    void on_unknown();
+
+    IoCounters io;
+
+    // 合并全部分片（queue_depth 由调用方填写）
+    StatsSnapshot snapshot() const;
+
+private:
+    struct Cell {
+        uint64_t started{0}, completed{0}, errors{0}, rejected{0}, expired{0}, cached{0};
+        LatencyHistogram latency;
+    };
+    struct Shard {
+        std::mutex mu;
+        std::vector<std::unique_ptr<Cell>> cells;   // 按槽位，首次用到时分配
+        uint64_t unknown{0};
+    };
+
+    Shard& local();
+    static Cell& cell(Shard& s, uint32_t slot);
+
+    clock::time_point start_;
+    mutable std::mutex mu_;                         // 保护 names_
+    std::vector<std::unique_ptr<Shard>> shards_;    // 构造后不再变动
+    std::vector<std::string> names_;
+};
+
+} // namespace rpc
@@ -27,6 +27,7 @@
   #include <sys/socket.h>
   #include <sys/types.h>
   #include <unistd.h>
+  #include <fcntl.h>
   #include <errno.h>
   using socket_t = int;
   #define INVALID_SOCKET_T (-1)
@@ -47,17 +48,41 @@ namespace rpc {
 [[noreturn]] void die(const std::string& msg);
 
 // 建立监听/连接：返回 socket_t（Windows 是 SOCKET，Linux 是 int）
-socket_t tcp_listen(uint16_t port);
+// host：监听地址（IPv4/IPv6 字面量或主机名；空串或 0.0.0.0 = 所有 IPv4 网卡）
+// reuse_port：设 SO_REUSEPORT，多个 socket 可监听同一端口，内核按连接哈希分给它们（多事件循环用）
+socket_t tcp_listen(const std::string& host, uint16_t port, bool reuse_port = false);
+socket_t tcp_listen(uint16_t port, bool reuse_port = false);   // 监听所有 IPv4 网卡
 socket_t tcp_connect(const std::string& host, uint16_t port);
+// 连接失败返回 INVALID_SOCKET_T（不退出），用于需要容忍对端宕机的场景
+// timeout_ms > 0：连接最多等这么久（对端不回 SYN-ACK / accept 队列满），超时同失败；0 = 不限
+socket_t tcp_try_connect(const std::string& host, uint16_t port, int timeout_ms = 0);
+// AF_UNIX 流式 socket（同机进程间）：监听前删除残留的 socket 文件；Windows 不支持
+socket_t unix_listen(const std::string& path);
+socket_t unix_try_connect(const std::string& path, int timeout_ms = 0);
 
 void close_fd(socket_t s);
+// 关闭双向读写但不释放 fd：用于唤醒阻塞在 recv 上的其它线程
+void shutdown_fd(socket_t s);
+
+// 设为非阻塞（事件驱动模式使用）
+void set_nonblock(socket_t s);
+// TCP_NODELAY：关闭 Nagle（tcp_listen / tcp_try_connect 已调用；只对 TCP socket 有意义）
+void set_nodelay(socket_t s);
 
 // 可靠写/读 n 字节
 void write_n(socket_t s, const void* buf, size_t n);
 bool read_n(socket_t s, void* buf, size_t n);
+// 读到至多 n 字节（阻塞到至少 1 字节），返回读到的字节数；对端关闭返回 0
+size_t recv_some(socket_t s, void* buf, size_t n);
+// 可靠写 n 字节，出错返回 false（不退出、不触发 SIGPIPE）
+bool try_write_n(socket_t s, const void* buf, size_t n);
 
 // 发送/接收一帧（4B 大端长度 + body）
 void send_frame(socket_t s, const std::vector<uint8_t>& frame);
 std::optional<RawFrame> recv_frame(socket_t s);
+// 只读一帧 body（不含长度前缀）到 body，复用其容量；对端关闭返回 false
+bool recv_body(socket_t s, std::vector<uint8_t>& body);
+// 解析 4B 大端长度前缀；超过 MAX_BODY_LEN → throw runtime_error
+uint32_t decode_body_len(const uint8_t len4[4]);
 
 } // namespace rpc
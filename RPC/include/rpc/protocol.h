@@ -1,7 +1,9 @@
 #pragma once
+#include <chrono>
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 #include "rpc/value.h"
@@ -16,13 +18,92 @@ enum class MsgType : uint8_t {
     REQUEST  = 1,
     RESPONSE = 2,
     ERROR    = 3, // 预留
+    BATCH    = 4, // 批量：客户端 → 服务端为 N 个请求，服务端 → 客户端为按序的 N 个响应
+    // 流式调用（同一 req_id 下的多帧），见 STREAM_WINDOW
+    STREAM_DATA   = 5, // 一块数据：payload 为一个编码后的 Value
+    STREAM_END    = 6, // 发送方：流结束（服务端流带 Response payload）；接收方：取消
+    STREAM_CREDIT = 7, // 接收方追加额度：payload 为 INT64 Value（块数）
 };
 
+// 流控窗口（块数）：流开始时发送方默认拥有 STREAM_WINDOW 块额度，每发一块减一，
+// 额度为 0 时阻塞；接收方每消费 STREAM_WINDOW/2 块回一个 STREAM_CREDIT。
+// 因此接收方缓存的未消费块数不超过 STREAM_WINDOW，慢消费者不会让对端内存无界增长
+constexpr uint32_t STREAM_WINDOW = 32;
+
+// 线上编码版本（写在帧头 VERSION 字节里，每帧自描述）：
+//   v1：定长大端（INT64 8B，长度 4B）
+//   v2：紧凑编码（INT64 zigzag varint，长度/argc/status 为 LEB128 varint）
+constexpr uint8_t VERSION     = 0x01;
+constexpr uint8_t VERSION_V2  = 0x02;
+constexpr uint8_t MAX_VERSION = VERSION_V2;
+
+// 保留方法：连接建立后客户端用 v1 发 __hello(max_version, features)，
+// 服务端回 version | (features << 8)：version = min(自身, 客户端)，features 为双方都支持的特性位；
+// 老服务端回“未知方法”则保持 v1、不启用任何特性
+constexpr const char* HELLO_METHOD = "__hello";
+// 保留方法：无参数，返回服务端统计（MAP，见 metrics.h 的 StatsSnapshot::to_value）
+constexpr const char* STATS_METHOD = "__stats";
+
+// 特性位：FEATURE_METHOD_ID = 请求帧可用 32 位方法 ID 代替方法名
+//         FEATURE_BATCH     = 服务端接受 BATCH 帧
+//         FEATURE_DEADLINE  = 请求帧头可带超时（TYPE 的 FLAG_DEADLINE 位）
+constexpr uint32_t FEATURE_METHOD_ID = 1u << 0;
+constexpr uint32_t FEATURE_BATCH     = 1u << 1;
+constexpr uint32_t FEATURE_DEADLINE  = 1u << 2;
+
+// 响应状态码
+//   0=OK 1=未知方法 2=服务端异常 3=忙/过载 4=截止时间已过（服务端未执行 handler）
+constexpr uint16_t STATUS_DEADLINE_EXCEEDED = 4;
+
+// 截止时间：本机单调时钟上的绝对时刻；默认值（epoch）表示“没有截止时间”
+// 线上只传剩余毫秒数（相对值），两端时钟不需要同步
+using Deadline = std::chrono::steady_clock::time_point;
+
+inline bool has_deadline(Deadline d){ return d != Deadline{}; }
+
+// 剩余预算（可能为负）；没有截止时间返回 milliseconds::max()
+inline std::chrono::milliseconds remaining_budget(Deadline d){
+    if (!has_deadline(d)) return std::chrono::milliseconds::max();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(d - std::chrono::steady_clock::now());
+}
+
+// 方法 ID：方法名的 FNV-1a 32 位哈希（0 保留表示“按名字发送”）
+// 服务端注册时检测冲突，两端独立计算即可，无需额外交换映射表
+constexpr uint32_t method_id_of(std::string_view name){
+    uint32_t h = 2166136261u;
+    for (char c : name){ h ^= (uint8_t)c; h *= 16777619u; }
+    return h ? h : 1;
+}
+
 struct Request {
     uint32_t req_id{};
     std::string method;
     std::vector<Value> args;
-    std::vector<uint8_t> encode_payload() const;
+    uint32_t method_id{};  // 非 0 时帧里只写这 4 字节 ID，不写方法名
+    // 客户端：设置后帧头带上剩余毫秒数；服务端：按到达时刻 + 帧头超时换算，供 handler 查询
+    Deadline deadline{};
+    std::vector<uint8_t> encode_payload(uint8_t ver = VERSION) const;
+
+    // 剩余预算：handler 调下游时可直接传给 RpcClient::call 的 timeout
+    std::chrono::milliseconds remaining() const { return remaining_budget(deadline); }
+
+    // 单趟编码：先算出 payload 字节数，再直接写入调用方给的内存
+    size_t   payload_size(uint8_t ver = VERSION) const;
+    uint8_t* encode_payload_to(uint8_t* p, uint8_t ver = VERSION) const; // 返回写入末尾
+};
+
+/**
+ * RequestView：Request 的零拷贝视图。method 与 STRING 参数都指向接收缓冲区，
+ * 仅在一次 handler 调用期间有效。args 可跨请求复用（clear 后容量保留），
+ * 因此只读参数的 handler 在稳态下不产生任何堆分配。
+ */
+struct RequestView {
+    uint32_t req_id{};
+    std::string_view method;
+    std::vector<ValueView> args;
+    Deadline deadline{};
+
+    std::chrono::milliseconds remaining() const { return remaining_budget(deadline); }
 };
 
 struct Response {
@@ -32,17 +113,57 @@ struct Response {
     bool has_result{false};
     Value result;
 
-    std::vector<uint8_t> encode_payload() const;
+    std::vector<uint8_t> encode_payload(uint8_t ver = VERSION) const;
+
+    size_t   payload_size(uint8_t ver = VERSION) const;
+    uint8_t* encode_payload_to(uint8_t* p, uint8_t ver = VERSION) const;
 };
 
-// Value 编解码（对 payload 内部）
-void encode_value(std::vector<uint8_t>& out, const Value& v);
-std::pair<Value,size_t> decode_value(const uint8_t* p, size_t n);
+// Value 编解码（对 payload 内部），ver 选择 v1/v2 编码
+void encode_value(std::vector<uint8_t>& out, const Value& v, uint8_t ver = VERSION);
+// 单趟编码用：Value 编码后的字节数 / 写入 p 并返回末尾指针（p 需有足够空间）
+size_t   encoded_size(const Value& v, uint8_t ver = VERSION);
+uint8_t* encode_value_to(uint8_t* p, const Value& v, uint8_t ver = VERSION);
+// 请求 payload（参数个数 + 各参数）的字节数 / 写入 p；Request::payload_size 等即基于它们
+size_t   args_payload_size(const std::vector<Value>& args, uint8_t ver = VERSION);
+uint8_t* encode_args_to(uint8_t* p, const std::vector<Value>& args, uint8_t ver = VERSION);
+// mr：STRING/BYTES/数组/容器内容的分配来源（默认普通堆）
+std::pair<Value,size_t> decode_value(const uint8_t* p, size_t n, uint8_t ver = VERSION,
+                                     std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+std::pair<ValueView,size_t> decode_value_view(const uint8_t* p, size_t n, uint8_t ver = VERSION);
+
+// 单值直接编码（不经过 Value，类型化接口用，见 typed.h）：字节与 encode_value_to 完全相同
+size_t   encoded_size_int(int64_t v, uint8_t ver = VERSION);
+uint8_t* encode_int_to(uint8_t* p, int64_t v, uint8_t ver = VERSION);
+uint8_t* encode_double_to(uint8_t* p, double v);                  // 固定 9 字节
+uint8_t* encode_bool_to(uint8_t* p, bool v);                      // 固定 2 字节
+size_t   encoded_size_bytes(size_t len, uint8_t ver = VERSION);   // STRING/BYTES
+uint8_t* encode_bytes_to(uint8_t* p, ValueType t, std::string_view b, uint8_t ver = VERSION);
+size_t   encoded_size_array8(size_t count, uint8_t ver = VERSION); // INT64_ARRAY/F64_ARRAY
+uint8_t* encode_i64_array_to(uint8_t* p, const int64_t* a, size_t count, uint8_t ver = VERSION);
+uint8_t* encode_f64_array_to(uint8_t* p, const double* a, size_t count, uint8_t ver = VERSION);
+// 请求 payload 开头的参数个数字段；decode_argc 返回消费的字节数，字节不足 → throw
+size_t   argc_size(size_t argc, uint8_t ver = VERSION);
+uint8_t* encode_argc_to(uint8_t* p, size_t argc, uint8_t ver = VERSION);
+size_t   decode_argc(const uint8_t* p, size_t n, uint8_t ver, uint64_t& argc);
 
 // payload 解析
 Request  parse_request_payload(uint32_t req_id, const std::string& method,
-                               const std::vector<uint8_t>& pl);
+                               const std::vector<uint8_t>& pl, uint8_t ver = VERSION);
+Request  parse_request_payload(uint32_t req_id, std::string_view method,
+                               const uint8_t* pl, size_t n, uint8_t ver = VERSION);
+// 解析到 out（复用 out.args 的容量），参数内容从 mr 分配（如本次请求的 RequestArena）；
+// out.args 必须在 mr 释放前清空
+void     parse_request_payload(uint32_t req_id, std::string_view method,
+                               const uint8_t* pl, size_t n, Request& out,
+                               std::pmr::memory_resource* mr, uint8_t ver = VERSION);
+// 零拷贝解析到 out（复用 out.args 的容量）
+void     parse_request_view(uint32_t req_id, std::string_view method,
+                            const uint8_t* pl, size_t n, RequestView& out,
+                            uint8_t ver = VERSION);
+Response parse_response_payload(uint32_t req_id,
+                                const std::vector<uint8_t>& pl, uint8_t ver = VERSION);
 Response parse_response_payload(uint32_t req_id,
-                                const std::vector<uint8_t>& pl);
+                                const uint8_t* pl, size_t n, uint8_t ver = VERSION);
 
 } // namespace rpc
@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "rpc/frame.h"
+#include "rpc/metrics.h"
+#include "rpc/net.h"
+
+namespace rpc {
+
+/**
+ * Reactor：单线程 epoll 事件循环（仅 Linux）。
+ * 所有连接都是非阻塞 socket，每个连接维护自己的接收/发送缓冲区：
+ *   - 可读：尽量读空内核缓冲区，按 4B 长度前缀增量拼出完整帧，零拷贝地交给 on_frame
+ *   - 可写：一轮 epoll_wait 的事件处理完后，把这一轮里各连接产生的全部响应
+ *           （on_frame 内联追加的 + post 交回的）各用一次 sendmsg 写出，写不完再关注 EPOLLOUT
+ * 空闲连接只占一个 fd + 两个空缓冲区，不再占一个线程栈。
+ * 背压：某连接待发送的字节超过高水位时暂停读它（取消 EPOLLIN、不再切帧），
+ * 降到低水位以下再恢复，对端只发不收时服务端内存不会无限增长。
+ * 其它线程（如工作线程池）可通过 post() 把响应异步交回某个连接，由 eventfd 唤醒事件循环；
+ * dispatch() 则把任意任务交给事件循环线程执行。
+ * 对端半关闭（shutdown 写方向）后不再读，等已收到的帧都处理完、响应（含 hold 住的异步回包）
+ * 都发完才关闭连接。
+ */
+class Reactor {
+public:
+    // 连接句柄：fd 会被复用，用 id 区分“同一个 fd 上的新连接”
+    struct ConnRef {
+        socket_t fd;
+        uint64_t id;
+    };
+
+    // 收到一帧后的回调：把需要立即回给对端的字节追加到 out（可以不追加），
+    // 或记下 conn 稍后通过 post() 异步回包
+    // 帧视图指向连接的接收缓冲区，只在回调期间有效
+    using FrameHandler = std::function<void(ConnRef conn, const RawFrameView&,
+                                            std::vector<uint8_t>& out)>;
+
+    // 连接关闭时的回调（在事件循环线程调用，此后该 conn 的 post 都会被丢弃）
+    using CloseHandler = std::function<void(ConnRef conn)>;
+
+    Reactor(socket_t listen_fd, FrameHandler on_frame);
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    void run(); // 阻塞运行事件循环
+    void set_on_close(CloseHandler h) { on_close_ = std::move(h); }
+    // 连接数、收发字节数与系统调用次数累加到 io（需在 run() 前设置；为空则不统计）
+    void set_io_counters(IoCounters* io) { io_ = io; }
+
+    // 线程安全：把 bytes 追加到 conn 的发送缓冲区（连接已关闭则丢弃）
+    void post(ConnRef conn, std::vector<uint8_t> bytes);
+    // 异步回包登记：hold 只在事件循环线程（on_frame 中）调用，表示还有一个回包会经 post 到来；
+    // 回包 post 之后调用 unhold（线程安全，与 post 保序）。对端半关闭时等 hold 全部归还才关闭
+    void hold(ConnRef conn);
+    void unhold(ConnRef conn);
+    // 线程安全：让事件循环线程执行 fn（如恢复协程），与 post 共用一次唤醒
+    void dispatch(std::function<void()> fn);
+
+private:
+    struct Conn {
+        socket_t fd{INVALID_SOCKET_T};
+        uint64_t id{0};
+        std::vector<uint8_t> in;   // 未解析完的接收字节（取自 BufferPool，关闭时归还）
+        // 待发送的段，按产生顺序：on_frame 追加到最后一段；post 交回的大块整段挂上（不复制）
+        // 至少有一段；全部发完后只留第一段（清空）复用
+        std::vector<std::vector<uint8_t>> out;
+        size_t out_seg{0};         // 第一个未发完的段
+        size_t out_off{0};         // 该段已发送的前缀长度
+        bool want_write{false};    // 当前是否关注 EPOLLOUT
+        bool dirty{false};         // 本轮有新响应，已记在 dirty_ 里
+        bool paused{false};        // 待发送超过高水位：暂停读取与切帧
+        bool eof{false};           // 对端已半关闭：剩余的帧处理完、响应写完后关闭
+        uint32_t events{0};        // 当前在 epoll 中注册的事件
+        uint32_t holds{0};         // 尚未回包的异步任务（hold - unhold）
+
+        size_t pending() const {   // 尚未发送的字节数
+            size_t n = 0;
+            for (size_t i = out_seg; i < out.size(); ++i) n += out[i].size();
+            return n - out_off;
+        }
+    };
+
+    void on_accept();
+    void on_wakeup();
+    void on_readable(Conn& c);
+    bool handle_input(Conn& c);   // 从 c.in 切帧并回调；返回 false 表示连接已关闭
+    void resume_reading();        // 处理本轮降到低水位的连接：先切完已收下的帧
+    bool flush(Conn& c);          // 返回 false 表示连接已出错
+    void mark_dirty(Conn& c);     // 本轮结束时 flush
+    void flush_dirty();
+    void update_events(Conn& c, bool want_write);   // 按 want_write、paused 与 eof 更新注册的事件
+    void maybe_resume(Conn& c);   // flush 后降到低水位：取消暂停
+    static bool finished(const Conn& c);   // 半关闭且帧已切完、响应已发完、没有待回的异步任务
+    void close_conn(socket_t fd);
+    void wake();                  // 写 eventfd 唤醒事件循环
+    void note_syscall(uint64_t n = 1){ if (io_) io_->syscalls.fetch_add(n, std::memory_order_relaxed); }
+
+    socket_t listen_fd_;
+    int epfd_{-1};
+    int wake_fd_{-1};              // eventfd：post() 写入，事件循环读出
+    uint64_t next_conn_id_{1};
+    FrameHandler on_frame_;
+    CloseHandler on_close_;
+    IoCounters* io_{nullptr};
+    std::unordered_map<socket_t, Conn> conns_;
+    std::vector<ConnRef> dirty_;   // 本轮产生了响应、尚未 flush 的连接
+    std::vector<ConnRef> resumed_; // 本轮降到低水位、恢复读取的连接
+
+    struct Posted {
+        ConnRef conn;
+        std::vector<uint8_t> bytes;
+        bool unhold{false};        // unhold() 的登记（bytes 为空）
+    };
+    std::mutex post_mu_;           // 保护 posted_ 与 tasks_
+    std::vector<Posted> posted_;
+    std::vector<std::function<void()>> tasks_;
+    // on_wakeup 与上面两个队列交换用的空队列（只在事件循环线程访问），两边的容量来回复用
+    std::vector<Posted> wake_batch_;
+    std::vector<std::function<void()>> wake_tasks_;
+};
+
+} // namespace rpc
@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rpc {
+
+/**
+ * ResponseCache：一个可缓存方法的响应缓存（MethodOptions::cache_ttl 非 0 时由服务端创建）。
+ *   - key = 线上版本 + 请求 payload 原始字节（即编码后的参数），方法由“每个方法一份缓存”区分
+ *   - value = 已编码的响应 payload；命中时只按新 req_id 写帧头再整段复制，
+ *     不解码参数、不调 handler、不编码结果
+ *   - 按 key 的哈希分成 SHARDS 个分片，各自一把锁、一条 LRU 链；max_bytes 平分给各分片，
+ *     超出时从链尾淘汰；条目过了 ttl 在下次查到时删除
+ * 只应给纯函数式（相同参数总是相同结果、没有副作用）的方法开启。线程安全。
+ */
+class ResponseCache {
+public:
+    static constexpr size_t SHARDS = 16;
+
+    ResponseCache(std::chrono::milliseconds ttl, size_t max_bytes);
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    // 命中：把缓存的响应以 req_id 编成一整帧追加到 out，返回 true；未命中/已过期返回 false
+    bool lookup(uint8_t ver, const uint8_t* args, size_t args_len, uint32_t req_id,
+                std::vector<uint8_t>& out);
+    // 记下 args → 响应 payload（调用方只应对 status=0 的响应调用）；单条超过分片容量则不缓存
+    void insert(uint8_t ver, const uint8_t* args, size_t args_len,
+                const uint8_t* rsp_payload, size_t rsp_len);
+
+    struct Stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t evictions{0};   // 容量淘汰（不含过期）
+        uint64_t entries{0};
+        uint64_t bytes{0};
+    };
+    Stats stats() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Node {
+        std::string key;                 // VERSION(1B) + 请求 payload
+        std::vector<uint8_t> payload;    // 已编码的响应 payload
+        clock::time_point expires;
+    };
+    using Lru = std::list<Node>;         // 头部最近使用
+
+    struct alignas(64) Shard {
+        mutable std::mutex mu;
+        Lru lru;
+        std::unordered_map<std::string_view, Lru::iterator> index;   // key 指向 Node::key
+        size_t bytes{0};
+        uint64_t hits{0}, misses{0}, evictions{0};
+    };
+
+    static size_t charge(const Node& n);
+    void erase(Shard& s, Lru::iterator it);
+
+    std::chrono::milliseconds ttl_;
+    size_t shard_bytes_;
+    std::unique_ptr<Shard[]> shards_;
+};
+
+} // namespace rpc
@@ -1,35 +1,291 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <functional>
-#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+#include "rpc/frame.h"
+#include "rpc/metrics.h"
 #include "rpc/protocol.h"
+#include "rpc/response_cache.h"
+#include "rpc/thread_pool.h"
+#include "rpc/transport.h"
+#include "rpc/typed.h"
+#ifdef TINY_RPC_COROUTINES
+#include "rpc/coro.h"
+#endif
 
 namespace rpc {
 
+// 服务模式：
+//   THREAD_PER_CONN：一连接一线程，阻塞读写（默认，最直观）
+//   EPOLL          ：单线程事件循环 + 非阻塞 socket（仅 Linux，适合大量空闲长连接）
+//                    共享内存传输没有可交给 epoll 的数据 fd，总是一连接一线程
+//   URING          ：单线程 io_uring 事件循环（编译选项 TINY_RPC_IO_URING；内核不支持时回退 EPOLL）
+enum class ServeMode : uint8_t {
+    THREAD_PER_CONN = 0,
+    EPOLL           = 1,
+    URING           = 2,
+};
+
+// 注册方法时的可选参数
+struct MethodOptions {
+    // 该方法同时执行的调用数上限；0 = 不限。超出时直接回 status=3（busy）
+    uint32_t max_concurrency{0};
+    // 响应缓存（见 response_cache.h）：非 0 时相同参数的成功响应缓存 cache_ttl，
+    // 命中直接回已编码的响应字节。只用于纯函数式方法；流式/协程方法与 BATCH 内的调用不走缓存
+    std::chrono::milliseconds cache_ttl{0};
+    size_t cache_max_bytes{64u * 1024 * 1024};     // 该方法缓存占用的内存上限
+};
+
+// 流的共享状态（额度、已到达的块、结束/取消标记），定义在 server.cpp
+struct StreamState;
+// 协程 handler 的回包交接状态，定义在 server.cpp
+struct CoroReply;
+
+/**
+ * StreamWriter：服务端流 handler 用它逐块发送结果（同一 req_id 下的 STREAM_DATA 帧）。
+ * 额度用尽时 write 阻塞，直到客户端消费后回 STREAM_CREDIT。
+ */
+class StreamWriter {
+public:
+    // 发送一块；连接已关闭或客户端已取消 → 返回 false（handler 应尽快返回）
+    bool write(const Value& chunk);
+    bool cancelled() const;
+
+private:
+    friend class RpcServer;
+    StreamWriter(uint32_t req_id, uint8_t ver, std::function<void(std::vector<uint8_t>&&)> reply,
+                 std::shared_ptr<StreamState> st);
+
+    uint32_t req_id_;
+    uint8_t ver_;
+    std::function<void(std::vector<uint8_t>&&)> reply_;
+    std::shared_ptr<StreamState> st_;
+};
+
+/**
+ * StreamReader：客户端流 handler 用它逐块读取客户端上传的数据。
+ * 每消费 STREAM_WINDOW/2 块给客户端回一次额度。
+ */
+class StreamReader {
+public:
+    // 取下一块到 out；客户端已结束（或连接关闭）且没有剩余块 → 返回 false
+    bool next(Value& out);
+
+private:
+    friend class RpcServer;
+    StreamReader(uint32_t req_id, uint8_t ver, std::function<void(std::vector<uint8_t>&&)> reply,
+                 std::shared_ptr<StreamState> st);
+
+    uint32_t req_id_;
+    uint8_t ver_;
+    uint32_t consumed_{0};      // 上次回额度后已消费的块数
+    std::function<void(std::vector<uint8_t>&&)> reply_;
+    std::shared_ptr<StreamState> st_;
+};
+
 /**
  * RpcServer：注册方法（name->handler），接受连接并处理请求。
- * 教学实现：一连接一线程；异常转换为 status!=0 的响应。
+ * 教学实现：默认一连接一线程，可选 epoll 事件驱动；异常转换为 status!=0 的响应。
+ * 可选工作线程池（set_workers）：I/O 线程只负责收发，handler 在池中执行，
+ * 响应按完成顺序写回（客户端按 req_id 匹配），慢调用不再阻塞同一连接上的后续请求。
+ * 流式方法（register_server_stream / register_client_stream）各占一个独立线程，
+ * 因为它们会在流控额度上阻塞；同时进行的流数有全服务端上限（set_max_streams）。
+ * 请求帧带超时时，服务端按到达时刻换算截止时间：轮到执行时已过期则不调 handler，
+ * 直接回 status=4；handler 可经 req.remaining() 取剩余预算传给下游调用。
+ * 内置统计：按方法的调用数/错误/被拒/过期与延迟分布，连接数与收发字节数，
+ * 经保留方法 __stats 查询，或 set_stats_dump 周期性打印到 stderr。
+ * 协程方法（register_coro，编译选项 TINY_RPC_COROUTINES）在 I/O 线程上启动，
+ * co_await 下游调用时挂起、不占线程；事件循环模式下响应到达后回到事件循环线程恢复。
+ * 类型化方法（bind）按函数签名在编译期生成参数解码与结果编码，见 typed.h。
+ * 多事件循环（set_reactors）：EPOLL/URING 模式下 N 个事件循环线程各有一个 SO_REUSEPORT 监听 socket，
+ * 由内核把新连接分给它们；连接此后只归一个线程，线程之间只共享只读的分发表。
  */
 class RpcServer {
 public:
     using Handler = std::function<Response(const Request&)>;
+    // 零拷贝 handler：参数以 RequestView 传入，只在本次调用期间有效
+    using ViewHandler = std::function<Response(const RequestView&)>;
+    // 原始 handler：直接拿到请求帧视图（payload 未解析，按 rf.version 编码），只在本次调用期间有效
+    using RawHandler = std::function<Response(const RawFrameView&)>;
+    // 服务端流：逐块 write，返回值作为结束状态（可带一个尾部结果）随 STREAM_END 发出
+    using ServerStreamHandler = std::function<Response(const Request&, StreamWriter&)>;
+    // 客户端流：逐块 next 直到 false，返回值作为普通 RESPONSE 发出
+    using ClientStreamHandler = std::function<Response(const Request&, StreamReader&)>;
+#ifdef TINY_RPC_COROUTINES
+    // 协程：返回 Task<Response>，可在其中 co_await RpcClient::co_call；req 在协程结束前一直有效
+    using CoroHandler = std::function<Task<Response>(const Request&)>;
+#endif
 
-    explicit RpcServer(uint16_t port);
+    explicit RpcServer(uint16_t port, ServeMode mode = ServeMode::THREAD_PER_CONN);
+    // 监听任意传输（TCP 端口 / UNIX socket / 共享内存，见 transport.h）；TCP 绑定 ep.host
+    explicit RpcServer(Endpoint ep, ServeMode mode = ServeMode::THREAD_PER_CONN);
     ~RpcServer();
 
-    void register_method(const std::string& name, Handler h);
+    void register_method(const std::string& name, Handler h, MethodOptions opt = {});
+    void register_method_view(const std::string& name, ViewHandler h, MethodOptions opt = {});
+    void register_method_raw(const std::string& name, RawHandler h, MethodOptions opt = {});
+    // 类型化注册：bind("add", [](int64_t a, int64_t b){ return a + b; })
+    // 参数个数/类型由 f 的签名决定，payload 逐个解码进形参（不经过 std::vector<Value>）；
+    // 个数或类型不符 → status=2。返回 void → 无结果；返回 Response → 原样作为响应
+    template <class F>
+    void bind(const std::string& name, F f, MethodOptions opt = {}){
+        register_method_raw(name, [f = std::move(f)](const RawFrameView& rf) mutable {
+            return detail::call_typed(f, rf);
+        }, opt);
+    }
+    // 流式方法：每个进行中的流占一个线程。除各方法的 opt.max_concurrency 外，全服务端同时
+    // 进行的流不超过 set_max_streams（默认 DEFAULT_MAX_STREAMS），超出的新流直接回 status=3
+    void register_server_stream(const std::string& name, ServerStreamHandler h,
+                                MethodOptions opt = {});
+    void register_client_stream(const std::string& name, ClientStreamHandler h,
+                                MethodOptions opt = {});
+    static constexpr size_t DEFAULT_MAX_STREAMS = 1024;
+    // 全服务端同时进行的流数上限（需在 serve() 前调用；0 = 不限）
+    void set_max_streams(size_t n) { max_streams_ = n; }
+#ifdef TINY_RPC_COROUTINES
+    void register_coro(const std::string& name, CoroHandler h, MethodOptions opt = {});
+#endif
+
+    // 启用工作线程池（需在 serve() 前调用）：threads 个线程，最多排队 queue_capacity 个请求
+    // 队列满时新请求直接回 status=3（overloaded）。不调用则 handler 在 I/O 线程内联执行
+    void set_workers(size_t threads, size_t queue_capacity);
+
+    // 多事件循环（thread-per-core，需在 serve() 前调用）：EPOLL/URING 模式监听 TCP 端点时
+    // 开 n 个事件循环线程，各自用 tcp_listen(host, port, reuse_port) 建监听 socket，彼此不共享连接状态；
+    // pin_cpus 时第 i 个线程绑到进程可用 CPU 中的第 i 个（Linux）。n <= 1 为单事件循环
+    // 与 set_workers 同用时各事件循环共用一个线程池；方法的并发上限与响应缓存本来就是全局的
+    void set_reactors(size_t n, bool pin_cpus = false);
+
+    // 每隔 interval 把统计打印到 stderr（需在 serve() 前调用；0 = 不打印）
+    void set_stats_dump(std::chrono::milliseconds interval) { dump_interval_ = interval; }
+    // 当前统计（__stats 返回的就是它的 to_value()）；任意线程可调用
+    StatsSnapshot stats() const;
+
     void serve(); // 阻塞监听（Ctrl+C 结束）
 
 private:
-    void handle_client(int cfd);
+    // 异步回包：worker 把编码好的响应帧交回所属连接（线程安全）
+    using ReplyFn = std::function<void(std::vector<uint8_t>&&)>;
+
+    // 同名方法只保留最后一次注册的那种 handler
+    struct Entry {
+        std::string name;
+        uint32_t    id{};
+        Handler     h;
+        ViewHandler vh;
+        RawHandler  rh;
+        ServerStreamHandler ssh;
+        ClientStreamHandler csh;
+#ifdef TINY_RPC_COROUTINES
+        CoroHandler ch;
+#endif
+        uint32_t    max_concurrency{0};
+        std::unique_ptr<ResponseCache> cache;      // 为空 = 不缓存
+        uint32_t    slot{0};                       // 统计槽位（ServerMetrics::add_method）
+        mutable std::atomic<uint32_t> inflight{0}; // 正在执行（含排队）的调用数
+    };
+
+    // 每个连接一份：异步回包通道 + 该连接上进行中的流（按 req_id）
+    struct ConnCtx {
+        ReplyFn reply;
+        // 事件循环模式：线程池/协程的异步回包在 I/O 线程 hold、回包后 unhold，
+        // 对端半关闭时事件循环据此等回包发完再关连接（每连接线程模式为空）
+        std::function<void()> hold, unhold;
+        std::mutex mu;                                          // 保护 streams
+        std::unordered_map<uint32_t, std::shared_ptr<StreamState>> streams;
+
+        void begin_async(){ if (hold) hold(); }
+        void end_async(){ if (unhold) unhold(); }
+    };
+    using ConnPtr = std::shared_ptr<ConnCtx>;
+
+    void serve_threaded();
+    // 多事件循环：每个线程一个 SO_REUSEPORT 监听 socket，各跑一个 run_event_loop
+    void serve_sharded();
+    // 在当前线程上跑一个事件循环：URING 先试 io_uring，不可用回退 epoll
+    // index 只用于日志；io 为该事件循环自己的 I/O 计数
+    void run_event_loop(socket_t listen_fd, IoCounters& io, size_t index);
+    // 事件循环模式（R = Reactor / UringReactor）：监听 socket 交给 R，连接上下文按连接 id 维护
+    template <class R> void serve_reactor(socket_t listen_fd, IoCounters& io, size_t index);
+    void handle_client(std::shared_ptr<Conn> c);
+    // 处理一帧：REQUEST → 查表 → 内联执行并把 response frame 追加到 out，
+    //          或交给工作线程池/流线程，完成后经 conn->reply 回包
+    void process_frame(const RawFrameView& rf, std::vector<uint8_t>& out, const ConnPtr& conn);
+    // BATCH 帧：各项独立执行（有线程池时并行），按序合成一帧响应
+    void process_batch(const RawFrameView& rf, std::vector<uint8_t>& out, const ConnPtr& conn);
+    // 流：开始一个流式调用 / 把 DATA、CREDIT、END 帧路由到进行中的流 / 连接关闭时取消全部流
+    void start_stream(const RawFrameView& rf, const Entry* e, std::vector<uint8_t>& out,
+                      const ConnPtr& conn, ServerMetrics::clock::time_point received,
+                      Deadline deadline);
+    void route_stream_frame(const RawFrameView& rf, ConnCtx& conn);
+#ifdef TINY_RPC_COROUTINES
+    // 协程方法：在当前线程启动 run_coro，同步完成则响应追加到 out，否则完成时经 conn->reply 回包
+    void start_coro(const RawFrameView& rf, const Entry* e, std::vector<uint8_t>& out,
+                    const ConnPtr& conn, ServerMetrics::clock::time_point received,
+                    Deadline deadline);
+    Task<void> run_coro(const Entry* e, Request req, ConnPtr conn, uint8_t ver,
+                        ServerMetrics::clock::time_point received, std::shared_ptr<CoroReply> hand);
+#endif
+    static void cancel_streams(ConnCtx& conn);
+    // 可缓存方法：把刚编码进 frame 末尾的成功响应记入 e.cache
+    static void remember(const Entry& e, uint8_t ver, const uint8_t* args, size_t args_len,
+                         const Response& rsp, const std::vector<uint8_t>& frame);
+    // 执行 handler（payload 按 rf.version 解析），异常转换为 status=2
+    // 已过截止时间 → 不执行，回 status=4
+    Response execute(const Entry& e, const RawFrameView& rf, Deadline deadline);
+    const Entry* lookup(std::string_view method, uint32_t method_id) const;
+    static bool acquire(const Entry& e);   // 方法并发名额
+    static void release(const Entry& e);
+    void dump_loop();
+
+    // 不可变的分发表：注册时复制一份新表再原子替换，请求路径只做一次 acquire load，不加锁
+    // by_name 的 key 指向 Entry::name；Entry 由 shared_ptr 在新旧表之间共享
+    struct DispatchTable {
+        std::vector<std::shared_ptr<const Entry>> entries;
+        std::unordered_map<std::string_view, const Entry*> by_name;
+        std::unordered_map<uint32_t, const Entry*> by_id;
+    };
+
+    void install(std::shared_ptr<const Entry> e);
+    // cacheable：普通/零拷贝/原始 handler 才按 opt.cache_ttl 建响应缓存
+    std::shared_ptr<Entry> make_entry(const std::string& name, const MethodOptions& opt,
+                                      bool cacheable = false);
+
+    Endpoint ep_;
+    ServeMode mode_;
+    std::unique_ptr<Listener> listener_;
+    std::mutex mu_;                                 // 只串行化注册，请求路径不碰
+    std::atomic<const DispatchTable*> table_{nullptr};
+    // 旧表不回收（注册只发生在启动期，数量很少），保证并发读者拿到的指针始终有效
+    std::vector<std::unique_ptr<const DispatchTable>> tables_;
+
+    ServerMetrics metrics_;                         // 需比 pool_ 活得久：worker 退出前还会记录
+    std::chrono::milliseconds dump_interval_{0};
+    std::mutex dump_mu_;
+    std::condition_variable dump_cv_;
+    bool stop_dump_{false};
+    std::thread dumper_;
+
+    std::unique_ptr<ThreadPool> pool_;              // 为空 = 内联执行
 
-    uint16_t port_;
-    int listen_fd_{-1};
-    std::mutex mu_;
-    std::map<std::string, Handler> handlers_;
+    // 多事件循环：各自的 I/O 计数单独一条缓存行，stats() 时与 metrics_.io 相加
+    struct alignas(64) ReactorIo {
+        IoCounters io;
+    };
+    size_t reactors_{1};
+    size_t max_streams_{DEFAULT_MAX_STREAMS};
+    std::atomic<size_t> streams_{0};                // 进行中的流（各自一个线程）
+    bool pin_cpus_{false};
+    std::vector<std::unique_ptr<ReactorIo>> reactor_io_;
 };
 
 } // namespace rpc
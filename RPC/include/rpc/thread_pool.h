@@ -0,0 +1,41 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rpc {
+
+/**
+ * ThreadPool：固定线程数 + 有界任务队列。
+ *   - try_submit 在队列满时立即返回 false（调用方据此做过载保护），从不阻塞 I/O 线程
+ *   - 析构时停止接收新任务，执行完队列中剩余任务后 join 所有线程
+ */
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    ThreadPool(size_t threads, size_t queue_capacity);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    bool try_submit(Task t);
+    size_t queue_depth();
+
+private:
+    void worker_loop();
+
+    size_t capacity_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<Task> q_;
+    bool stop_{false};
+    std::vector<std::thread> workers_;
+};
+
+} // namespace rpc
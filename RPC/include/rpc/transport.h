@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "rpc/frame.h"
+#include "rpc/net.h"
+
+namespace rpc {
+
+// 传输方式（帧格式在三者之间完全相同，只是字节流的载体不同）：
+//   TCP  ：跨机器，默认
+//   UNIX ：AF_UNIX 流式 socket，同机进程间，省掉 TCP/IP 协议栈
+//   SHM  ：共享内存环形缓冲区，同机最低延迟：memfd 里两条单生产者单消费者字节环
+//          （每个方向一条），eventfd 只在对端准备睡眠时才唤醒；经 UNIX socket 握手
+//          交换 fd，该 socket 随后只用于感知对端关闭。仅 Linux
+enum class TransportKind : uint8_t {
+    TCP  = 0,
+    UNIX = 1,
+    SHM  = 2,
+};
+
+// 一个服务端地址：
+//   "host:port" 或 "port"（host 缺省 127.0.0.1）→ TCP
+//   "unix:/path"                                 → UNIX
+//   "shm:/path"（path 为握手用的 UNIX socket）   → SHM
+struct Endpoint {
+    std::string host;
+    uint16_t port{0};
+    TransportKind kind{TransportKind::TCP};
+    std::string path;
+
+    static Endpoint tcp(std::string host, uint16_t port);
+    static Endpoint uds(std::string path);
+    static Endpoint shm(std::string path);
+    static Endpoint parse(const std::string& s);   // 格式非法 → throw runtime_error
+    std::string str() const;
+};
+
+/**
+ * Conn：一条已建立的连接，可靠的双向字节流。
+ *   - write 由调用方串行化（同一时刻只有一个写者），read 只在一个线程上调用
+ *   - shutdown 可在任意线程调用：唤醒阻塞中的 read/write，对端随后读到关闭
+ *   - 析构时释放底层资源（fd / 映射）
+ */
+class Conn {
+public:
+    virtual ~Conn() = default;
+    virtual bool write(const void* buf, size_t n) = 0;   // 写满 n 字节；连接已断 → false
+    virtual bool read(void* buf, size_t n) = 0;          // 读满 n 字节；对端关闭 → false
+    // 已从底层收下、还没被 read 取走的字节数：非 0 说明对端流水线上的后续数据已经到了
+    virtual size_t buffered() const { return 0; }
+    // 复制至多 n 个已缓冲的字节到 buf 但不取走，返回复制的字节数
+    virtual size_t peek(void* buf, size_t n) const { (void)buf; (void)n; return 0; }
+    virtual void shutdown() = 0;
+    virtual std::string describe() const = 0;            // 日志用
+};
+
+// Listener：监听一个 Endpoint，逐个接受连接
+class Listener {
+public:
+    // 完成一个已 accept 连接的建立：TCP/UNIX 直接得到连接，SHM 在其中收发握手（最多等 2 秒）。
+    // 必须调用且只调用一次；握手出错返回空
+    using Handshake = std::function<std::unique_ptr<Conn>()>;
+
+    virtual ~Listener() = default;
+    // 阻塞直到来了一个连接，只做 accept 本身；accept 失败返回空函数，调用方继续 accept。
+    // 调用方在连接自己的线程上执行返回的 Handshake：迟迟不握手的客户端不会拖住 accept 循环
+    virtual Handshake accept() = 0;
+    // 底层监听 socket：TCP/UNIX 可直接交给 Reactor（连接 fd 即数据通道）
+    virtual socket_t fd() const = 0;
+    virtual bool supports_reactor() const = 0;
+};
+
+// 把已连接的 socket（TCP 或 UNIX）包装成 Conn，析构时 close
+std::unique_ptr<Conn> make_socket_conn(socket_t fd);
+// 连接到 ep；连不上 / 握手失败返回空（不退出）
+// timeout_ms > 0：建立连接最多等这么久（见 tcp_try_connect），超时同连不上
+std::unique_ptr<Conn> try_connect(const Endpoint& ep, int timeout_ms = 0);
+// 监听 ep；失败 die()。UNIX/SHM 的 socket 文件在 Listener 析构时删除
+std::unique_ptr<Listener> listen_on(const Endpoint& ep);
+
+// 共享内存传输的两端（见 shm_transport.cpp）；非 Linux 平台返回空
+std::unique_ptr<Conn> shm_try_connect(const std::string& path, int timeout_ms = 0);
+std::unique_ptr<Conn> shm_accept(socket_t ctl);      // ctl：刚 accept 的握手 socket
+
+// 与 net.h 中 socket 版本语义相同
+bool recv_body(Conn& c, std::vector<uint8_t>& body);
+// 缓冲区里已有一整帧（长度前缀 + body）：下一次 recv_body 不会阻塞
+bool frame_buffered(const Conn& c);
+std::optional<RawFrame> recv_frame(Conn& c);
+
+} // namespace rpc
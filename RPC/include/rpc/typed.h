@@ -0,0 +1,298 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "rpc/byteorder.h"
+#include "rpc/frame.h"
+#include "rpc/protocol.h"
+#include "rpc/value.h"
+
+/**
+ * 类型化接口的编译期部分：C++ 类型 ↔ 线上 Value 编码。
+ *   RpcServer::bind("add", [](int64_t a, int64_t b){ return a + b; });
+ *   int64_t r = client.call<int64_t>("add", 7, 35);
+ * 参数从 payload 逐个解码成 handler 形参类型的局部变量（不构造 std::vector<Value>），
+ * 客户端参数直接写进请求帧；字节与 Value 版本完全相同，两种 API 可以混用。
+ *
+ * 支持的类型（TypeCodec<T>）：
+ *   整数（bool 除外）→ INT64      bool → BOOL        float/double → DOUBLE
+ *   （解码到较窄/无符号整数时超出 T 的范围按类型不符处理，不截断）
+ *   std::string / std::string_view / const char* → STRING
+ *   std::vector<int64_t> → INT64_ARRAY   std::vector<double> → F64_ARRAY
+ *   Value → 任意类型（原样编解码）
+ * std::string_view 形参指向接收缓冲区，只在 handler 调用期间有效；不能作为 call<R> 的 R。
+ */
+namespace rpc {
+
+// 调用失败（status != 0）：类型化 call 没有 Response 可返回，改为抛出
+class RpcError : public std::runtime_error {
+public:
+    RpcError(uint16_t status, const std::string& msg)
+        : std::runtime_error(msg), status_(status) {}
+    uint16_t status() const { return status_; }
+private:
+    uint16_t status_;
+};
+
+namespace detail {
+
+[[noreturn]] inline void type_mismatch(const char* want){
+    throw std::runtime_error(std::string("arg type not ") + want);
+}
+
+} // namespace detail
+
+// 每个特化提供：
+//   size(v, ver) / encode(p, v, ver)：直接编码（与 encode_value_to 字节相同）
+//   from_view(ValueView)：服务端解码参数；from_value(Value)：客户端取结果
+//   to_value(v)：服务端把返回值装进 Response
+template <class T, class = void>
+struct TypeCodec {
+    static_assert(sizeof(T) == 0, "rpc::TypeCodec: unsupported parameter/result type");
+};
+
+template <class T>
+struct TypeCodec<T, std::enable_if_t<std::is_integral<T>::value && !std::is_same<T, bool>::value>> {
+    static size_t size(T v, uint8_t ver){ return encoded_size_int((int64_t)v, ver); }
+    static uint8_t* encode(uint8_t* p, T v, uint8_t ver){ return encode_int_to(p, (int64_t)v, ver); }
+    static T from_view(const ValueView& v){
+        if (v.type != ValueType::INT64) detail::type_mismatch("int64");
+        return narrow(v.i64);
+    }
+    static T from_value(const Value& v){ return narrow(v.i64()); }
+    static Value to_value(T v){ return Value::make_int((int64_t)v); }
+
+    // int64 → T：放不下（如 300 → uint8_t、-1 → uint32_t）就报错
+    static T narrow(int64_t v){
+        bool fits;
+        if constexpr (std::is_signed<T>::value)
+            fits = v >= (int64_t)std::numeric_limits<T>::min() && v <= (int64_t)std::numeric_limits<T>::max();
+        else
+            fits = v >= 0 && (uint64_t)v <= (uint64_t)std::numeric_limits<T>::max();
+        if (!fits) detail::type_mismatch("in-range int");
+        return (T)v;
+    }
+};
+
+template <>
+struct TypeCodec<bool> {
+    static size_t size(bool, uint8_t){ return 2; }
+    static uint8_t* encode(uint8_t* p, bool v, uint8_t){ return encode_bool_to(p, v); }
+    static bool from_view(const ValueView& v){
+        if (v.type != ValueType::BOOL) detail::type_mismatch("bool");
+        return v.i64 != 0;
+    }
+    static bool from_value(const Value& v){ return v.boolean(); }
+    static Value to_value(bool v){ return Value::make_bool(v); }
+};
+
+template <class T>
+struct TypeCodec<T, std::enable_if_t<std::is_floating_point<T>::value>> {
+    static size_t size(T, uint8_t){ return 9; }
+    static uint8_t* encode(uint8_t* p, T v, uint8_t){ return encode_double_to(p, (double)v); }
+    static T from_view(const ValueView& v){
+        if (v.type != ValueType::DOUBLE) detail::type_mismatch("double");
+        return (T)v.f64;
+    }
+    static T from_value(const Value& v){ return (T)v.f64(); }
+    static Value to_value(T v){ return Value::make_double((double)v); }
+};
+
+template <>
+struct TypeCodec<std::string_view> {
+    static size_t size(std::string_view v, uint8_t ver){ return encoded_size_bytes(v.size(), ver); }
+    static uint8_t* encode(uint8_t* p, std::string_view v, uint8_t ver){
+        return encode_bytes_to(p, ValueType::STRING, v, ver);
+    }
+    static std::string_view from_view(const ValueView& v){
+        if (v.type != ValueType::STRING) detail::type_mismatch("string");
+        return v.str;
+    }
+    static Value to_value(std::string_view v){ return Value::make_str(v); }
+};
+
+template <>
+struct TypeCodec<std::string> {
+    static size_t size(const std::string& v, uint8_t ver){ return encoded_size_bytes(v.size(), ver); }
+    static uint8_t* encode(uint8_t* p, const std::string& v, uint8_t ver){
+        return encode_bytes_to(p, ValueType::STRING, v, ver);
+    }
+    static std::string from_view(const ValueView& v){
+        return std::string(TypeCodec<std::string_view>::from_view(v));
+    }
+    static std::string from_value(const Value& v){ return std::string(v.str()); }
+    static Value to_value(const std::string& v){ return Value::make_str(v); }
+};
+
+// 字符串字面量/C 字符串只作为客户端参数
+template <>
+struct TypeCodec<const char*> {
+    static size_t size(const char* v, uint8_t ver){ return TypeCodec<std::string_view>::size(v, ver); }
+    static uint8_t* encode(uint8_t* p, const char* v, uint8_t ver){
+        return TypeCodec<std::string_view>::encode(p, v, ver);
+    }
+};
+
+template <>
+struct TypeCodec<std::vector<int64_t>> {
+    static size_t size(const std::vector<int64_t>& v, uint8_t ver){ return encoded_size_array8(v.size(), ver); }
+    static uint8_t* encode(uint8_t* p, const std::vector<int64_t>& v, uint8_t ver){
+        return encode_i64_array_to(p, v.data(), v.size(), ver);
+    }
+    static std::vector<int64_t> from_view(const ValueView& v){
+        if (v.type != ValueType::INT64_ARRAY) detail::type_mismatch("int64 array");
+        std::vector<int64_t> out(v.count);
+        load_be64_array(out.data(), (const uint8_t*)v.str.data(), v.count);
+        return out;
+    }
+    static std::vector<int64_t> from_value(const Value& v){
+        return std::vector<int64_t>(v.i64s().begin(), v.i64s().end());
+    }
+    static Value to_value(const std::vector<int64_t>& v){
+        return Value::make_i64_array(Value::Int64s(v.begin(), v.end()));
+    }
+};
+
+template <>
+struct TypeCodec<std::vector<double>> {
+    static size_t size(const std::vector<double>& v, uint8_t ver){ return encoded_size_array8(v.size(), ver); }
+    static uint8_t* encode(uint8_t* p, const std::vector<double>& v, uint8_t ver){
+        return encode_f64_array_to(p, v.data(), v.size(), ver);
+    }
+    static std::vector<double> from_view(const ValueView& v){
+        if (v.type != ValueType::F64_ARRAY) detail::type_mismatch("f64 array");
+        std::vector<double> out(v.count);
+        load_be64_array(out.data(), (const uint8_t*)v.str.data(), v.count);
+        return out;
+    }
+    static std::vector<double> from_value(const Value& v){
+        return std::vector<double>(v.f64s().begin(), v.f64s().end());
+    }
+    static Value to_value(const std::vector<double>& v){
+        return Value::make_f64_array(Value::F64s(v.begin(), v.end()));
+    }
+};
+
+template <>
+struct TypeCodec<Value> {
+    static size_t size(const Value& v, uint8_t ver){ return encoded_size(v, ver); }
+    static uint8_t* encode(uint8_t* p, const Value& v, uint8_t ver){ return encode_value_to(p, v, ver); }
+    static Value from_view(const ValueView& v){ return v.to_value(); }
+    static Value from_value(const Value& v){ return v; }
+    static Value to_value(Value v){ return v; }
+};
+
+// 参数按值/引用传入时都按去掉 cv/引用后的类型编解码；字符数组（字面量）按 const char*
+template <class T>
+using codec_of = TypeCodec<std::decay_t<const T>>;
+
+namespace detail {
+
+// ---------------- 可调用对象的签名 ----------------
+template <class F>
+struct FnTraits : FnTraits<decltype(&F::operator())> {};
+
+template <class R, class... A>
+struct FnTraits<R(*)(A...)> {
+    using Ret  = R;
+    using Args = std::tuple<std::decay_t<A>...>;
+};
+
+template <class R, class... A>
+struct FnTraits<R(A...)> : FnTraits<R(*)(A...)> {};
+
+template <class R, class C, class... A>
+struct FnTraits<R(C::*)(A...) const> : FnTraits<R(*)(A...)> {};
+
+template <class R, class C, class... A>
+struct FnTraits<R(C::*)(A...)> : FnTraits<R(*)(A...)> {};
+
+// ---------------- 服务端：payload → 形参 → 调用 → Response ----------------
+
+// 解码下一个参数到 T；p/n 为剩余 payload
+template <class T>
+T next_arg(const uint8_t*& p, size_t& n, uint8_t ver, size_t index){
+    auto [view, used] = decode_value_view(p, n, ver);
+    p += used; n -= used;
+    try{
+        return codec_of<T>::from_view(view);
+    }catch(const std::runtime_error& e){
+        throw std::runtime_error("arg " + std::to_string(index) + ": " + e.what());
+    }
+}
+
+template <class R>
+Response make_typed_response(R&& r){
+    Response rsp;
+    rsp.has_result = true;
+    rsp.result = codec_of<R>::to_value(std::forward<R>(r));
+    return rsp;
+}
+
+inline Response make_typed_response(Response&& r){ return std::move(r); }
+
+template <class F, class... A, size_t... I>
+Response invoke_typed(F& f, const RawFrameView& rf, std::tuple<A...>*, std::index_sequence<I...>){
+    const uint8_t* p = rf.payload;
+    size_t n = rf.payload_len;
+    uint64_t argc;
+    size_t used = decode_argc(p, n, rf.version, argc);
+    p += used; n -= used;
+    if (argc != sizeof...(A))
+        throw std::runtime_error("expected " + std::to_string(sizeof...(A)) + " args, got " +
+                                 std::to_string(argc));
+    // 花括号初始化保证从左到右求值，即按线上顺序解码
+    std::tuple<A...> args{ next_arg<A>(p, n, rf.version, I)... };
+    if (n != 0) throw std::runtime_error("extra bytes in req payload");
+    using R = decltype(std::apply(f, std::move(args)));
+    if constexpr (std::is_void<R>::value){
+        std::apply(f, std::move(args));
+        return Response{};
+    }else{
+        return make_typed_response(std::apply(f, std::move(args)));
+    }
+}
+
+// bind 生成的 handler：按 F 的签名解码参数并调用
+template <class F>
+Response call_typed(F& f, const RawFrameView& rf){
+    using Args = typename FnTraits<F>::Args;
+    return invoke_typed(f, rf, (Args*)nullptr, std::make_index_sequence<std::tuple_size<Args>::value>{});
+}
+
+// ---------------- 客户端：实参 → payload；Response → R ----------------
+template <class... A>
+size_t typed_payload_size(uint8_t ver, const A&... args){
+    return argc_size(sizeof...(A), ver) + (size_t(0) + ... + codec_of<A>::size(args, ver));
+}
+
+template <class... A>
+uint8_t* encode_typed_payload(uint8_t* p, uint8_t ver, const A&... args){
+    p = encode_argc_to(p, sizeof...(A), ver);
+    ((p = codec_of<A>::encode(p, args, ver)), ...);
+    return p;
+}
+
+template <class R>
+R typed_result(Response&& r){
+    if constexpr (std::is_same<R, Response>::value){
+        return std::move(r);
+    }else{
+        if (r.status != 0) throw RpcError(r.status, r.err_msg);
+        if constexpr (!std::is_void<R>::value){
+            static_assert(!std::is_same<R, std::string_view>::value,
+                          "call<std::string_view> would dangle; use std::string");
+            if (!r.has_result) throw RpcError(2, "response has no result");
+            return codec_of<R>::from_value(r.result);
+        }
+    }
+}
+
+} // namespace detail
+} // namespace rpc
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include "rpc/metrics.h"
+#include "rpc/net.h"
+#include "rpc/reactor.h"
+
+namespace rpc {
+
+/**
+ * UringReactor：io_uring 事件循环（仅 Linux，编译选项 TINY_RPC_IO_URING；直接用系统调用，
+ * 不依赖 liburing）。对外接口与 Reactor 相同，区别在 I/O 路径：
+ *   - 多发 accept / 多发 recv：一个 SQE 持续产生完成事件，不必每次重新提交
+ *   - 提供缓冲环（provided buffer ring）：内核把数据直接放进预先登记的缓冲区，
+ *     完整帧在缓冲区里原地解析，不再“先读 4B 长度、再读 body”
+ *   - 一轮完成事件处理完后统一提交响应：所有发送与下一次等待合并成一次 io_uring_enter
+ *   - 响应拷进预先登记的固定缓冲区后用 WRITE_FIXED 发出，省掉每次发送时的页面映射
+ * 流水线负载下，每个请求摊到的系统调用远少于一次。
+ * 背压与 Reactor 相同：某连接待发送积压过多时取消它的 recv，发到低水位以下再恢复。
+ * 内核不支持（或编译时未启用）时构造函数抛 runtime_error，调用方回退到 epoll。
+ */
+class UringReactor {
+public:
+    using ConnRef      = Reactor::ConnRef;
+    using FrameHandler = Reactor::FrameHandler;
+    using CloseHandler = Reactor::CloseHandler;
+
+    UringReactor(socket_t listen_fd, FrameHandler on_frame);
+    ~UringReactor();
+
+    UringReactor(const UringReactor&) = delete;
+    UringReactor& operator=(const UringReactor&) = delete;
+
+    void run(); // 阻塞运行事件循环
+    void set_on_close(CloseHandler h);
+    // 连接数、收发字节数与系统调用次数累加到 io（需在 run() 前设置；为空则不统计）
+    void set_io_counters(IoCounters* io);
+
+    // 线程安全：把 bytes 追加到 conn 的发送缓冲区（连接已关闭则丢弃）
+    void post(ConnRef conn, std::vector<uint8_t> bytes);
+    // 同 Reactor::hold / unhold：对端半关闭后等异步回包都到齐再关闭
+    void hold(ConnRef conn);
+    void unhold(ConnRef conn);
+    // 线程安全：让事件循环线程执行 fn（如恢复协程）
+    void dispatch(std::function<void()> fn);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace rpc
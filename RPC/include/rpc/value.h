@@ -1,30 +1,129 @@
 #pragma once
 #include <cstdint>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 /**
  * Value：RPC 参数/返回值的统一承载体。
- * 仅演示两种类型：INT64、STRING。便于后续扩展（double/bytes/map/array）。
+ *   标量：INT64、DOUBLE、BOOL
+ *   字节：STRING、BYTES
+ *   容器：ARRAY（任意 Value 序列）、MAP（string → Value，保持插入顺序）
+ *   定长数组：INT64_ARRAY、F64_ARRAY —— 线上为“一个长度 + 连续 8B 元素”，
+ *             整段批量 memcpy/字节序翻转，不再每个元素一个 Value
+ *
+ * 紧凑的带标签表示：type 之外只有一个 union，同一时刻只存放当前类型的数据（48 字节）。
+ * 变长数据用 std::pmr 容器：默认走普通堆；服务端解码请求参数时改从本次请求的
+ * RequestArena 分配，响应发出后整体释放（见 arena.h）。
+ * 拷贝总是得到堆上的独立副本（可以放心保存 arena 里参数的拷贝）；移动保留原分配器。
+ * 访问函数返回引用/视图，类型不符 → throw runtime_error。
  */
 namespace rpc {
 
 enum class ValueType : uint8_t {
-    INT64  = 1,
-    STRING = 2,
+    INT64       = 1,
+    STRING      = 2,
+    DOUBLE      = 3,
+    BOOL        = 4,
+    BYTES       = 5,
+    ARRAY       = 6,
+    MAP         = 7,
+    INT64_ARRAY = 8,
+    F64_ARRAY   = 9,
 };
 
-struct Value {
-    ValueType type{};
-    int64_t   i64{};
-    std::string str;
+class Value {
+public:
+    using Str    = std::pmr::string;
+    using Array  = std::pmr::vector<Value>;
+    using Map    = std::pmr::vector<std::pair<Str, Value>>;
+    using Int64s = std::pmr::vector<int64_t>;
+    using F64s   = std::pmr::vector<double>;
+
+    Value() noexcept : i64_(0) {}                  // 无类型（type() == ValueType{}）
+    Value(const Value& o);
+    Value(Value&& o) noexcept;
+    Value& operator=(const Value& o);
+    Value& operator=(Value&& o) noexcept;
+    ~Value(){ reset(); }
+
+    ValueType type() const { return type_; }
+
+    int64_t          i64()     const;              // INT64
+    double           f64()     const;              // DOUBLE
+    bool             boolean() const;              // BOOL
+    std::string_view str()     const;              // STRING / BYTES
+    const Array&     arr()     const;              // ARRAY
+    const Map&       map()     const;              // MAP
+    const Int64s&    i64s()    const;              // INT64_ARRAY
+    const F64s&      f64s()    const;              // F64_ARRAY
 
     static Value make_int(int64_t v);
-    static Value make_str(std::string s);
+    static Value make_str(std::string_view s, std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+    static Value make_double(double v);
+    static Value make_bool(bool v);
+    static Value make_bytes(std::string_view b, std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+    static Value make_array(Array a);
+    static Value make_map(Map m);
+    static Value make_i64_array(Int64s a);
+    static Value make_f64_array(F64s a);
+
+private:
+    void reset() noexcept;                         // 析构当前成员，回到无类型
+    void construct_from(const Value& o);           // 要求 *this 无类型
+    void construct_from(Value&& o) noexcept;
+
+    ValueType type_{};
+    union {
+        int64_t i64_;                              // INT64；BOOL 存 0/1
+        double  f64_;
+        Str     str_;
+        Array   arr_;
+        Map     map_;
+        Int64s  i64s_;
+        F64s    f64s_;
+    };
+};
+
+/**
+ * ValueView：Value 的只读视图。STRING 内容指向接收缓冲区，不做拷贝；
+ * 只在所属缓冲区（一次 handler 调用）有效期内可用，需要保存时用 to_value()。
+ *   - STRING/BYTES：str 为内容
+ *   - INT64_ARRAY/F64_ARRAY：str 为 count 个 8B 大端元素的原始字节（用 copy_*_array 批量转换）
+ *   - ARRAY/MAP：count 为元素个数，raw 为整个编码值（to_value() 时再递归解码）
+ */
+struct ValueView {
+    ValueType type{};
+    union {
+        int64_t i64{};                             // INT64 / BOOL
+        double  f64;                               // DOUBLE
+    };
+    std::string_view str;
+    size_t    count{};
+    std::string_view raw;
+    uint8_t   ver{};
+
+    // mr：变长内容的分配来源（服务端解码请求参数时为本次请求的 arena）
+    Value to_value(std::pmr::memory_resource* mr = std::pmr::get_default_resource()) const;
 };
 
 // 简单的类型检查工具（服务端 handler 读参数时常用）
 int64_t as_i64(const std::vector<Value>& a, size_t i);
-std::string as_str(const std::vector<Value>& a, size_t i);
+std::string_view as_str(const std::vector<Value>& a, size_t i);   // 指向 a[i]，随其失效
+double as_f64(const std::vector<Value>& a, size_t i);
+bool as_bool(const std::vector<Value>& a, size_t i);
+
+// 视图版本：不拷贝字符串
+int64_t as_i64(const std::vector<ValueView>& a, size_t i);
+std::string_view as_str_view(const std::vector<ValueView>& a, size_t i);
+double as_f64(const std::vector<ValueView>& a, size_t i);
+bool as_bool(const std::vector<ValueView>& a, size_t i);
+std::string_view as_bytes_view(const std::vector<ValueView>& a, size_t i);
+
+// 定长数组视图 → 调用方缓冲区（一次 resize + 批量字节序转换；out 可复用）
+void copy_i64_array(const std::vector<ValueView>& a, size_t i, std::vector<int64_t>& out);
+void copy_f64_array(const std::vector<ValueView>& a, size_t i, std::vector<double>& out);
 
 } // namespace rpc
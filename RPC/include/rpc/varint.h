@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+/**
+ * varint：LEB128 变长整数 + zigzag（协议 v2 使用）。
+ *   - 每字节低 7 位存数据，最高位=1 表示后面还有字节；u64 最多 10 字节
+ *   - zigzag 把有符号数映射到无符号：0,-1,1,-2,... → 0,1,2,3,...，小绝对值都很短
+ * 写入函数写到裸指针（调用方已按 varint_size 预留空间），返回写入后的位置。
+ */
+namespace rpc {
+
+inline size_t varint_size(uint64_t v){
+    size_t n = 1;
+    while (v >= 0x80){ v >>= 7; ++n; }
+    return n;
+}
+
+inline uint8_t* put_varint(uint8_t* p, uint64_t v){
+    while (v >= 0x80){
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+// 从 p（剩余 n 字节）读一个 varint 到 out，返回消费的字节数
+// 失败：字节不足或超过 10 字节 → throw runtime_error
+inline size_t get_varint(const uint8_t* p, size_t n, uint64_t& out){
+    uint64_t v = 0;
+    for (size_t i = 0; i < n && i < 10; ++i){
+        v |= uint64_t(p[i] & 0x7F) << (7 * i);
+        if (!(p[i] & 0x80)){ out = v; return i + 1; }
+    }
+    throw std::runtime_error("bad varint");
+}
+
+inline uint64_t zigzag_encode(int64_t v){
+    return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t u){
+    return int64_t(u >> 1) ^ -int64_t(u & 1);
+}
+
+} // namespace rpc
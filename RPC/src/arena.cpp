@@ -0,0 +1,55 @@
+#include "rpc/arena.h"
+#include <vector>
+
+namespace rpc {
+
+// =====================================================
+// 首块缓存：每线程一张空闲表，最多留 MAX_CACHED 块（同一线程上嵌套的 arena 很少）
+// 线程退出时释放
+// =====================================================
+static constexpr size_t MAX_CACHED = 8;
+
+struct BlockCache {
+    std::vector<unsigned char*> free;
+    ~BlockCache(){ for (unsigned char* b : free) delete[] b; }
+};
+
+static thread_local BlockCache tls_blocks;
+
+static unsigned char* take_block(){
+    auto& f = tls_blocks.free;
+    if (f.empty()) return new unsigned char[RequestArena::BLOCK_BYTES];
+    unsigned char* b = f.back();
+    f.pop_back();
+    return b;
+}
+
+static void give_block(unsigned char* b){
+    auto& f = tls_blocks.free;
+    if (f.size() < MAX_CACHED) f.push_back(b);
+    else delete[] b;
+}
+
+RequestArena::~RequestArena(){
+    spill_.reset();
+    if (block_) give_block(block_);
+}
+
+// =====================================================
+// do_allocate(bytes, align)
+//   首块里按对齐切一段；放不下（或对齐超过 new 的保证）→ spill_（普通堆，按倍增申请）
+// =====================================================
+void* RequestArena::do_allocate(size_t bytes, size_t align){
+    if (align <= __STDCPP_DEFAULT_NEW_ALIGNMENT__){
+        if (!block_) block_ = take_block();
+        size_t off = (used_ + align - 1) & ~(align - 1);
+        if (off <= BLOCK_BYTES && bytes <= BLOCK_BYTES - off){
+            used_ = off + bytes;
+            return block_ + off;
+        }
+    }
+    if (!spill_) spill_.emplace(BLOCK_BYTES * 2);
+    return spill_->allocate(bytes, align);
+}
+
+} // namespace rpc
@@ -0,0 +1,171 @@
+#include "rpc/buffer_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <utility>
+
+namespace rpc {
+
+// =====================================================
+// BufferPool: 分级帧缓冲区池
+//   级别 c 的缓冲区容量至少为 256 << c（共 15 级，256B … 4MB）
+//   acquire：向上取整到级别 → 本地空闲表 → 全局仓库（一次取半个本地上限）→ 新分配
+//   release：按容量向下取整到级别（保证该级 acquire 拿到的容量够用）→ 本地空闲表，
+//            本地满了把一半挪到全局仓库，仓库也满了就释放
+// 每线程每级缓存的字节数大致封顶 1MB（小缓冲区多留几个，大缓冲区少留）
+// =====================================================
+
+static constexpr unsigned MIN_SHIFT = 8;
+static constexpr unsigned MAX_SHIFT = 22;
+static constexpr unsigned CLASSES   = MAX_SHIFT - MIN_SHIFT + 1;
+static_assert((size_t(1) << MIN_SHIFT) == BufferPool::MIN_CLASS_BYTES, "class table");
+static_assert((size_t(1) << MAX_SHIFT) == BufferPool::MAX_CLASS_BYTES, "class table");
+
+static size_t class_bytes(unsigned c){ return size_t(1) << (c + MIN_SHIFT); }
+
+// 本地每级上限：2..64 个；全局仓库每级是它的 4 倍
+static size_t local_cap(unsigned c){
+    return std::max<size_t>(2, std::min<size_t>(64, (size_t(1) << 20) / class_bytes(c)));
+}
+
+static unsigned floor_log2(size_t n){ return 63u - (unsigned)__builtin_clzll((unsigned long long)n); }
+
+// 容量至少为 n 的最小级别；n 超过最大级别返回 CLASSES
+static unsigned class_for_acquire(size_t n){
+    if (n <= BufferPool::MIN_CLASS_BYTES) return 0;
+    unsigned s = floor_log2(n - 1) + 1;
+    return s > MAX_SHIFT ? CLASSES : s - MIN_SHIFT;
+}
+
+// 容量 cap 能满足的最大级别；不在分级范围内返回 CLASSES
+static unsigned class_for_release(size_t cap){
+    if (cap < BufferPool::MIN_CLASS_BYTES) return CLASSES;
+    unsigned s = floor_log2(cap);
+    return s > MAX_SHIFT ? CLASSES : s - MIN_SHIFT;
+}
+
+using FreeList = std::vector<std::vector<uint8_t>>;
+
+struct LocalCache {
+    FreeList free[CLASSES];
+};
+
+struct Depot {
+    std::mutex mu;
+    FreeList free[CLASSES];
+};
+
+static thread_local LocalCache tls_cache;
+
+// 函数内静态：其它静态对象的构造/析构期间也能安全使用
+static Depot& depot(){
+    static Depot d;
+    return d;
+}
+
+// ---------------- 分片计数器 ----------------
+// 每个线程固定落在一个 64B 对齐的槽位上，relaxed 加法几乎没有缓存行争用；读取时求和
+static constexpr unsigned COUNTER_SHARDS = 64;
+
+struct alignas(64) CounterSlot {
+    std::atomic<uint64_t> a{0};
+    std::atomic<uint64_t> b{0};
+};
+
+static std::atomic<unsigned> g_next_shard{0};
+static thread_local int tls_shard = -1;     // 常量初始化：operator new 里也可以安全访问
+
+static unsigned my_shard(){
+    if (tls_shard < 0) tls_shard = (int)(g_next_shard.fetch_add(1, std::memory_order_relaxed) % COUNTER_SHARDS);
+    return (unsigned)tls_shard;
+}
+
+static CounterSlot g_pool_counts[COUNTER_SHARDS];   // a = hits, b = misses
+
+std::vector<uint8_t> BufferPool::acquire(size_t min_capacity){
+    CounterSlot& cnt = g_pool_counts[my_shard()];
+    unsigned c = class_for_acquire(min_capacity);
+    std::vector<uint8_t> buf;
+    if (c < CLASSES){
+        FreeList& local = tls_cache.free[c];
+        if (local.empty()){
+            Depot& d = depot();
+            std::lock_guard<std::mutex> lk(d.mu);
+            FreeList& shared = d.free[c];
+            size_t n = std::min(shared.size(), std::max<size_t>(1, local_cap(c) / 2));
+            for (size_t i = 0; i < n; ++i){
+                local.push_back(std::move(shared.back()));
+                shared.pop_back();
+            }
+        }
+        if (!local.empty()){
+            buf = std::move(local.back());
+            local.pop_back();
+            cnt.a.fetch_add(1, std::memory_order_relaxed);
+            return buf;
+        }
+        buf.reserve(class_bytes(c));
+    }else{
+        buf.reserve(min_capacity);
+    }
+    cnt.b.fetch_add(1, std::memory_order_relaxed);
+    return buf;
+}
+
+void BufferPool::release(std::vector<uint8_t>&& buf){
+    unsigned c = class_for_release(buf.capacity());
+    if (c >= CLASSES){
+        std::vector<uint8_t>().swap(buf);
+        return;
+    }
+    buf.clear();
+    FreeList& local = tls_cache.free[c];
+    if (local.size() >= local_cap(c)){
+        // 本地满：挪一半到全局仓库，仓库满了就直接释放
+        Depot& d = depot();
+        std::lock_guard<std::mutex> lk(d.mu);
+        FreeList& shared = d.free[c];
+        size_t n = local.size() / 2;
+        for (size_t i = 0; i < n; ++i){
+            if (shared.size() < local_cap(c) * 4) shared.push_back(std::move(local.back()));
+            local.pop_back();
+        }
+    }
+    local.push_back(std::move(buf));
+}
+
+BufferPool::Stats BufferPool::stats(){
+    Stats s;
+    for (auto& slot : g_pool_counts){
+        s.hits   += slot.a.load(std::memory_order_relaxed);
+        s.misses += slot.b.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+// =====================================================
+// 堆分配计数：计数器在这里，替换全局 operator new / delete 的是 src/count_allocs.cpp
+// （目标 tiny_rpc_count_allocs，只链接进自带的服务端与压测程序）；没链接它时计数恒为 0
+// =====================================================
+static CounterSlot g_heap_counts[COUNTER_SHARDS];   // a = 次数, b = 字节
+static std::atomic<bool> g_heap_counting{false};
+
+bool heap_alloc_counting(){ return g_heap_counting.load(std::memory_order_relaxed); }
+void set_heap_alloc_counting(bool on){ g_heap_counting.store(on, std::memory_order_relaxed); }
+
+void count_heap_alloc(size_t bytes){
+    CounterSlot& s = g_heap_counts[my_shard()];
+    s.a.fetch_add(1, std::memory_order_relaxed);
+    s.b.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+HeapAllocs heap_allocs(){
+    HeapAllocs h;
+    for (auto& slot : g_heap_counts){
+        h.allocs += slot.a.load(std::memory_order_relaxed);
+        h.bytes  += slot.b.load(std::memory_order_relaxed);
+    }
+    return h;
+}
+
+} // namespace rpc
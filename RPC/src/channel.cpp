@@ -0,0 +1,472 @@
+#include "rpc/channel.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+namespace rpc {
+
+// =======================================================
+// RpcChannel: 多副本客户端
+// 职责：
+//   - 每个副本一个常驻连接池（RpcClient 本身已支持多路复用）
+//   - power-of-two-choices 按未完成调用数挑选副本
+//   - 连接断开 → 剔除；后台线程指数退避重连 → 重新加入
+//   - 可选的对冲调用（call_hedged）：按近期延迟分位发副本请求，令牌桶限额
+//
+// 并发：
+//   - 请求路径只读 up 标志、原子计数，并在副本锁下拷贝一次连接池的 shared_ptr
+//   - 重连时整体替换连接池；仍在使用旧连接的调用持有 shared_ptr，不会悬空
+// =======================================================
+
+static constexpr auto HEALTH_INTERVAL = std::chrono::milliseconds(100);
+static constexpr auto MIN_BACKOFF     = std::chrono::milliseconds(200);
+static constexpr auto MAX_BACKOFF     = std::chrono::milliseconds(10000);
+static constexpr auto CONNECT_TIMEOUT = std::chrono::milliseconds(1000);   // 每条连接建连 + 协商的上限
+static constexpr int  MAX_ATTEMPTS    = 3;   // 请求未发出时最多换几个副本
+static constexpr uint64_t DELAY_REFRESH = 64;     // 每多少个样本重算一次对冲延迟
+static constexpr uint64_t DELAY_WINDOW  = 8192;   // 样本窗口：攒满后清空，跟上延迟变化
+static constexpr auto HEDGE_TICK = std::chrono::microseconds(200);   // 对冲线程两次醒来的最短间隔
+
+// 线程局部随机数：[0, n)
+static uint32_t rand_below(uint32_t n){
+    thread_local std::minstd_rand rng(
+        (uint32_t)std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    return (uint32_t)(rng() % n);
+}
+
+RpcChannel::RpcChannel(std::vector<Endpoint> endpoints, size_t conns_per_endpoint)
+    : conns_per_ep_(conns_per_endpoint ? conns_per_endpoint : 1) {
+    for (auto& ep : endpoints){
+        auto r = std::make_unique<Replica>();
+        r->ep = std::move(ep);
+        replicas_.push_back(std::move(r));
+    }
+}
+
+RpcChannel::~RpcChannel(){ close(); }
+
+// =======================================================
+// connect():
+//   - 逐个副本建立连接池；失败的副本标记为剔除，MIN_BACKOFF 后由后台线程重试
+//   - 启动后台健康检查线程；开启了对冲时再启动对冲线程
+// 输出：健康副本数
+// =======================================================
+size_t RpcChannel::connect(){
+    auto now = clock::now();
+    for (auto& r : replicas_){
+        if (!reconnect(*r)){
+            std::cerr << "[channel] " << r->ep.str() << " unavailable\n";
+            r->backoff  = MIN_BACKOFF;
+            r->retry_at = now + r->backoff;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lk(health_mu_);
+        stop_ = false;
+    }
+    health_ = std::thread(&RpcChannel::health_loop, this);
+    if (hedging_){
+        {
+            std::lock_guard<std::mutex> lk(hq_mu_);
+            hq_stop_ = false;
+        }
+        hedger_ = std::thread(&RpcChannel::hedge_loop, this);
+    }
+    return healthy();
+}
+
+// 停止后台线程（健康检查、对冲）并关闭所有连接
+void RpcChannel::close(){
+    {
+        std::lock_guard<std::mutex> lk(health_mu_);
+        stop_ = true;
+    }
+    health_cv_.notify_all();
+    if (health_.joinable()) health_.join();
+    {
+        std::lock_guard<std::mutex> lk(hq_mu_);
+        hq_stop_ = true;
+    }
+    hq_cv_.notify_all();
+    if (hedger_.joinable()) hedger_.join();
+    for (auto& r : replicas_){
+        r->up = false;
+        std::lock_guard<std::mutex> lk(r->mu);
+        r->pool.reset();
+    }
+}
+
+// =======================================================
+// call / call_async:
+//   - pick() 选一条连接并发出请求
+//   - call_async 同步抛异常说明请求没发出去（连接已断）：剔除该副本，换一个重试
+//   - 没有健康副本 → throw runtime_error
+// =======================================================
+Response RpcChannel::call(const std::string& method, const std::vector<Value>& args){
+    return call_async(method, args).get();
+}
+
+std::future<Response> RpcChannel::call_async(const std::string& method, const std::vector<Value>& args){
+    for (int attempt = 1; ; ++attempt){
+        Replica* owner = nullptr;
+        std::shared_ptr<RpcClient> c = pick(owner);
+        if (!c) throw std::runtime_error("no healthy endpoint");
+        try{
+            return c->call_async(method, args);
+        }catch(const std::exception&){
+            eject(*owner);
+            if (attempt >= MAX_ATTEMPTS) throw;
+        }
+    }
+}
+
+// =======================================================
+// 对冲调用
+//   call_hedged(method, args):
+//     1) 存令牌，经 pick 发主请求（回调版本，记下 req_id），登记到对冲队列，然后等结果
+//     2) hedge_loop 在到期时刻（发出时刻 + hedge_delay）检查：仍未完成、有令牌、
+//        有别的副本/连接可用 → 发副本请求
+//     3) 先到的响应胜出，另一份经 RpcClient::cancel 本地取消（迟到的响应被丢弃）
+//        一份因连接断开失败而另一份仍在途时，等另一份
+//     4) 本次调用的延迟（到胜出响应为止）计入延迟窗口，用来更新 hedge_delay
+//   计时集中在一个线程上：调用方只做不带超时的等待，每次调用不必各自设定时器
+//   请求未发出（连接已断）的处理同 call_async：剔除副本，换一个重试
+// =======================================================
+
+// 一次对冲调用的共享状态：两份请求的回调（接收线程）、对冲线程与等待的调用方之间交接
+// 先完成的一份兑现 result；调用方只等这一个 future（与普通 call 同样的唤醒路径）
+struct HedgeCall {
+    // 调用方在 finished 之前一直等在 call_hedged 里，这两个指针在此期间有效
+    const std::string* method{nullptr};
+    const std::vector<Value>* args{nullptr};
+    std::chrono::steady_clock::time_point due;
+    RpcChannel::Replica* owner1{nullptr};
+    std::shared_ptr<RpcClient> c1;
+
+    std::atomic<int> left{0};       // 已发出、尚未完成的请求数
+    std::atomic<bool> done{false};
+    int winner{-1};                 // 0 = 主请求，1 = 副本；result 就绪后才读
+    std::promise<Response> result;
+
+    std::mutex mu;                  // 保护以下字段：对冲线程发副本 vs 调用方收尾
+    bool finished{false};
+    std::shared_ptr<RpcClient> c2;
+    uint32_t id2{0};
+
+    // 在接收线程上调用：只做交接，不阻塞
+    void finish(int idx, std::future<Response> f){
+        try{
+            Response r = f.get();
+            left.fetch_sub(1, std::memory_order_acq_rel);
+            if (done.exchange(true, std::memory_order_acq_rel)) return;
+            winner = idx;
+            result.set_value(std::move(r));
+        }catch(...){
+            // 连接断开：另一份还在途就等它，否则把错误交给调用方
+            if (left.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+            if (done.exchange(true, std::memory_order_acq_rel)) return;
+            winner = idx;
+            result.set_exception(std::current_exception());
+        }
+    }
+};
+
+void RpcChannel::set_hedging(const HedgePolicy& p){
+    hedge_ = p;
+    hedging_ = true;
+    hedge_delay_us_.store(p.min_delay.count(), std::memory_order_relaxed);
+    tokens_milli_.store((int64_t)(p.budget_burst * 1000), std::memory_order_relaxed);
+}
+
+HedgeStats RpcChannel::hedge_stats() const {
+    HedgeStats s;
+    s.calls         = n_calls_.load(std::memory_order_relaxed);
+    s.hedges        = n_hedges_.load(std::memory_order_relaxed);
+    s.hedge_wins    = n_wins_.load(std::memory_order_relaxed);
+    s.budget_denied = n_denied_.load(std::memory_order_relaxed);
+    s.delay = std::chrono::microseconds(hedge_delay_us_.load(std::memory_order_relaxed));
+    return s;
+}
+
+// 令牌桶：取一个令牌（千分之一为单位的原子计数，CAS 扣减）
+bool RpcChannel::take_hedge_token(){
+    int64_t cur = tokens_milli_.load(std::memory_order_relaxed);
+    while (cur >= 1000)
+        if (tokens_milli_.compare_exchange_weak(cur, cur - 1000, std::memory_order_relaxed)) return true;
+    return false;
+}
+
+// 延迟样本：每 DELAY_REFRESH 个重算一次分位，夹在 [min_delay, max_delay]
+// 只是估计分位，锁被占用时直接丢弃样本
+void RpcChannel::record_latency(clock::duration d){
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    std::unique_lock<std::mutex> lk(lat_mu_, std::try_to_lock);
+    if (!lk.owns_lock()) return;           // 有别的线程在记：丢掉这个样本，不在这里排队
+    lat_.record(ns);
+    uint64_t n = lat_.count();
+    if (n % DELAY_REFRESH != 0 || n < hedge_.min_samples) return;
+    int64_t us = (int64_t)(lat_.percentile(hedge_.percentile) / 1000);
+    us = std::min<int64_t>(std::max<int64_t>(us, hedge_.min_delay.count()), hedge_.max_delay.count());
+    hedge_delay_us_.store(us, std::memory_order_relaxed);
+    if (n >= DELAY_WINDOW) lat_.reset();
+}
+
+// 发出第 idx 份（回调版本，记下 req_id）；连接已断 → false，由调用方剔除副本
+static bool send_copy(const std::shared_ptr<HedgeCall>& st, int idx, RpcClient& c, uint32_t& id){
+    st->left.fetch_add(1, std::memory_order_acq_rel);
+    try{
+        id = c.call_async(*st->method, *st->args, [st, idx](std::future<Response> f){
+            st->finish(idx, std::move(f));
+        });
+        return true;
+    }catch(const std::exception&){
+        st->left.fetch_sub(1, std::memory_order_acq_rel);
+        return false;
+    }
+}
+
+Response RpcChannel::call_hedged(const std::string& method, const std::vector<Value>& args){
+    if (!hedging_) return call(method, args);
+    n_calls_.fetch_add(1, std::memory_order_relaxed);
+
+    // 存令牌（不超过上限）
+    int64_t cap = (int64_t)(hedge_.budget_burst * 1000);
+    int64_t add = (int64_t)(hedge_.budget_ratio * 1000);
+    int64_t cur = tokens_milli_.load(std::memory_order_relaxed);
+    while (cur < cap &&
+           !tokens_milli_.compare_exchange_weak(cur, std::min(cap, cur + add), std::memory_order_relaxed)){}
+
+    auto st = std::make_shared<HedgeCall>();
+    st->method = &method;
+    st->args   = &args;
+    std::future<Response> fut = st->result.get_future();
+    auto t0 = clock::now();
+
+    uint32_t id1 = 0;
+    for (int attempt = 1; ; ++attempt){
+        st->c1 = pick(st->owner1);
+        if (!st->c1) throw std::runtime_error("no healthy endpoint");
+        if (send_copy(st, 0, *st->c1, id1)) break;
+        eject(*st->owner1);
+        if (attempt >= MAX_ATTEMPTS) throw std::runtime_error("no reachable endpoint");
+    }
+
+    // 登记到对冲队列：队列原本为空时对冲线程在无限期等待，需要叫醒
+    st->due = t0 + std::chrono::microseconds(hedge_delay_us_.load(std::memory_order_relaxed));
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lk(hq_mu_);
+        if (!hq_stop_){                       // 已 close：不再对冲，只等主请求
+            wake = hq_.empty();
+            hq_.push_back(st);
+        }
+    }
+    if (wake) hq_cv_.notify_one();
+
+    fut.wait();
+    // 收尾：此后对冲线程不再发副本（它可能正在发，拿到锁时已发完）
+    std::shared_ptr<RpcClient> c2;
+    uint32_t id2;
+    {
+        std::lock_guard<std::mutex> lk(st->mu);
+        st->finished = true;
+        c2  = std::move(st->c2);
+        id2 = st->id2;
+    }
+    // 取消输家（已经完成的取消不到，无害）
+    if (c2){
+        if (st->winner == 1){
+            n_wins_.fetch_add(1, std::memory_order_relaxed);
+            st->c1->cancel(id1);
+        }else{
+            c2->cancel(id2);
+        }
+    }
+    record_latency(clock::now() - t0);
+    return fut.get();
+}
+
+// 到期仍未完成：有别的副本/连接且有令牌 → 发副本（持 st->mu，调用方收尾时会等它发完）
+void RpcChannel::maybe_hedge(const std::shared_ptr<HedgeCall>& st){
+    if (st->done.load(std::memory_order_acquire)) return;
+    std::lock_guard<std::mutex> lk(st->mu);
+    if (st->finished || st->done.load(std::memory_order_acquire)) return;
+    Replica* owner2 = nullptr;
+    std::shared_ptr<RpcClient> alt = pick(owner2, st->owner1, st->c1.get());
+    if (!alt || alt == st->c1) return;
+    if (!take_hedge_token()){
+        n_denied_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!send_copy(st, 1, *alt, st->id2)){
+        eject(*owner2);
+        return;
+    }
+    st->c2 = std::move(alt);
+    n_hedges_.fetch_add(1, std::memory_order_relaxed);
+}
+
+// 对冲线程：按到期顺序处理队列；队列空时无限期等待，否则睡到队头到期
+// 两次醒来至少隔一个 tick（对冲延迟的 1/4，不少于 HEDGE_TICK）：调用密集时一次醒来
+// 处理一批到期的调用，而不是每个调用醒一次；代价是副本最多晚发一个 tick
+void RpcChannel::hedge_loop(){
+    std::unique_lock<std::mutex> lk(hq_mu_);
+    clock::time_point next_run{};       // 上一批处理完后，最早的下一次处理时刻
+    while (!hq_stop_){
+        if (hq_.empty()){
+            hq_cv_.wait(lk);
+            continue;
+        }
+        auto now = clock::now();
+        clock::time_point due = std::max(hq_.front()->due, next_run);
+        if (now < due){
+            hq_cv_.wait_until(lk, due);
+            continue;
+        }
+        // 处理所有已到期的调用（大多已经完成，maybe_hedge 一次原子读就返回）
+        while (!hq_.empty() && hq_.front()->due <= now){
+            std::shared_ptr<HedgeCall> st = std::move(hq_.front());
+            hq_.pop_front();
+            lk.unlock();
+            maybe_hedge(st);
+            st.reset();
+            lk.lock();
+        }
+        auto tick = std::max<clock::duration>(
+            HEDGE_TICK, std::chrono::microseconds(hedge_delay_us_.load(std::memory_order_relaxed) / 4));
+        next_run = now + tick;
+    }
+    hq_.clear();
+}
+
+size_t RpcChannel::healthy() const {
+    size_t n = 0;
+    for (auto& r : replicas_) n += r->up.load(std::memory_order_relaxed) ? 1 : 0;
+    return n;
+}
+
+std::vector<uint64_t> RpcChannel::picks() const {
+    std::vector<uint64_t> out;
+    for (auto& r : replicas_) out.push_back(r->picks.load(std::memory_order_relaxed));
+    return out;
+}
+
+std::shared_ptr<const RpcChannel::Pool> RpcChannel::pool_of(Replica& r){
+    std::lock_guard<std::mutex> lk(r.mu);
+    return r.pool;
+}
+
+// 副本负载 = 其所有连接上未完成的调用数之和
+uint32_t RpcChannel::outstanding(Replica& r){
+    auto pool = pool_of(r);
+    uint32_t n = 0;
+    if (pool) for (auto& c : *pool) n += c->outstanding();
+    return n;
+}
+
+// =======================================================
+// pick(owner, avoid, avoid_conn):
+//   1) 收集健康副本（跳过 avoid，除非只剩它）；随机取两个不同的副本，选未完成调用数少的
+//      （只有一个则直接用）
+//   2) 副本内选未完成调用数最少的连接（有别的连接时跳过 avoid_conn）
+// 输出：连接（owner 指向所属副本）；没有健康副本 → nullptr
+// =======================================================
+std::shared_ptr<RpcClient> RpcChannel::pick(Replica*& owner, const Replica* avoid,
+                                            const RpcClient* avoid_conn){
+    thread_local std::vector<Replica*> cand;
+    cand.clear();
+    Replica* avoided = nullptr;
+    for (auto& r : replicas_){
+        if (!r->up.load(std::memory_order_acquire)) continue;
+        if (r.get() == avoid) avoided = r.get();
+        else cand.push_back(r.get());
+    }
+    if (cand.empty() && avoided) cand.push_back(avoided);   // 只剩它：换一条连接
+    if (cand.empty()) return nullptr;
+
+    uint32_t n = (uint32_t)cand.size();
+    uint32_t i = rand_below(n);
+    Replica* best = cand[i];
+    if (n > 1){
+        Replica* other = cand[(i + 1 + rand_below(n - 1)) % n];
+        if (outstanding(*other) < outstanding(*best)) best = other;
+    }
+
+    auto pool = pool_of(*best);
+    if (!pool || pool->empty()) return nullptr;   // 刚被关闭
+    const std::shared_ptr<RpcClient>* c = nullptr;
+    for (auto& x : *pool){
+        if (x.get() == avoid_conn && pool->size() > 1) continue;
+        if (!c || x->outstanding() < (*c)->outstanding()) c = &x;
+    }
+
+    best->picks.fetch_add(1, std::memory_order_relaxed);
+    owner = best;
+    return *c;
+}
+
+// 新建一整池连接；全部成功才替换旧池并标记为健康
+// 每条连接最多等 CONNECT_TIMEOUT：卡住的副本按失败处理（走正常退避），不会拖住 health_loop 与 close()
+bool RpcChannel::reconnect(Replica& r){
+    auto pool = std::make_shared<Pool>();
+    for (size_t i = 0; i < conns_per_ep_; ++i){
+        auto c = std::make_shared<RpcClient>(r.ep);
+        if (!c->try_connect_server(CONNECT_TIMEOUT)) return false;
+        pool->push_back(std::move(c));
+    }
+    {
+        std::lock_guard<std::mutex> lk(r.mu);
+        r.pool = std::move(pool);
+    }
+    r.backoff = std::chrono::milliseconds(0);
+    r.up.store(true, std::memory_order_release);
+    return true;
+}
+
+// 剔除：之后 pick 不再选它；重连由后台线程负责
+void RpcChannel::eject(Replica& r){
+    if (r.up.exchange(false))
+        std::cerr << "[channel] eject " << r.ep.str() << "\n";
+}
+
+// =======================================================
+// health_loop():
+//   每 HEALTH_INTERVAL：
+//   - 健康副本：任一连接已断开（对端关闭/发送失败）→ 剔除，MIN_BACKOFF 后重试
+//   - 已剔除副本：到了 retry_at 就重连；成功 → 重新加入，失败 → 退避翻倍（上限 MAX_BACKOFF）
+// =======================================================
+void RpcChannel::health_loop(){
+    std::unique_lock<std::mutex> lk(health_mu_);
+    while (!health_cv_.wait_for(lk, HEALTH_INTERVAL, [this]{ return stop_; })){
+        lk.unlock();
+        auto now = clock::now();
+        for (auto& rp : replicas_){
+            Replica& r = *rp;
+            if (r.up.load(std::memory_order_acquire)){
+                auto pool = pool_of(r);
+                bool dead = !pool || std::any_of(pool->begin(), pool->end(),
+                                                 [](const std::shared_ptr<RpcClient>& c){
+                                                     return !c->connected();
+                                                 });
+                if (!dead) continue;
+                eject(r);
+                r.backoff  = MIN_BACKOFF;
+                r.retry_at = now + r.backoff;
+                continue;
+            }
+            if (now < r.retry_at) continue;
+            if (reconnect(r)){
+                std::cerr << "[channel] re-admit " << r.ep.str() << "\n";
+            }else{
+                r.backoff  = std::min<std::chrono::milliseconds>(
+                    std::max<std::chrono::milliseconds>(r.backoff * 2, MIN_BACKOFF), MAX_BACKOFF);
+                r.retry_at = clock::now() + r.backoff;
+            }
+        }
+        lk.lock();
+    }
+}
+
+} // namespace rpc
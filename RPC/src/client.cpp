@@ -1,73 +1,680 @@
 #include "rpc/client.h"
+#include "rpc/buffer_pool.h"
 #include "rpc/frame.h"
 #include "rpc/net.h"
+#include "rpc/transport.h"
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <utility>
 
 namespace rpc {
 
 // =======================================================
 // RpcClient 类：封装 RPC 客户端逻辑
-//   - 管理与服务端的 TCP 连接
-//   - 发送请求（Request）并接收响应（Response）
-//   - 对外提供 call(method, args) 接口，像本地函数一样调用远程方法
+//   - 管理与服务端的连接（TCP / UNIX socket / 共享内存，见 transport.cpp）
+//   - 发送请求（Request），后台线程接收响应（Response）并按 req_id 分发
+//   - 对外提供 call / call_async / call_batch 接口，像本地函数一样调用远程方法
 // =======================================================
 
-// 构造函数：保存 host 和 port 信息
+// 构造函数：保存服务端地址
 RpcClient::RpcClient(std::string host, uint16_t port)
-    : host_(std::move(host)), port_(port) {}
+    : ep_(Endpoint::tcp(std::move(host), port)) {}
+
+RpcClient::RpcClient(Endpoint ep) : ep_(std::move(ep)) {}
 
 // 析构函数：保证退出时关闭连接
 RpcClient::~RpcClient(){ close_client(); }
 
-// 建立到服务端的 TCP 连接
+// 建立到服务端的连接（失败直接退出），启动接收线程并协商
+// 已连接时先关闭旧连接（等旧接收线程退出），再建新连接
 void RpcClient::connect_server(){
-    fd_ = tcp_connect(host_, port_);
-    std::cout << "[client] connected to " << host_ << ":" << port_ << "\n";
+    if (conn_ || reader_.joinable()) close_client();
+    conn_ = try_connect(ep_);
+    if (!conn_) die("connect " + ep_.str());
+    start_session();
+}
+
+// 同 connect_server，但连不上或协商途中连接断开时返回 false（不退出），用于多副本
+bool RpcClient::try_connect_server(){
+    return try_connect_server(std::chrono::milliseconds::max());
 }
 
-// 主动关闭客户端连接
+// 带超时：连接最多等 timeout，__hello 只用剩下的预算；任一步超时都按连不上处理
+bool RpcClient::try_connect_server(std::chrono::milliseconds timeout){
+    if (conn_ || reader_.joinable()) close_client();
+    const bool bounded = timeout != std::chrono::milliseconds::max();
+    const auto start = std::chrono::steady_clock::now();
+    conn_ = try_connect(ep_, bounded ? (int)std::max<int64_t>(timeout.count(), 1) : 0);
+    if (!conn_) return false;
+    auto left = timeout;
+    if (bounded)
+        left -= std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    try{
+        start_session(bounded ? std::max(left, std::chrono::milliseconds(1)) : left);
+    }catch(const std::exception&){
+        close_client();
+        return false;
+    }
+    return true;
+}
+
+// 启动接收线程，并协商线上编码版本与特性
+//   - 先用 v1 调用 __hello(max_version_, features)
+//   - 服务端返回 version | (features << 8)；失败（老服务端不认识 __hello）则保持 v1、无特性
+//   - hello_timeout 内没有响应（对端卡住）→ 抛 runtime_error，由调用方关闭连接
+void RpcClient::start_session(std::chrono::milliseconds hello_timeout){
+    {
+        std::lock_guard<std::mutex> lk(pending_mu_);
+        closed_ = false;
+    }
+    wire_version_ = VERSION;
+    use_method_ids_ = false;
+    use_batch_ = false;
+    use_deadline_ = false;
+    reader_ = std::thread(&RpcClient::reader_loop, this);
+
+    int64_t want_feats = (want_method_ids_ ? FEATURE_METHOD_ID : 0) | FEATURE_BATCH | FEATURE_DEADLINE;
+    if (max_version_ > VERSION || want_feats){
+        Response r = call(HELLO_METHOD, { Value::make_int(max_version_), Value::make_int(want_feats) },
+                          hello_timeout);
+        if (r.status == STATUS_DEADLINE_EXCEEDED) throw std::runtime_error("hello timed out");
+        if (r.status == 0 && r.has_result && r.result.type() == ValueType::INT64){
+            int64_t ver   = r.result.i64() & 0xFF;
+            int64_t feats = (r.result.i64() >> 8) & want_feats;
+            if (ver >= VERSION && ver <= max_version_) wire_version_ = (uint8_t)ver;
+            use_method_ids_ = (feats & FEATURE_METHOD_ID) != 0;
+            use_batch_ = (feats & FEATURE_BATCH) != 0;
+            use_deadline_ = (feats & FEATURE_DEADLINE) != 0;
+        }
+    }
+    std::cout << "[client] connected to " << ep_.str()
+              << " (wire v" << int(wire_version_)
+              << (use_method_ids_ ? ", method ids" : "")
+              << (use_batch_ ? ", batch" : "")
+              << (use_deadline_ ? ", deadlines" : "") << ")\n";
+}
+
+// 主动关闭客户端连接：先 shutdown 唤醒接收线程，等它退出后再释放连接
 void RpcClient::close_client(){
-    if (fd_ >= 0) close_fd(fd_);
-    fd_ = -1;
+    if (conn_) conn_->shutdown();
+    if (reader_.joinable()) reader_.join();
+    conn_.reset();
 }
 
 // =======================================================
 // call(method, args):
+//   - 同步调用：call_async 后阻塞等待 future
+//   - 如果服务端关闭连接，则抛出 runtime_error 异常
+// =======================================================
+Response RpcClient::call(const std::string& method, const std::vector<Value>& args){
+    return call_async(method, args).get();
+}
+
+// =======================================================
+// call_async(method, args):
 //   - 构造一个请求 Request {id, method, args}
-//   - 将请求序列化为字节帧并通过 TCP 发送
-//   - 阻塞等待服务端返回 Response 帧
-//   - 如果响应的 req_id 与当前请求的 id 匹配，则解析并返回 Response
+//   - 先在 pending_ 中登记 id → promise（保证响应先到也能路由到）
+//   - 序列化请求帧并发送（write_frame 保证多线程下帧不交错）
+//   - 立即返回 future，由接收线程在响应到达时填充
 //
 // 输入：
 //   - method: 远程方法名（如 "add"、"echo"）
 //   - args  : 调用参数（Value 向量，支持 int、string 等）
 //
 // 输出：
-//   - Response 对象（包含 status、错误信息、返回值）
-//   - 如果服务端关闭连接，则抛出 runtime_error 异常
+//   - std::future<Response>；连接已关闭时 future 中为 runtime_error
 // =======================================================
-Response RpcClient::call(const std::string& method, const std::vector<Value>& args){
+std::future<Response> RpcClient::call_async(const std::string& method, const std::vector<Value>& args){
+    std::future<Response> fut;
+    send_request(method, args, nullptr, &fut);
+    return fut;
+}
+
+// =======================================================
+// call(method, args, timeout) / call_async(method, args, timeout):
+//   - 截止时间 = 现在 + timeout；服务端协商了 FEATURE_DEADLINE 时写进帧头，
+//     请求在服务端排队到过期就不会执行（回 status=4）
+//   - call 最多等到截止时间：仍无响应 → 从 pending_ 摘除（迟到的响应被丢弃），
+//     本地回 status=4；摘除前响应恰好到达则照常返回
+//   - 服务端不支持截止时间时只做本地超时
+// =======================================================
+static Response deadline_exceeded(uint32_t req_id){
+    Response rsp;
+    rsp.req_id = req_id;
+    rsp.status = STATUS_DEADLINE_EXCEEDED;
+    rsp.err_msg = "deadline exceeded";
+    rsp.has_result = false;
+    return rsp;
+}
+
+Response RpcClient::call(const std::string& method, const std::vector<Value>& args,
+                         std::chrono::milliseconds timeout){
+    if (timeout == std::chrono::milliseconds::max()) return call(method, args);
+    if (timeout.count() <= 0) return deadline_exceeded(0);
+    Deadline deadline = std::chrono::steady_clock::now() + timeout;
+    std::future<Response> fut;
+    uint32_t id = send_request(method, args, nullptr, &fut, deadline);
+    if (fut.wait_until(deadline) == std::future_status::ready) return fut.get();
+    {
+        std::lock_guard<std::mutex> lk(pending_mu_);
+        if (pending_.erase(id)){
+            note_outstanding();
+            return deadline_exceeded(id);
+        }
+    }
+    return fut.get();
+}
+
+// timeout → 截止时间（max 表示不带截止时间）
+static Deadline deadline_after(std::chrono::milliseconds timeout){
+    if (timeout == std::chrono::milliseconds::max()) return Deadline{};
+    return std::chrono::steady_clock::now() + std::max(timeout, std::chrono::milliseconds(0));
+}
+
+std::future<Response> RpcClient::call_async(const std::string& method, const std::vector<Value>& args,
+                                            std::chrono::milliseconds timeout){
+    std::future<Response> fut;
+    send_request(method, args, nullptr, &fut, deadline_after(timeout));
+    return fut;
+}
+
+// 回调版本：不占调用方线程，响应由接收线程直接交给 done；返回请求 id（可用于 cancel）
+uint32_t RpcClient::call_async(const std::string& method, const std::vector<Value>& args, Callback done,
+                               std::chrono::milliseconds timeout){
+    return send_request(method, args, nullptr, nullptr, deadline_after(timeout), std::move(done));
+}
+
+// 放弃一个回调版本的调用：只摘掉回调，条目留在 pending_ 里直到迟到的响应（或断线）把它清掉
+// 服务端照常执行，所以它仍计入 outstanding()：负载均衡不会因为取消而把请求继续发往卡住的副本
+// （对冲请求的输家靠这个收尾）
+bool RpcClient::cancel(uint32_t req_id){
+    std::lock_guard<std::mutex> lk(pending_mu_);
+    auto it = pending_.find(req_id);
+    if (it == pending_.end() || !it->second.done) return false;
+    it->second.done = nullptr;
+    return true;
+}
+
+#ifdef TINY_RPC_COROUTINES
+// =======================================================
+// co_call(method, args, timeout):
+//   - 基于回调版本：接收线程在响应到达时填好 future
+//   - 协程已在等待 → 经它挂起时记下的执行器恢复（没有执行器则就地恢复）
+//   - 协程还没 co_await → 只标记 ready，co_await 时不挂起
+// =======================================================
+CallAwaitable RpcClient::co_call(const std::string& method, const std::vector<Value>& args,
+                                 std::chrono::milliseconds timeout){
+    auto st = std::make_shared<CallAwaitable::State>();
+    call_async(method, args, [st](std::future<Response> fut){
+        std::coroutine_handle<> h;
+        const Executor* ex;
+        {
+            std::lock_guard<std::mutex> lk(st->mu);
+            st->fut = std::move(fut);
+            st->ready = true;
+            h = st->waiter;
+            ex = st->exec;
+        }
+        if (!h) return;
+        if (ex) (*ex)([h]{ h.resume(); });
+        else    h.resume();
+    }, timeout);
+    return CallAwaitable(std::move(st));
+}
+
+bool CallAwaitable::await_ready() const {
+    std::lock_guard<std::mutex> lk(st_->mu);
+    return st_->ready;
+}
+
+bool CallAwaitable::await_suspend(std::coroutine_handle<> h){
+    std::lock_guard<std::mutex> lk(st_->mu);
+    if (st_->ready) return false;
+    st_->waiter = h;
+    st_->exec = current_executor();
+    return true;
+}
+
+// ready 之后 fut 不再被改写
+Response CallAwaitable::await_resume(){ return st_->fut.get(); }
+#endif
+
+// =======================================================
+// send_request(method, args, stream, reply, deadline):
+//   - 分配 id、编码请求帧（不持锁；每个线程复用自己的编码缓冲区）
+//   - 交给 send_encoded 登记并发送
+// 输出：请求 id；连接已关闭 → throw runtime_error
+// =======================================================
+uint32_t RpcClient::send_request(const std::string& method, const std::vector<Value>& args,
+                                 const std::shared_ptr<ClientStreamState>& stream,
+                                 std::future<Response>* reply, Deadline deadline,
+                                 Callback done){
     // 为请求分配一个唯一 id
     uint32_t id = next_id_++;
-    Request req{ id, method, args };
+    std::vector<uint8_t>& frame = frame_buffer();
+    frame.clear();
+    append_request_frame(id, method, wire_method_id(method), args,
+                         use_deadline_ ? deadline : Deadline{}, frame, wire_version_);
+    send_encoded(id, frame, stream, reply, std::move(done));
+    return id;
+}
 
-    // 序列化请求帧并发送
-    std::vector<uint8_t> frame;
-    build_request_frame(req, frame);
-    send_frame(fd_, frame);
+// 方法 ID 固定 4 字节：只有名字更长时才划算
+uint32_t RpcClient::wire_method_id(const std::string& method) const {
+    return (use_method_ids_ && method.size() > 4) ? method_id_of(method) : 0;
+}
+
+std::vector<uint8_t>& RpcClient::frame_buffer(){
+    thread_local std::vector<uint8_t> frame;
+    return frame;
+}
+
+// =======================================================
+// send_encoded(id, frame, stream, reply, done):
+//   - 在 pending_mu_ 下登记：reply 非空 → pending_；done 非空 → 回调；stream 非空 → streams_
+//     （先登记再发送，保证响应先到也能路由到）
+//   - write_frame 整帧发送
+// 连接已关闭 → throw runtime_error
+// =======================================================
+void RpcClient::send_encoded(uint32_t id, const std::vector<uint8_t>& frame,
+                             const std::shared_ptr<ClientStreamState>& stream,
+                             std::future<Response>* reply, Callback done){
+    {
+        std::lock_guard<std::mutex> lk(pending_mu_);
+        if (closed_) throw std::runtime_error("client not connected");
+        if (reply){
+            *reply = pending_[id].p.get_future();
+        }else if (done){
+            PendingCall& pc = pending_[id];
+            pc.fut  = pc.p.get_future();
+            pc.done = std::move(done);
+        }
+        if (stream) streams_[id] = stream;
+        note_outstanding();
+    }
+
+    write_frame(frame);
+}
+
+// 发送流控制/数据帧；连接已关闭则静默丢弃（等待方会从 ClientStreamState 看到错误）
+void RpcClient::send_raw(const std::vector<uint8_t>& frame){
+    {
+        std::lock_guard<std::mutex> lk(pending_mu_);
+        if (closed_) return;
+    }
+    write_frame(frame);
+}
 
-    // 循环等待响应帧
+// 整帧发送，多线程合并写：
+//   - 没人在写：自己写，写完再把期间别人交来的帧整批带走，直到没有剩余
+//   - 有人在写：把帧追加到 send_pending_ 后立即返回，由正在写的线程代发
+// 连接开了 TCP_NODELAY，并发调用的小帧靠这里合并成一次 write，而不是靠 Nagle 攒包
+// 帧整段复制进 send_pending_，调用方返回后即可复用自己的缓冲区；同一线程先后交来的帧保持顺序
+// 发送失败（对端已关闭）：shutdown 唤醒接收线程，由它让所有未完成的调用失败
+void RpcClient::write_frame(const std::vector<uint8_t>& frame){
+    std::unique_lock<std::mutex> lk(send_mu_);
+    if (writing_){
+        send_pending_.insert(send_pending_.end(), frame.begin(), frame.end());
+        return;
+    }
+    writing_ = true;
+    const uint8_t* p = frame.data();
+    size_t n = frame.size();
     while (true){
-        auto rf_opt = recv_frame(fd_);
-        if (!rf_opt) throw std::runtime_error("server closed");
+        lk.unlock();
+        bool ok = conn_->write(p, n);
+        lk.lock();
+        if (!ok){
+            conn_->shutdown();
+            send_pending_.clear();
+            break;
+        }
+        if (send_pending_.empty()) break;
+        send_batch_.swap(send_pending_);
+        send_pending_.clear();
+        p = send_batch_.data();
+        n = send_batch_.size();
+    }
+    writing_ = false;
+}
+
+// 未完成的调用数（调用方持有 pending_mu_）；负载均衡据此挑选连接
+void RpcClient::note_outstanding(){
+    outstanding_.store((uint32_t)(pending_.size() + pending_batch_.size()),
+                       std::memory_order_relaxed);
+}
+
+bool RpcClient::connected() const {
+    std::lock_guard<std::mutex> lk(pending_mu_);
+    return !closed_;
+}
 
-        auto rf = *rf_opt;
-        if (rf.type != MsgType::RESPONSE) continue;  // 只关心响应消息
-        if (rf.req_id != id) continue;               // 如果不是当前请求的响应，丢弃
+// =======================================================
+// call_stream(method, args):
+//   - 服务端流：登记 streams_ 后发出普通 REQUEST
+//   - 服务端逐块回 STREAM_DATA，最后 STREAM_END 带结束状态；
+//     方法不存在等错误时服务端直接回 RESPONSE，同样作为结束状态
+// =======================================================
+StreamCall RpcClient::call_stream(const std::string& method, const std::vector<Value>& args){
+    auto st = std::make_shared<ClientStreamState>();
+    uint32_t id = send_request(method, args, st, nullptr);
+    return StreamCall(this, id, std::move(st));
+}
+
+// =======================================================
+// open_client_stream(method, args):
+//   - 客户端流：同时登记 streams_（接收额度）与 pending_（最终响应）
+//   - 之后由 ClientStream::write 逐块发 STREAM_DATA，finish 发 STREAM_END
+// =======================================================
+ClientStream RpcClient::open_client_stream(const std::string& method, const std::vector<Value>& args){
+    auto st = std::make_shared<ClientStreamState>();
+    std::future<Response> fut;
+    uint32_t id = send_request(method, args, st, &fut);
+    return ClientStream(this, id, std::move(st), std::move(fut));
+}
+
+// =======================================================
+// StreamCall: 服务端流的接收端
+//   next：等到有块或流结束；每消费 STREAM_WINDOW/2 块回一次额度
+//   cancel / 析构：未读完时发 STREAM_END 通知服务端停止
+// =======================================================
+StreamCall::~StreamCall(){
+    if (!st_ || finished_) return;
+    try{ cancel(); }catch(...){}
+}
+
+bool StreamCall::next(Value& out){
+    bool more;
+    {
+        std::unique_lock<std::mutex> lk(st_->mu);
+        st_->cv.wait(lk, [this]{ return !st_->q.empty() || st_->done; });
+        if (st_->q.empty()){
+            finished_ = true;
+            if (!st_->error.empty()) throw std::runtime_error(st_->error);
+            return false;
+        }
+        out = std::move(st_->q.front());
+        st_->q.pop_front();
+        more = !st_->done && !finished_;
+    }
+    if (++consumed_ >= STREAM_WINDOW / 2 && more){
+        std::vector<uint8_t> frame;
+        append_stream_credit_frame(id_, consumed_, frame, c_->wire_version_);
+        c_->send_raw(frame);
+        consumed_ = 0;
+    }
+    return true;
+}
+
+void StreamCall::cancel(){
+    if (finished_) return;
+    finished_ = true;
+    std::vector<uint8_t> frame;
+    append_stream_end_frame(id_, frame, c_->wire_version_);
+    c_->send_raw(frame);
+}
+
+// =======================================================
+// ClientStream: 客户端流的发送端
+//   write：额度为 0 时阻塞；服务端已回响应（提前结束）→ false；连接断开 → throw
+//   finish：发 STREAM_END，等待服务端 handler 的返回值
+// =======================================================
+ClientStream::~ClientStream(){
+    if (!st_ || finished_) return;
+    try{
+        std::vector<uint8_t> frame;
+        append_stream_end_frame(id_, frame, c_->wire_version_);
+        c_->send_raw(frame);
+    }catch(...){}
+}
+
+bool ClientStream::write(const Value& chunk){
+    {
+        std::unique_lock<std::mutex> lk(st_->mu);
+        st_->cv.wait(lk, [this]{ return st_->credit > 0 || st_->done; });
+        if (st_->done){
+            if (!st_->error.empty()) throw std::runtime_error(st_->error);
+            return false;
+        }
+        --st_->credit;
+    }
+    std::vector<uint8_t> frame;
+    append_stream_data_frame(id_, chunk, frame, c_->wire_version_);
+    c_->send_raw(frame);
+    return true;
+}
+
+Response ClientStream::finish(){
+    if (finished_) throw std::runtime_error("client stream already finished");
+    finished_ = true;
+    bool done;
+    {
+        std::lock_guard<std::mutex> lk(st_->mu);
+        done = st_->done;
+    }
+    if (!done){
+        std::vector<uint8_t> frame;
+        append_stream_end_frame(id_, frame, c_->wire_version_);
+        c_->send_raw(frame);
+    }
+    return fut_.get();
+}
 
-        // 解析 payload，构造 Response 返回
-        return parse_response_payload(rf.req_id, rf.payload);
+// =======================================================
+// call_batch(reqs) / call_batch_async(reqs):
+//   - 分配一个批次 id，把所有请求编码进一个 BATCH 帧，一次 send
+//   - 服务端回一个 BATCH 帧，按序包含 N 个响应（各项 req_id 均为批次 id）
+//   - 服务端未协商出 FEATURE_BATCH：逐个 call_async 流水线发出，
+//     返回的 future 在 get() 时依次收集（deferred）
+//
+// 输出：与 reqs 按序对应的 Response；连接已关闭时 future 中为 runtime_error
+// =======================================================
+std::vector<Response> RpcClient::call_batch(const std::vector<Request>& reqs){
+    return call_batch_async(reqs).get();
+}
+
+std::future<std::vector<Response>> RpcClient::call_batch_async(std::vector<Request> reqs){
+    if (!use_batch_){
+        std::vector<std::future<Response>> futs;
+        futs.reserve(reqs.size());
+        for (auto& r : reqs) futs.push_back(call_async(r.method, r.args));
+        return std::async(std::launch::deferred, [futs = std::move(futs)]() mutable {
+            std::vector<Response> out;
+            out.reserve(futs.size());
+            for (auto& f : futs) out.push_back(f.get());
+            return out;
+        });
+    }
+
+    uint32_t id = next_id_++;
+    for (auto& r : reqs)
+        r.method_id = (use_method_ids_ && r.method.size() > 4) ? method_id_of(r.method) : 0;
+
+    thread_local std::vector<uint8_t> frame;
+    frame.clear();
+    append_batch_request_frame(id, reqs, frame, wire_version_);
+
+    std::future<std::vector<Response>> fut;
+    {
+        std::lock_guard<std::mutex> lk(pending_mu_);
+        if (closed_) throw std::runtime_error("client not connected");
+        fut = pending_batch_[id].get_future();
+        note_outstanding();
+    }
+
+    write_frame(frame);
+    return fut;
+}
+
+// =======================================================
+// reader_loop():
+//   - 接收线程主循环：不断 recv_frame
+//   - RESPONSE 帧按 req_id 在 pending_ 中找到 promise 并 set_value；登记了回调则随后调用
+//   - BATCH 帧按批次 id 在 pending_batch_ 中找到 promise，解析出全部响应
+//   - 批次 id 收到普通 RESPONSE：服务端拒绝了整批（格式错误），该批以其 err_msg 失败
+//   - 找不到对应 id（已超时/重复）的响应直接丢弃
+//   - 对端关闭或帧解析失败：让所有未完成的调用失败并退出
+// =======================================================
+void RpcClient::reader_loop(){
+    std::string why = "server closed";
+    // 帧体缓冲区整个连接复用；偶发的超大帧处理完就换回池里的小缓冲区
+    std::vector<uint8_t> body = BufferPool::acquire();
+    try{
+        while (true){
+            if (body.capacity() > BufferPool::MAX_CLASS_BYTES){
+                std::vector<uint8_t>().swap(body);
+                body = BufferPool::acquire();
+            }
+            if (!recv_body(*conn_, body)) break;
+
+            RawFrameView rf = parse_body_to_view(body.data(), body.size());
+            if (rf.type == MsgType::STREAM_DATA || rf.type == MsgType::STREAM_CREDIT ||
+                rf.type == MsgType::STREAM_END){
+                on_stream_frame(rf);
+                continue;
+            }
+            if (rf.type != MsgType::RESPONSE && rf.type != MsgType::BATCH) continue;
+
+            // optional：只有真的找到等待者才构造 promise（默认构造 promise 也要分配共享状态）
+            std::optional<PendingCall> pc;
+            std::optional<std::promise<std::vector<Response>>> bp;
+            std::shared_ptr<ClientStreamState> sst;   // 该 id 上的流以此 RESPONSE 结束
+            {
+                std::lock_guard<std::mutex> lk(pending_mu_);
+                if (rf.type == MsgType::RESPONSE){
+                    auto it = pending_.find(rf.req_id);
+                    if (it != pending_.end()){
+                        pc.emplace(std::move(it->second));
+                        pending_.erase(it);
+                    }
+                    auto sit = streams_.find(rf.req_id);
+                    if (sit != streams_.end()){
+                        sst = std::move(sit->second);
+                        streams_.erase(sit);
+                    }
+                }
+                if (!pc && !sst){
+                    auto bit = pending_batch_.find(rf.req_id);
+                    if (bit == pending_batch_.end()) continue;
+                    bp.emplace(std::move(bit->second));
+                    pending_batch_.erase(bit);
+                }
+                note_outstanding();
+            }
+
+            if (bp){
+                try{
+                    if (rf.type == MsgType::BATCH){
+                        bp->set_value(parse_batch_responses(rf.req_id, rf.payload,
+                                                            rf.payload_len, rf.version));
+                    }else{
+                        Response r = parse_response_payload(rf.req_id, rf.payload, rf.payload_len,
+                                                            rf.version);
+                        throw std::runtime_error("batch rejected: " + r.err_msg);
+                    }
+                }catch(...){
+                    bp->set_exception(std::current_exception());
+                }
+                continue;
+            }
+
+            // 解析 payload，构造 Response；解析失败只影响这一个调用
+            try{
+                Response rsp = parse_response_payload(rf.req_id, rf.payload, rf.payload_len,
+                                                      rf.version);
+                if (sst){
+                    std::lock_guard<std::mutex> lk(sst->mu);
+                    sst->final = rsp;
+                    sst->done = true;
+                }
+                if (pc) pc->p.set_value(std::move(rsp));
+            }catch(const std::exception& e){
+                if (sst){
+                    std::lock_guard<std::mutex> lk(sst->mu);
+                    sst->error = e.what();
+                    sst->done = true;
+                }
+                if (pc) pc->p.set_exception(std::current_exception());
+            }
+            if (sst) sst->cv.notify_all();
+            if (pc && pc->done) pc->done(std::move(pc->fut));
+        }
+    }catch(const std::exception& e){
+        why = std::string("client reader: ") + e.what();
+    }
+    BufferPool::release(std::move(body));
+    fail_all_pending(why);
+}
+
+// =======================================================
+// on_stream_frame(rf):
+//   - STREAM_DATA  ：服务端流的一块，入队（超过窗口视为服务端违反流控，流以错误结束）
+//   - STREAM_CREDIT：客户端流增加上传额度
+//   - STREAM_END   ：服务端流结束，payload 为结束状态
+//   - 找不到 id（已取消且已结束）直接丢弃
+// =======================================================
+void RpcClient::on_stream_frame(const RawFrameView& rf){
+    std::shared_ptr<ClientStreamState> st;
+    {
+        std::lock_guard<std::mutex> lk(pending_mu_);
+        auto it = streams_.find(rf.req_id);
+        if (it == streams_.end()) return;
+        st = it->second;
+        if (rf.type == MsgType::STREAM_END) streams_.erase(it);
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(st->mu);
+        try{
+            if (rf.type == MsgType::STREAM_END){
+                st->final = parse_response_payload(rf.req_id, rf.payload, rf.payload_len, rf.version);
+                st->done = true;
+            }else{
+                auto [v, used] = decode_value(rf.payload, rf.payload_len, rf.version);
+                if (used != rf.payload_len) throw std::runtime_error("extra bytes in stream frame");
+                if (rf.type == MsgType::STREAM_CREDIT){
+                    if (v.type() != ValueType::INT64 || v.i64() <= 0) throw std::runtime_error("bad stream credit");
+                    st->credit += (uint64_t)v.i64();
+                }else{
+                    if (st->q.size() >= STREAM_WINDOW) throw std::runtime_error("stream window exceeded");
+                    st->q.push_back(std::move(v));
+                }
+            }
+        }catch(const std::exception& e){
+            st->error = std::string("stream: ") + e.what();
+            st->done = true;
+        }
+    }
+    st->cv.notify_all();
+}
+
+// 连接失效：标记关闭，并让所有等待中的 future 抛出 runtime_error(why)，进行中的流以错误结束
+void RpcClient::fail_all_pending(const std::string& why){
+    std::unordered_map<uint32_t, PendingCall> left;
+    std::unordered_map<uint32_t, std::promise<std::vector<Response>>> left_batch;
+    std::unordered_map<uint32_t, std::shared_ptr<ClientStreamState>> left_streams;
+    {
+        std::lock_guard<std::mutex> lk(pending_mu_);
+        closed_ = true;
+        left.swap(pending_);
+        left_batch.swap(pending_batch_);
+        left_streams.swap(streams_);
+        note_outstanding();
+    }
+    for (auto& kv : left_streams){
+        {
+            std::lock_guard<std::mutex> lk(kv.second->mu);
+            if (!kv.second->done){ kv.second->error = why; kv.second->done = true; }
+        }
+        kv.second->cv.notify_all();
+    }
+    for (auto& kv : left){
+        kv.second.p.set_exception(std::make_exception_ptr(std::runtime_error(why)));
+        if (kv.second.done) kv.second.done(std::move(kv.second.fut));
     }
+    for (auto& kv : left_batch)
+        kv.second.set_exception(std::make_exception_ptr(std::runtime_error(why)));
 }
 
 } // namespace rpc
@@ -0,0 +1,13 @@
+#include "rpc/coro.h"
+
+namespace rpc {
+
+// 事件循环线程在 run() 期间登记自己；其它线程为空
+static thread_local const Executor* tls_executor = nullptr;
+
+const Executor* current_executor(){ return tls_executor; }
+
+ExecutorScope::ExecutorScope(const Executor* ex) : prev_(tls_executor) { tls_executor = ex; }
+ExecutorScope::~ExecutorScope(){ tls_executor = prev_; }
+
+} // namespace rpc
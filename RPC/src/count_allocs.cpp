@@ -0,0 +1,41 @@
+#include "rpc/buffer_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+// =====================================================
+// 堆分配计数：替换全局 operator new / delete（目标 tiny_rpc_count_allocs）
+//   operator new 只做一次分片计数 + malloc（带对齐参数的版本用 aligned_alloc）；delete 对应 free
+//   std::pmr 的默认资源走的是带对齐参数的版本，因此也要替换，否则 Value 的内容不计入
+// 单独成一个 OBJECT 库而不放进 tiny_rpc：自己也替换了 operator new 的程序照样能链接 tiny_rpc
+// =====================================================
+
+static void* counted_alloc(size_t n){
+    rpc::count_heap_alloc(n);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+
+static void* counted_aligned_alloc(size_t n, std::align_val_t al){
+    rpc::count_heap_alloc(n);
+    size_t a = std::max(sizeof(void*), (size_t)al);
+    size_t rounded = (std::max<size_t>(n, 1) + a - 1) / a * a;   // aligned_alloc 要求长度是对齐的整数倍
+    if (void* p = std::aligned_alloc(a, rounded)) return p;
+    throw std::bad_alloc();
+}
+
+// 静态初始化时打开 heap_alloc_counting()（链接了本文件即视为开启）
+static const bool g_counting_on = (rpc::set_heap_alloc_counting(true), true);
+
+void* operator new(size_t n){ return counted_alloc(n); }
+void* operator new[](size_t n){ return counted_alloc(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void* operator new(size_t n, std::align_val_t al){ return counted_aligned_alloc(n, al); }
+void* operator new[](size_t n, std::align_val_t al){ return counted_aligned_alloc(n, al); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
@@ -1,4 +1,5 @@
 #include "rpc/frame.h"
+#include "rpc/varint.h"
 #include <cstring>
 #include <stdexcept>
 
@@ -13,124 +14,383 @@ namespace rpc {
 // body 布局（大端/BE）统一如下：
 //   MAGIC(4B) = "RPC1"
 //   VERSION(1B)
-//   TYPE(1B) : 1=Request, 2=Response
+//   TYPE(1B) : 1=Request, 2=Response；最高位 FLAG_METHOD_ID=1 时 METHOD 段为 4B 方法 ID
+//              次高位 FLAG_DEADLINE=1 时带 TIMEOUT_MS
 //   REQ_ID(4B, BE)
 //   METHOD_LEN(4B, BE)   // Response 固定为 0
 //   PAYLOAD_LEN(4B, BE)
+//   [TIMEOUT_MS(4B, BE)] // 仅 FLAG_DEADLINE
 //   METHOD (METHOD_LEN bytes)
 //   PAYLOAD(PAYLOAD_LEN bytes)
 //
+// VERSION=2（紧凑编码）时头部改为：
+//   MAGIC(4B) VERSION(1B) TYPE(1B) REQ_ID(varint) METHOD_LEN(varint) [TIMEOUT_MS(varint)]
+//   METHOD  PAYLOAD(= body 剩余全部字节，省掉 PAYLOAD_LEN)
+//
+// TIMEOUT_MS 是发送时刻的剩余预算（相对值），接收方按到达时刻换算成本地截止时间
+//
 // 其中：
-//  - Request 的 payload 来自 Request::encode_payload()
-//  - Response 的 payload 来自 Response::encode_payload()
+//  - Request 的 payload 由 Request::encode_payload_to() 直接写入帧内
+//  - Response 的 payload 由 Response::encode_payload_to() 直接写入帧内
 //  - parse_body_to_frame() 只负责把 body 解析成 RawFrame；
 //    更高层的 parse_*_payload() 再把 payload 还原为具体对象。
+//
+// TYPE=4（BATCH）时 payload 里是 N 个请求/响应，布局见 frame.h。
+// TYPE=5/6/7（流式）复用同一帧头，payload 见 frame.h。
 // ============================================================
 
 static const uint8_t MAGIC[4] = {'R','P','C','1'};
+static constexpr uint8_t FLAG_METHOD_ID = 0x80;
+static constexpr uint8_t FLAG_DEADLINE  = 0x40;
+static constexpr uint8_t TYPE_FLAGS     = FLAG_METHOD_ID | FLAG_DEADLINE;
+
+// 固定头长度：MAGIC(4)+VERSION(1)+TYPE(1)+REQ_ID(4)+METHOD_LEN(4)+PAYLOAD_LEN(4)
+static constexpr size_t HEADER_LEN = 4+1+1+4+4+4;
 
-// 写入/读取 32 位大端整数
-static void put_u32_be(std::vector<uint8_t>& out, uint32_t v){
-    out.push_back((v>>24)&0xFF); out.push_back((v>>16)&0xFF);
-    out.push_back((v>>8)&0xFF);  out.push_back((v    )&0xFF);
+// 写入/读取 32 位大端整数（写入到裸指针，返回写入后的位置）
+static uint8_t* put_u32_be(uint8_t* p, uint32_t v){
+    p[0]=(v>>24)&0xFF; p[1]=(v>>16)&0xFF; p[2]=(v>>8)&0xFF; p[3]=v&0xFF;
+    return p+4;
 }
 static uint32_t get_u32_be(const uint8_t* p){
     return (uint32_t(p[0])<<24)|(uint32_t(p[1])<<16)|(uint32_t(p[2])<<8)|uint32_t(p[3]);
 }
 
+// 长度字段：v1 为 4B 大端，v2 为 varint
+static size_t len_size(size_t len, uint8_t ver){
+    return ver == VERSION_V2 ? varint_size(len) : 4;
+}
+static uint8_t* put_len(uint8_t* p, size_t len, uint8_t ver){
+    return ver == VERSION_V2 ? put_varint(p, len) : put_u32_be(p, (uint32_t)len);
+}
+// 读长度到 out，返回消费字节数；字节不足 → throw
+static size_t get_len(const uint8_t* p, size_t n, uint8_t ver, uint64_t& out){
+    if (ver == VERSION_V2) return get_varint(p, n, out);
+    if (n < 4) throw std::runtime_error("bad batch");
+    out = get_u32_be(p);
+    return 4;
+}
+
+// 在 out 末尾一次性扩出整帧空间，写好 [4B body_len] + 头 + METHOD，
+// 返回 PAYLOAD 的起始位置（调用方接着写 payload_len 字节）
+// timeout_ms != NO_TIMEOUT 时置 FLAG_DEADLINE 并写入 TIMEOUT_MS
+static uint8_t* begin_frame(std::vector<uint8_t>& out, uint8_t type, uint32_t req_id,
+                            std::string_view method, size_t payload_len, uint8_t ver,
+                            uint32_t timeout_ms = NO_TIMEOUT){
+    bool v2 = ver == VERSION_V2;
+    bool has_timeout = timeout_ms != NO_TIMEOUT;
+    if (has_timeout) type |= FLAG_DEADLINE;
+    size_t head_len = v2 ? 4+1+1 + varint_size(req_id) + varint_size(method.size())
+                         : HEADER_LEN;
+    if (has_timeout) head_len += v2 ? varint_size(timeout_ms) : 4;
+    size_t body_len = head_len + method.size() + payload_len;
+    if (body_len > 0xFFFFFFFFu) throw std::runtime_error("frame too large");
+
+    size_t base = out.size();
+    out.resize(base + 4 + body_len);
+    uint8_t* p = out.data() + base;
+    p = put_u32_be(p, (uint32_t)body_len);            // 前置长度（不含自身 4 字节）
+    std::memcpy(p, MAGIC, 4); p += 4;                  // MAGIC
+    *p++ = v2 ? VERSION_V2 : VERSION;                  // VERSION
+    *p++ = type;                                       // TYPE（含 FLAG_METHOD_ID）
+    if (v2){
+        p = put_varint(p, req_id);                     // REQ_ID
+        p = put_varint(p, method.size());              // METHOD_LEN
+        if (has_timeout) p = put_varint(p, timeout_ms); // TIMEOUT_MS
+    } else {
+        p = put_u32_be(p, req_id);                     // REQ_ID
+        p = put_u32_be(p, (uint32_t)method.size());    // METHOD_LEN
+        p = put_u32_be(p, (uint32_t)payload_len);      // PAYLOAD_LEN
+        if (has_timeout) p = put_u32_be(p, timeout_ms); // TIMEOUT_MS
+    }
+    if (!method.empty()) std::memcpy(p, method.data(), method.size()); // METHOD
+    return p + method.size();
+}
+
+// 截止时间 → 帧头里的剩余毫秒数（向上取整；已过期写 0）
+static uint32_t timeout_from_deadline(Deadline d){
+    if (!has_deadline(d)) return NO_TIMEOUT;
+    auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+        d - std::chrono::steady_clock::now()).count();
+    if (left <= 0) return 0;
+    uint64_t ms = ((uint64_t)left + 999) / 1000;
+    return ms >= NO_TIMEOUT ? NO_TIMEOUT - 1 : (uint32_t)ms;
+}
+
 // ======================= Request → Frame =======================
 // 输入：高层 Request（含 req_id、method、args）
-// 输出：out = 一整帧字节（含 4B 前置 body_len）
-// 失败：抛出 std::runtime_error（一般不会，除非 encode_payload 内部抛）
+// 输出：out 末尾追加一整帧字节（含 4B 前置 body_len）
+// 做法：先用 payload_size() 算出总长，out 只扩容一次，
+//       头、method、各个 Value 直接写进最终位置，没有中间 vector。
+//       out 可以跨帧复用（clear 后容量保留），稳态下不再分配。
+// 失败：抛出 std::runtime_error（未知 ValueType、帧超过 4GB）
 // ==============================================================
-void build_request_frame(const Request& req, std::vector<uint8_t>& out){
-    // 1) 让请求对象生成 payload（如：参数序列化后的二进制）
-    std::vector<uint8_t> payload = req.encode_payload();
-
-    // 2) 组装 body
-    std::vector<uint8_t> body;
-    body.insert(body.end(), MAGIC, MAGIC+4);          // MAGIC
-    body.push_back(VERSION);                          // VERSION
-    body.push_back((uint8_t)MsgType::REQUEST);        // TYPE
-    put_u32_be(body, req.req_id);                     // REQ_ID
-    put_u32_be(body, (uint32_t)req.method.size());    // METHOD_LEN
-    put_u32_be(body, (uint32_t)payload.size());       // PAYLOAD_LEN
-    body.insert(body.end(), req.method.begin(), req.method.end());   // METHOD
-    body.insert(body.end(), payload.begin(), payload.end());         // PAYLOAD
-
-    // 3) 前置长度（不含自身 4 字节）
+void append_request_frame(const Request& req, std::vector<uint8_t>& out, uint8_t ver){
+    append_request_frame(req.req_id, req.method, req.method_id, req.args, req.deadline, out, ver);
+}
+
+// 按字段编码：客户端发请求时不必先复制出一个 Request（args 的拷贝是一次堆分配）
+void append_request_frame(uint32_t req_id, std::string_view method, uint32_t method_id,
+                          const std::vector<Value>& args, Deadline deadline,
+                          std::vector<uint8_t>& out, uint8_t ver){
+    uint8_t* p = begin_request_frame(out, req_id, method, method_id,
+                                     args_payload_size(args, ver), deadline, ver);
+    encode_args_to(p, args, ver);
+}
+
+uint8_t* begin_request_frame(std::vector<uint8_t>& out, uint32_t req_id, std::string_view method,
+                             uint32_t method_id, size_t payload_len, Deadline deadline, uint8_t ver){
+    uint8_t type = (uint8_t)MsgType::REQUEST;
+    uint8_t id4[4];
+    if (method_id){                                    // 按 ID 发送：METHOD 段换成 4B ID
+        put_u32_be(id4, method_id);
+        type |= FLAG_METHOD_ID;
+        method = std::string_view((const char*)id4, 4);
+    }
+    return begin_frame(out, type, req_id, method, payload_len, ver, timeout_from_deadline(deadline));
+}
+
+void build_request_frame(const Request& req, std::vector<uint8_t>& out, uint8_t ver){
     out.clear();
-    put_u32_be(out, (uint32_t)body.size());
-    out.insert(out.end(), body.begin(), body.end());
+    append_request_frame(req, out, ver);
 }
 
 // ======================= Response → Frame =======================
 // 与上面类似，但 METHOD_LEN 固定写 0（响应没有方法名段）
 // ==============================================================
-void build_response_frame(const Response& rsp, std::vector<uint8_t>& out){
-    std::vector<uint8_t> payload = rsp.encode_payload();
-
-    std::vector<uint8_t> body;
-    body.insert(body.end(), MAGIC, MAGIC+4);
-    body.push_back(VERSION);
-    body.push_back((uint8_t)MsgType::RESPONSE);
-    put_u32_be(body, rsp.req_id);
-    put_u32_be(body, 0);                               // METHOD_LEN = 0
-    put_u32_be(body, (uint32_t)payload.size());        // PAYLOAD_LEN
-    body.insert(body.end(), payload.begin(), payload.end());
+void append_response_frame(const Response& rsp, std::vector<uint8_t>& out, uint8_t ver){
+    size_t payload_len = rsp.payload_size(ver);
+    uint8_t* p = begin_frame(out, (uint8_t)MsgType::RESPONSE, rsp.req_id, {}, payload_len, ver);
+    rsp.encode_payload_to(p, ver);
+}
+
+// 响应缓存命中时用：payload 原样复制，只重写帧头里的 req_id
+void append_encoded_response_frame(uint32_t req_id, const uint8_t* payload, size_t payload_len,
+                                   std::vector<uint8_t>& out, uint8_t ver){
+    uint8_t* p = begin_frame(out, (uint8_t)MsgType::RESPONSE, req_id, {}, payload_len, ver);
+    if (payload_len) std::memcpy(p, payload, payload_len);
+}
+
+void build_response_frame(const Response& rsp, std::vector<uint8_t>& out, uint8_t ver){
+    out.clear();
+    append_response_frame(rsp, out, ver);
+}
+
+// ======================= Batch → Frame =======================
+// 同样单趟：先累计各项长度，一次扩容，再逐项写入
+// 每项请求的 method_id 非 0 时写 METHOD_LEN=0 + 4B ID
+// ==============================================================
+void append_batch_request_frame(uint32_t batch_id, const std::vector<Request>& reqs,
+                                std::vector<uint8_t>& out, uint8_t ver){
+    thread_local std::vector<size_t> sizes;   // 各项 payload 长度，避免算两遍
+    sizes.clear();
+    size_t payload_len = len_size(reqs.size(), ver);
+    for (auto& r : reqs){
+        size_t pl = r.payload_size(ver);
+        sizes.push_back(pl);
+        size_t m = r.method_id ? 4 : r.method.size();
+        payload_len += len_size(r.method_id ? 0 : m, ver) + m + len_size(pl, ver) + pl;
+    }
+    uint8_t* p = begin_frame(out, (uint8_t)MsgType::BATCH, batch_id, {}, payload_len, ver);
+    p = put_len(p, reqs.size(), ver);
+    for (size_t i = 0; i < reqs.size(); ++i){
+        const Request& r = reqs[i];
+        if (r.method_id){
+            p = put_len(p, 0, ver);
+            p = put_u32_be(p, r.method_id);
+        }else{
+            if (r.method.empty()) throw std::runtime_error("batch item without method");
+            p = put_len(p, r.method.size(), ver);
+            std::memcpy(p, r.method.data(), r.method.size()); p += r.method.size();
+        }
+        p = put_len(p, sizes[i], ver);
+        p = r.encode_payload_to(p, ver);
+    }
+}
+
+void append_batch_response_frame(uint32_t batch_id, const std::vector<Response>& rsps,
+                                 std::vector<uint8_t>& out, uint8_t ver){
+    thread_local std::vector<size_t> sizes;
+    sizes.clear();
+    size_t payload_len = len_size(rsps.size(), ver);
+    for (auto& r : rsps){
+        size_t pl = r.payload_size(ver);
+        sizes.push_back(pl);
+        payload_len += len_size(pl, ver) + pl;
+    }
+    uint8_t* p = begin_frame(out, (uint8_t)MsgType::BATCH, batch_id, {}, payload_len, ver);
+    p = put_len(p, rsps.size(), ver);
+    for (size_t i = 0; i < rsps.size(); ++i){
+        p = put_len(p, sizes[i], ver);
+        p = rsps[i].encode_payload_to(p, ver);
+    }
+}
 
+// ======================= 流式帧 =======================
+// 都是“帧头 + 单个 Value / Response”的单趟编码，METHOD 段为空
+// ==============================================================
+void append_stream_data_frame(uint32_t req_id, const Value& chunk, std::vector<uint8_t>& out,
+                              uint8_t ver){
+    uint8_t* p = begin_frame(out, (uint8_t)MsgType::STREAM_DATA, req_id, {},
+                             encoded_size(chunk, ver), ver);
+    encode_value_to(p, chunk, ver);
+}
+
+void append_stream_credit_frame(uint32_t req_id, uint32_t n, std::vector<uint8_t>& out,
+                                uint8_t ver){
+    Value v = Value::make_int(n);
+    uint8_t* p = begin_frame(out, (uint8_t)MsgType::STREAM_CREDIT, req_id, {},
+                             encoded_size(v, ver), ver);
+    encode_value_to(p, v, ver);
+}
+
+void append_stream_end_frame(const Response& rsp, std::vector<uint8_t>& out, uint8_t ver){
+    uint8_t* p = begin_frame(out, (uint8_t)MsgType::STREAM_END, rsp.req_id, {},
+                             rsp.payload_size(ver), ver);
+    rsp.encode_payload_to(p, ver);
+}
+
+void append_stream_end_frame(uint32_t req_id, std::vector<uint8_t>& out, uint8_t ver){
+    begin_frame(out, (uint8_t)MsgType::STREAM_END, req_id, {}, 0, ver);
+}
+
+// ======================= 解析批量 payload =======================
+// 只切分位置，不拷贝；每项长度都对照剩余字节检查
+// COUNT 先与剩余字节数比较，防止恶意的大 COUNT 触发巨量 reserve
+// ==============================================================
+void parse_batch_requests(const uint8_t* pl, size_t n, uint8_t ver, std::vector<BatchItemView>& out){
     out.clear();
-    put_u32_be(out, (uint32_t)body.size());
-    out.insert(out.end(), body.begin(), body.end());
+    const uint8_t* p = pl;
+    const uint8_t* end = pl + n;
+    uint64_t count;
+    p += get_len(p, n, ver, count);
+    if (count > (uint64_t)(end - p) / 2) throw std::runtime_error("bad batch count");
+    out.reserve((size_t)count);
+    for (uint64_t i = 0; i < count; ++i){
+        BatchItemView it{};
+        uint64_t mlen, plen;
+        p += get_len(p, (size_t)(end - p), ver, mlen);
+        if (mlen == 0){
+            if (end - p < 4) throw std::runtime_error("bad batch");
+            it.method_id = get_u32_be(p); p += 4;
+        }else{
+            if (mlen > (uint64_t)(end - p)) throw std::runtime_error("bad batch");
+            it.method = std::string_view((const char*)p, (size_t)mlen); p += mlen;
+        }
+        p += get_len(p, (size_t)(end - p), ver, plen);
+        if (plen > (uint64_t)(end - p)) throw std::runtime_error("bad batch");
+        it.payload = p; it.payload_len = (size_t)plen; p += plen;
+        out.push_back(it);
+    }
+    if (p != end) throw std::runtime_error("extra bytes in batch");
+}
+
+std::vector<Response> parse_batch_responses(uint32_t batch_id, const uint8_t* pl, size_t n,
+                                            uint8_t ver){
+    const uint8_t* p = pl;
+    const uint8_t* end = pl + n;
+    uint64_t count;
+    p += get_len(p, n, ver, count);
+    if (count > (uint64_t)(end - p)) throw std::runtime_error("bad batch count");
+    std::vector<Response> out;
+    out.reserve((size_t)count);
+    for (uint64_t i = 0; i < count; ++i){
+        uint64_t plen;
+        p += get_len(p, (size_t)(end - p), ver, plen);
+        if (plen > (uint64_t)(end - p)) throw std::runtime_error("bad batch");
+        out.push_back(parse_response_payload(batch_id, p, (size_t)plen, ver));
+        p += plen;
+    }
+    if (p != end) throw std::runtime_error("extra bytes in batch");
+    return out;
 }
 
 // ======================= 解析 body → RawFrame =======================
-// 输入：完整的 body（注意：不包含最前面的 4B body_len）
+// 输入：完整的 body（注意：不包含最前面的 4B body_len），vector 或 指针+长度
 // 输出：RawFrame {type, req_id, method, payload}
 // 失败：抛出 std::runtime_error（magic/version/长度不合法等）
 // ==============================================================
 RawFrame parse_body_to_frame(const std::vector<uint8_t>& body){
-    // 基本长度判断：至少包含头部字段
-    // 4(MAGIC)+1(VERSION)+1(TYPE)+4(REQ_ID)+4(METHOD_LEN)+4(PAYLOAD_LEN) = 18 字节
-    if (body.size() < 4+1+1+4+4+4)
+    return parse_body_to_frame(body.data(), body.size());
+}
+
+RawFrame parse_body_to_frame(const uint8_t* body, size_t n){
+    RawFrameView v = parse_body_to_view(body, n);
+    return RawFrame{v.type, v.req_id, std::string(v.method),
+                    std::vector<uint8_t>(v.payload, v.payload + v.payload_len), v.version,
+                    v.method_id, v.timeout_ms};
+}
+
+// ======================= 解析 body → RawFrameView =======================
+// 与 parse_body_to_frame 相同的校验，但 method/payload 只记录位置，不拷贝
+// ==============================================================
+RawFrameView parse_body_to_view(const uint8_t* body, size_t n){
+    // 基本长度判断：至少包含 MAGIC(4)+VERSION(1)+TYPE(1)
+    if (n < 4+1+1)
         throw std::runtime_error("bad frame len");
 
     // MAGIC
-    if (std::memcmp(body.data(), MAGIC, 4) != 0)
+    if (std::memcmp(body, MAGIC, 4) != 0)
         throw std::runtime_error("bad magic");
 
-    // VERSION
-    if (body[4] != VERSION)
+    // VERSION：v1/v2 都可读
+    uint8_t ver = body[4];
+    if (ver != VERSION && ver != VERSION_V2)
         throw std::runtime_error("bad version");
 
-    // TYPE
-    auto type = (MsgType)body[5];
+    // TYPE（剥离 FLAG_METHOD_ID / FLAG_DEADLINE）
+    bool by_id = (body[5] & FLAG_METHOD_ID) != 0;
+    bool has_timeout = (body[5] & FLAG_DEADLINE) != 0;
+    auto type = (MsgType)(body[5] & ~TYPE_FLAGS);
 
     // 解析主头字段
-    const uint8_t* p = body.data() + 6;
-    uint32_t req_id      = get_u32_be(p); p += 4;
-    uint32_t method_len  = get_u32_be(p); p += 4;
-    uint32_t payload_len = get_u32_be(p); p += 4;
+    const uint8_t* p = body + 6;
+    const uint8_t* end = body + n;
+    uint32_t req_id;
+    uint32_t timeout_ms = NO_TIMEOUT;
+    uint64_t method_len, payload_len;
+    if (ver == VERSION_V2){
+        uint64_t id;
+        p += get_varint(p, (size_t)(end - p), id);
+        if (id > 0xFFFFFFFFu) throw std::runtime_error("bad req_id");
+        req_id = (uint32_t)id;
+        p += get_varint(p, (size_t)(end - p), method_len);
+        if (has_timeout){
+            uint64_t t;
+            p += get_varint(p, (size_t)(end - p), t);
+            if (t >= NO_TIMEOUT) throw std::runtime_error("bad timeout");
+            timeout_ms = (uint32_t)t;
+        }
+        if (method_len > (uint64_t)(end - p)) throw std::runtime_error("bad sizes");
+        payload_len = (uint64_t)(end - p) - method_len;       // 剩余即 payload
+    } else {
+        // 4(MAGIC)+1(VERSION)+1(TYPE)+4(REQ_ID)+4(METHOD_LEN)+4(PAYLOAD_LEN) = 18 字节
+        if (n < HEADER_LEN) throw std::runtime_error("bad frame len");
+        req_id      = get_u32_be(p); p += 4;
+        method_len  = get_u32_be(p); p += 4;
+        payload_len = get_u32_be(p); p += 4;
+        if (has_timeout){
+            if (n < HEADER_LEN + 4) throw std::runtime_error("bad frame len");
+            timeout_ms = get_u32_be(p); p += 4;
+            if (timeout_ms == NO_TIMEOUT) throw std::runtime_error("bad timeout");
+        }
+    }
 
-    // 边界一致性检查：头 + method + payload 应该正好等于 body.size()
-    if ((size_t)(p - body.data()) + method_len + payload_len != body.size())
+    // 边界一致性检查：头 + method + payload 应该正好等于 n
+    if ((size_t)(p - body) + method_len + payload_len != n)
         throw std::runtime_error("bad sizes");
 
-    // 读取 METHOD（Response 的 method_len=0，则跳过）
-    std::string method;
-    if (method_len){
-        method.assign((const char*)p, method_len);
-        p += method_len;
-    }
-
-    // 读取 PAYLOAD
-    std::vector<uint8_t> payload;
-    if (payload_len){
-        payload.assign(p, p+payload_len);
-        p += payload_len;
+    // METHOD（Response 的 method_len=0，则为空视图）与 PAYLOAD 紧随其后
+    std::string_view method((const char*)p, (size_t)method_len);
+    uint32_t method_id = 0;
+    if (by_id){
+        if (method_len != 4) throw std::runtime_error("bad method id");
+        method_id = get_u32_be(p);
+        method = {};
     }
+    p += method_len;
 
-    return RawFrame{type, req_id, std::move(method), std::move(payload)};
+    return RawFrameView{type, req_id, method, p, (size_t)payload_len, ver, method_id, timeout_ms};
 }
 
 } // namespace rpc
@@ -0,0 +1,55 @@
+#include "rpc/histogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace rpc {
+
+// =====================================================
+// LatencyHistogram
+// 桶布局（SUB_COUNT = 2^SUB_BITS）：
+//   [0, SUB_COUNT)            ：值 0..SUB_COUNT-1，每个值一个桶（精确）
+//   之后每 SUB_COUNT 个桶一组 ：第 k 组（k>=1）覆盖 [2^(SUB_BITS+k-1), 2^(SUB_BITS+k))，
+//                               组内等分，桶宽 2^(k-1)
+// =====================================================
+
+LatencyHistogram::LatencyHistogram() : counts_(BUCKETS, 0) {}
+
+void LatencyHistogram::merge(const LatencyHistogram& o){
+    for (size_t i = 0; i < BUCKETS; ++i) counts_[i] += o.counts_[i];
+    total_ += o.total_;
+    sum_   += o.sum_;
+    min_ = std::min(min_, o.min_);
+    max_ = std::max(max_, o.max_);
+}
+
+void LatencyHistogram::reset(){
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_ = 0;
+    sum_   = 0;
+    min_   = UINT64_MAX;
+    max_   = 0;
+}
+
+// 桶 i 能表示的最大值
+uint64_t LatencyHistogram::upper_of(size_t i){
+    if (i < SUB_COUNT) return i;
+    int shift = (int)(i / SUB_COUNT) - 1;
+    uint64_t sub = i % SUB_COUNT + SUB_COUNT;
+    return ((sub + 1) << shift) - 1;
+}
+
+// 从小到大累加到第 ceil(p% * total) 个样本所在的桶；结果不超过实际最大值
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (!total_) return 0;
+    p = std::min(std::max(p, 0.0), 100.0);
+    uint64_t rank = (uint64_t)std::ceil(p / 100.0 * (double)total_);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i){
+        seen += counts_[i];
+        if (seen >= rank) return std::min(upper_of(i), max_);
+    }
+    return max_;
+}
+
+} // namespace rpc
@@ -0,0 +1,243 @@
+#include "rpc/metrics.h"
+#include "rpc/buffer_pool.h"
+#include "rpc/protocol.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace rpc {
+
+// =====================================================
+// ServerMetrics: 按线程分片的方法统计
+// 写：local() 找到本线程的分片（构造时按 CPU 数建好固定个数，线程首次写入时领一个号，
+//     按号轮流落到分片上），锁分片后更新对应槽位的 Cell
+// 读：snapshot() 逐个分片加锁合并，再按方法名合并
+// 分片数固定：一连接一线程模式下短连接线程再多，内存与合并开销也不增长
+// =====================================================
+
+static std::atomic<uint32_t> g_next_thread_ticket{0};
+
+static size_t shard_count(){
+    size_t n = (size_t)std::thread::hardware_concurrency() * 2;
+    return std::min<size_t>(std::max<size_t>(n, 4), 64);
+}
+
+ServerMetrics::ServerMetrics() : start_(clock::now()) {
+    size_t n = shard_count();
+    for (size_t i = 0; i < n; ++i) shards_.push_back(std::make_unique<Shard>());
+}
+
+ServerMetrics::~ServerMetrics() = default;
+
+uint32_t ServerMetrics::add_method(const std::string& name){
+    std::lock_guard<std::mutex> lk(mu_);
+    names_.push_back(name);
+    return (uint32_t)(names_.size() - 1);
+}
+
+// 本线程的分片：线程号对分片数取模（同时存活的线程依次错开，多于分片数时共用）
+ServerMetrics::Shard& ServerMetrics::local(){
+    thread_local uint32_t ticket = g_next_thread_ticket.fetch_add(1, std::memory_order_relaxed);
+    return *shards_[ticket % shards_.size()];
+}
+
+ServerMetrics::Cell& ServerMetrics::cell(Shard& s, uint32_t slot){
+    if (slot >= s.cells.size()) s.cells.resize(slot + 1);
+    if (!s.cells[slot]) s.cells[slot] = std::make_unique<Cell>();
+    return *s.cells[slot];
+}
+
+void ServerMetrics::on_start(uint32_t slot){
+    Shard& s = local();
+    std::lock_guard<std::mutex> lk(s.mu);
+    ++cell(s, slot).started;
+}
+
+void ServerMetrics::on_finish(uint32_t slot, uint16_t status, clock::time_point received){
+    auto now = clock::now();
+    Shard& s = local();
+    std::lock_guard<std::mutex> lk(s.mu);
+    Cell& c = cell(s, slot);
+    ++c.completed;
+    if (status == 3){ ++c.rejected; return; }
+    if (status == STATUS_DEADLINE_EXCEEDED){ ++c.expired; return; }
+    if (status != 0) ++c.errors;
+    c.latency.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - received).count());
+}
+
+void ServerMetrics::on_cached(uint32_t slot, clock::time_point received){
+    auto now = clock::now();
+    Shard& s = local();
+    std::lock_guard<std::mutex> lk(s.mu);
+    Cell& c = cell(s, slot);
+    ++c.completed;
+    ++c.cached;
+    c.latency.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - received).count());
+}
+
+void ServerMetrics::on_unknown(){
+    Shard& s = local();
+    std::lock_guard<std::mutex> lk(s.mu);
+    ++s.unknown;
+}
+
+StatsSnapshot ServerMetrics::snapshot() const {
+    StatsSnapshot snap;
+    snap.uptime_ms = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        clock::now() - start_).count();
+    snap.connections = io.connections.load(std::memory_order_relaxed);
+    snap.accepted    = io.accepted.load(std::memory_order_relaxed);
+    snap.bytes_in    = io.bytes_in.load(std::memory_order_relaxed);
+    snap.bytes_out   = io.bytes_out.load(std::memory_order_relaxed);
+    snap.syscalls    = io.syscalls.load(std::memory_order_relaxed);
+    BufferPool::Stats pool = BufferPool::stats();
+    snap.heap_allocs = heap_allocs().allocs;
+    snap.pool_hits   = pool.hits;
+    snap.pool_misses = pool.misses;
+
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        names = names_;
+    }
+
+    // 同名方法（重复注册）合并到同一项
+    std::unordered_map<std::string, size_t> index;
+    std::vector<size_t> slot_to_item(names.size());
+    for (size_t i = 0; i < names.size(); ++i){
+        auto it = index.find(names[i]);
+        if (it == index.end()){
+            it = index.emplace(names[i], snap.methods.size()).first;
+            snap.methods.emplace_back();
+            snap.methods.back().name = names[i];
+        }
+        slot_to_item[i] = it->second;
+    }
+
+    for (auto& s : shards_){
+        std::lock_guard<std::mutex> lk(s->mu);
+        snap.unknown += s->unknown;
+        for (size_t i = 0; i < s->cells.size() && i < names.size(); ++i){
+            if (!s->cells[i]) continue;
+            const Cell& c = *s->cells[i];
+            MethodStats& m = snap.methods[slot_to_item[i]];
+            m.started   += c.started;
+            m.completed += c.completed;
+            m.errors    += c.errors;
+            m.rejected  += c.rejected;
+            m.expired   += c.expired;
+            m.cached    += c.cached;
+            m.latency.merge(c.latency);
+        }
+    }
+    std::stable_sort(snap.methods.begin(), snap.methods.end(),
+                     [](const MethodStats& a, const MethodStats& b){ return a.completed > b.completed; });
+    return snap;
+}
+
+uint64_t StatsSnapshot::inflight() const {
+    uint64_t n = 0;
+    for (auto& m : methods) n += m.inflight();
+    return n;
+}
+
+static double to_us(uint64_t ns){ return (double)ns / 1000.0; }
+
+// =====================================================
+// to_value(): __stats 的返回值
+//   { uptime_ms, connections, accepted, bytes_in, bytes_out, syscalls, heap_allocs, pool_hits,
+//     pool_misses, inflight, queue_depth, unknown,
+//     methods: { name: { calls, errors, rejected, expired, cached, inflight,
+//                        mean_us, p50_us, p99_us, p999_us, max_us } } }
+//   calls = completed；methods 按 calls 降序
+// =====================================================
+Value StatsSnapshot::to_value() const {
+    Value::Map per_method;
+    for (auto& m : methods){
+        per_method.emplace_back(m.name, Value::make_map({
+            { "calls",    Value::make_int((int64_t)m.completed) },
+            { "errors",   Value::make_int((int64_t)m.errors) },
+            { "rejected", Value::make_int((int64_t)m.rejected) },
+            { "expired",  Value::make_int((int64_t)m.expired) },
+            { "cached",   Value::make_int((int64_t)m.cached) },
+            { "inflight", Value::make_int((int64_t)m.inflight()) },
+            { "mean_us",  Value::make_double(m.latency.mean() / 1000.0) },
+            { "p50_us",   Value::make_double(to_us(m.latency.percentile(50))) },
+            { "p99_us",   Value::make_double(to_us(m.latency.percentile(99))) },
+            { "p999_us",  Value::make_double(to_us(m.latency.percentile(99.9))) },
+            { "max_us",   Value::make_double(to_us(m.latency.max())) },
+        }));
+    }
+    return Value::make_map({
+        { "uptime_ms",   Value::make_int((int64_t)uptime_ms) },
+        { "connections", Value::make_int(connections) },
+        { "accepted",    Value::make_int((int64_t)accepted) },
+        { "bytes_in",    Value::make_int((int64_t)bytes_in) },
+        { "bytes_out",   Value::make_int((int64_t)bytes_out) },
+        { "syscalls",    Value::make_int((int64_t)syscalls) },
+        { "heap_allocs", Value::make_int((int64_t)heap_allocs) },
+        { "pool_hits",   Value::make_int((int64_t)pool_hits) },
+        { "pool_misses", Value::make_int((int64_t)pool_misses) },
+        { "inflight",    Value::make_int((int64_t)inflight()) },
+        { "queue_depth", Value::make_int((int64_t)queue_depth) },
+        { "unknown",     Value::make_int((int64_t)unknown) },
+        { "methods",     Value::make_map(std::move(per_method)) },
+    });
+}
+
+// 字节数 → 人类可读（B/KB/MB/GB）
+static std::string human_bytes(uint64_t b){
+    static const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+    double v = (double)b;
+    int u = 0;
+    while (v >= 1024 && u < 4){ v /= 1024; ++u; }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), u ? "%.1f%s" : "%.0f%s", v, units[u]);
+    return buf;
+}
+
+std::string StatsSnapshot::to_text(const StatsSnapshot* prev) const {
+    std::ostringstream os;
+    char buf[320];
+    std::snprintf(buf, sizeof(buf), "[stats] up=%.1fs conns=%lld accepted=%llu inflight=%llu queue=%llu",
+                  (double)uptime_ms / 1000.0, (long long)connections, (unsigned long long)accepted,
+                  (unsigned long long)inflight(), (unsigned long long)queue_depth);
+    os << buf << " in=" << human_bytes(bytes_in) << " out=" << human_bytes(bytes_out)
+       << " syscalls=" << syscalls << " unknown=" << unknown;
+    // 两次快照之间每个完成的调用摊到的堆分配次数（稳态下应接近 0）
+    uint64_t calls = 0, prev_calls = 0;
+    for (auto& m : methods) calls += m.completed;
+    if (prev) for (auto& m : prev->methods) prev_calls += m.completed;
+    os << " allocs=" << heap_allocs;
+    if (prev && calls > prev_calls && heap_allocs >= prev->heap_allocs){
+        std::snprintf(buf, sizeof(buf), " (%.2f/call)",
+                      (double)(heap_allocs - prev->heap_allocs) / (double)(calls - prev_calls));
+        os << buf;
+    }
+    os << " pool=" << pool_hits << "/" << (pool_hits + pool_misses) << "\n";
+
+    double secs = prev && uptime_ms > prev->uptime_ms ? (double)(uptime_ms - prev->uptime_ms) / 1000.0 : 0;
+    for (auto& m : methods){
+        double rate = 0;
+        if (secs > 0){
+            uint64_t before = 0;
+            for (auto& p : prev->methods) if (p.name == m.name){ before = p.completed; break; }
+            rate = (double)(m.completed - std::min(before, m.completed)) / secs;
+        }
+        std::snprintf(buf, sizeof(buf),
+                      "[stats]   %-16s calls=%llu (%.0f/s) err=%llu busy=%llu expired=%llu cached=%llu inflight=%llu"
+                      " p50=%.0fus p99=%.0fus p999=%.0fus max=%.0fus",
+                      m.name.c_str(), (unsigned long long)m.completed, rate,
+                      (unsigned long long)m.errors, (unsigned long long)m.rejected,
+                      (unsigned long long)m.expired, (unsigned long long)m.cached,
+                      (unsigned long long)m.inflight(),
+                      to_us(m.latency.percentile(50)), to_us(m.latency.percentile(99)),
+                      to_us(m.latency.percentile(99.9)), to_us(m.latency.max()));
+        os << buf << "\n";
+    }
+    return os.str();
+}
+
+} // namespace rpc
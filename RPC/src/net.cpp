@@ -4,6 +4,17 @@
 #include <iostream>
 #include <cstdlib>
 #include <limits>
+#include <stdexcept>
+#ifndef _WIN32
+  #include <netdb.h>
+  #include <netinet/tcp.h>
+  #include <poll.h>
+  #include <sys/un.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+  #define MSG_NOSIGNAL 0   // Windows 没有 SIGPIPE
+#endif
 
 namespace rpc {
 
@@ -23,38 +34,66 @@ namespace rpc {
 }
 
 // =====================================================
-// tcp_listen(port):
-//   - 在给定端口上创建 TCP 监听 socket
+// tcp_listen(host, port, reuse_port):
+//   - 在 host:port 上创建 TCP 监听 socket；host 经 getaddrinfo 解析（IPv4/IPv6 字面量或主机名，
+//     取第一个结果），空串或 0.0.0.0 = 所有 IPv4 网卡
 //   - 设置 SO_REUSEADDR 以支持端口快速复用
-//   - bind 到 0.0.0.0:port
+//   - reuse_port 时设置 SO_REUSEPORT（须在 bind 前）：同一端口上的每个监听 socket 各有一条
+//     accept 队列，新连接按四元组哈希分配；平台不支持则 die()
+//   - 设置 TCP_NODELAY：accept 出来的连接继承该选项，各服务模式都不必逐个再设
 //   - listen 队列大小 128
 //
-// 输入:  port 要监听的端口号
+// 输入:  host 监听地址，port 要监听的端口号
 // 输出:  成功返回 socket_t（Linux=int，Windows=SOCKET）
-// 错误:  调用 die() 直接退出
+// 错误:  地址解析失败打印原因后退出；其它调用 die() 直接退出
 // =====================================================
-socket_t tcp_listen(uint16_t port){
+socket_t tcp_listen(const std::string& host, uint16_t port, bool reuse_port){
     if (!net_init()) die("WSAStartup");
 
-    socket_t s = ::socket(AF_INET, SOCK_STREAM, 0);
+    addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE;
+    addrinfo* res = nullptr;
+    std::string service = std::to_string(port);
+    std::string node = host.empty() ? "0.0.0.0" : host;
+    if (node.size() > 2 && node.front() == '[' && node.back() == ']') node = node.substr(1, node.size() - 2);   // [::1]
+    int rc = ::getaddrinfo(node.c_str(), service.c_str(), &hints, &res);
+    if (rc != 0 || !res){
+        std::cerr << "listen address " << host << ": " << ::gai_strerror(rc) << "\n";
+        std::exit(1);
+    }
+
+    socket_t s = ::socket(res->ai_family, SOCK_STREAM, 0);
     if (s == INVALID_SOCKET_T) die("socket");
 
     int yes = 1;
     if (::setsockopt(s, SOL_SOCKET, SO_REUSEADDR,
                      SOCKOPT_PTR(&yes), sizeof(yes)) == SOCKET_ERROR_T)
         die("setsockopt");
+    if (reuse_port){
+#ifdef SO_REUSEPORT
+        if (::setsockopt(s, SOL_SOCKET, SO_REUSEPORT,
+                         SOCKOPT_PTR(&yes), sizeof(yes)) == SOCKET_ERROR_T)
+            die("setsockopt SO_REUSEPORT");
+#else
+        die("SO_REUSEPORT is not supported on this platform");
+#endif
+    }
+    set_nodelay(s);
 
-    sockaddr_in addr{};
-    addr.sin_family      = AF_INET;
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    addr.sin_port        = htons(port);
-
-    if (::bind(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR_T) die("bind");
+    if (::bind(s, res->ai_addr, (socklen_t)res->ai_addrlen) == SOCKET_ERROR_T)
+        die("bind " + host + ":" + service);
+    ::freeaddrinfo(res);
     if (::listen(s, 128) == SOCKET_ERROR_T) die("listen");
 
     return s;
 }
 
+socket_t tcp_listen(uint16_t port, bool reuse_port){
+    return tcp_listen("0.0.0.0", port, reuse_port);
+}
+
 // =====================================================
 // tcp_connect(host, port):
 //   - 主动连接到指定 host:port 的 TCP 服务端
@@ -64,6 +103,56 @@ socket_t tcp_listen(uint16_t port){
 // 错误:  调用 die() 直接退出
 // =====================================================
 socket_t tcp_connect(const std::string& host, uint16_t port){
+    socket_t s = tcp_try_connect(host, port);
+    if (s == INVALID_SOCKET_T) die("connect");
+    return s;
+}
+
+// =====================================================
+// connect_within(s, addr, len, timeout_ms):
+//   - timeout_ms <= 0：普通阻塞 connect
+//   - 否则临时切到非阻塞发起连接，poll/select 等可写至多 timeout_ms，
+//     再用 SO_ERROR 取连接结果，成功后恢复阻塞模式
+// 输出:  连接成功返回 true（s 为阻塞模式）；失败或超时返回 false（s 由调用方关闭）
+// =====================================================
+static bool connect_within(socket_t s, const sockaddr* addr, socklen_t len, int timeout_ms){
+    if (timeout_ms <= 0) return ::connect(s, addr, len) != SOCKET_ERROR_T;
+#ifdef _WIN32
+    u_long on = 1, off = 0;
+    if (::ioctlsocket(s, FIONBIO, &on) == SOCKET_ERROR_T) return false;
+    if (::connect(s, addr, len) == SOCKET_ERROR_T){
+        if (GET_LAST_ERR() != WSAEWOULDBLOCK) return false;
+        fd_set wr, ex;
+        FD_ZERO(&wr); FD_SET(s, &wr);
+        FD_ZERO(&ex); FD_SET(s, &ex);
+        timeval tv{ timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+        if (::select(0, nullptr, &wr, &ex, &tv) != 1 || !FD_ISSET(s, &wr)) return false;
+    }
+    return ::ioctlsocket(s, FIONBIO, &off) != SOCKET_ERROR_T;
+#else
+    int flags = ::fcntl(s, F_GETFL, 0);
+    if (flags < 0 || ::fcntl(s, F_SETFL, flags | O_NONBLOCK) < 0) return false;
+    if (::connect(s, addr, len) == SOCKET_ERROR_T){
+        if (errno != EINPROGRESS) return false;   // UNIX socket 队列满是 EAGAIN：按失败处理
+        pollfd p{ s, POLLOUT, 0 };
+        int r;
+        while ((r = ::poll(&p, 1, timeout_ms)) < 0 && errno == EINTR) {}
+        int err = 0;
+        socklen_t elen = sizeof(err);
+        if (r != 1 || ::getsockopt(s, SOL_SOCKET, SO_ERROR, &err, &elen) < 0 || err != 0) return false;
+    }
+    return ::fcntl(s, F_SETFL, flags) == 0;
+#endif
+}
+
+// =====================================================
+// tcp_try_connect(host, port, timeout_ms):
+//   - 同 tcp_connect，但连接失败（对端未监听/不可达/地址非法）不退出
+//   - timeout_ms > 0 时连接最多等 timeout_ms（见 connect_within）
+// 输出:  成功返回 socket_t（已设 TCP_NODELAY）；失败或超时返回 INVALID_SOCKET_T
+// 用途:  多副本场景下某个副本挂掉是常态，不能让整个进程退出
+// =====================================================
+socket_t tcp_try_connect(const std::string& host, uint16_t port, int timeout_ms){
     if (!net_init()) die("WSAStartup");
 
     socket_t s = ::socket(AF_INET, SOCK_STREAM, 0);
@@ -72,12 +161,77 @@ socket_t tcp_connect(const std::string& host, uint16_t port){
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
     addr.sin_port   = htons(port);
-    if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) <= 0)
-        die("inet_pton");
+    if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) <= 0 ||
+        !connect_within(s, (sockaddr*)&addr, sizeof(addr), timeout_ms)){
+        close_fd(s);
+        return INVALID_SOCKET_T;
+    }
+    set_nodelay(s);
+    return s;
+}
+
+// =====================================================
+// set_nodelay(s):
+//   - 关闭 Nagle 算法。请求/响应都是小帧，开着 Nagle 时，前一帧还没被确认，
+//     后面的小帧就会被扣住，遇上对端的延迟确认（Linux 最长约 40ms）就是一次长尾
+//   - 合并写由应用层负责（事件循环每轮一次 sendmsg，见 Reactor::flush），不再依赖 Nagle/TCP_CORK
+// 失败只打日志：不影响正确性
+// =====================================================
+void set_nodelay(socket_t s){
+    int yes = 1;
+    if (::setsockopt(s, IPPROTO_TCP, TCP_NODELAY, SOCKOPT_PTR(&yes), sizeof(yes)) == SOCKET_ERROR_T)
+        perror("setsockopt TCP_NODELAY");
+}
 
-    if (::connect(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR_T)
-        die("connect");
+// =====================================================
+// unix_listen(path) / unix_try_connect(path, timeout_ms):
+//   - AF_UNIX 流式 socket，同机进程间通信时省掉 TCP/IP 协议栈（校验和、拥塞控制、loopback 软中断）
+//   - 监听前 unlink 残留的 socket 文件（上次进程异常退出时留下），否则 bind 报 EADDRINUSE
+//   - 路径超过 sun_path（约 108 字节）：监听 die()，连接返回 INVALID_SOCKET_T
+//   - timeout_ms > 0：连接不阻塞等 accept 队列（队列满即失败）
+// =====================================================
+#ifndef _WIN32
+static bool unix_addr(const std::string& path, sockaddr_un& addr){
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    addr = sockaddr_un{};
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+#endif
+
+socket_t unix_listen(const std::string& path){
+#ifdef _WIN32
+    (void)path;
+    die("unix sockets are not supported on this platform");
+#else
+    sockaddr_un addr;
+    if (!unix_addr(path, addr)){ errno = ENAMETOOLONG; die("unix socket path"); }
+    socket_t s = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET_T) die("socket");
+    ::unlink(path.c_str());
+    if (::bind(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR_T) die("bind");
+    if (::listen(s, 128) == SOCKET_ERROR_T) die("listen");
+    return s;
+#endif
+}
+
+socket_t unix_try_connect(const std::string& path, int timeout_ms){
+#ifdef _WIN32
+    (void)path;
+    (void)timeout_ms;
+    return INVALID_SOCKET_T;
+#else
+    sockaddr_un addr;
+    if (!unix_addr(path, addr)) return INVALID_SOCKET_T;
+    socket_t s = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET_T) die("socket");
+    if (!connect_within(s, (sockaddr*)&addr, sizeof(addr), timeout_ms)){
+        close_fd(s);
+        return INVALID_SOCKET_T;
+    }
     return s;
+#endif
 }
 
 // =====================================================
@@ -92,6 +246,36 @@ void close_fd(socket_t s){
     }
 }
 
+// =====================================================
+// shutdown_fd(s):
+//   - 关闭读写两个方向，阻塞中的 recv 会立即返回 0
+//   - 不释放 fd，调用方在其它线程退出后再 close_fd
+// =====================================================
+void shutdown_fd(socket_t s){
+    if (s == INVALID_SOCKET_T) return;
+#ifdef _WIN32
+    ::shutdown(s, SD_BOTH);
+#else
+    ::shutdown(s, SHUT_RDWR);
+#endif
+}
+
+// =====================================================
+// set_nonblock(s):
+//   - 把 socket 设为非阻塞模式
+//   - Linux 用 fcntl(O_NONBLOCK)，Windows 用 ioctlsocket(FIONBIO)
+// 错误:  调用 die() 直接退出
+// =====================================================
+void set_nonblock(socket_t s){
+#ifdef _WIN32
+    u_long on = 1;
+    if (::ioctlsocket(s, FIONBIO, &on) == SOCKET_ERROR_T) die("ioctlsocket");
+#else
+    int flags = ::fcntl(s, F_GETFL, 0);
+    if (flags < 0 || ::fcntl(s, F_SETFL, flags | O_NONBLOCK) < 0) die("fcntl");
+#endif
+}
+
 // =====================================================
 // write_n(s, buf, n):
 //   - 向 socket 写入恰好 n 字节
@@ -119,6 +303,32 @@ void write_n(socket_t s, const void* buf, size_t n){
     }
 }
 
+// =====================================================
+// try_write_n(s, buf, n):
+//   - 同 write_n，但出错返回 false 而不是退出
+//   - 用 MSG_NOSIGNAL 发送：对端已关闭时得到 EPIPE，而不是 SIGPIPE 杀掉进程
+// =====================================================
+bool try_write_n(socket_t s, const void* buf, size_t n){
+    const uint8_t* p = static_cast<const uint8_t*>(buf);
+    size_t left = n;
+    while (left > 0){
+        int chunk = (left > static_cast<size_t>(std::numeric_limits<int>::max()))
+                    ? std::numeric_limits<int>::max()
+                    : static_cast<int>(left);
+        int w = ::send(s, reinterpret_cast<const char*>(p), chunk, MSG_NOSIGNAL);
+        if (w == SOCKET_ERROR_T){
+#ifndef _WIN32
+            if (errno == EINTR) continue;
+#endif
+            return false;
+        }
+        if (w == 0) return false;
+        p    += w;
+        left -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
 // =====================================================
 // read_n(s, buf, n):
 //   - 从 socket 读取恰好 n 字节
@@ -129,7 +339,7 @@ void write_n(socket_t s, const void* buf, size_t n){
 //        buf 缓冲区指针
 //        n   期望读取的字节数
 // 输出:  true = 成功读满
-//        false = 对端关闭连接
+//        false = 对端关闭连接（含对端复位：放弃未读数据就关闭的客户端很常见）
 // 错误:  调用 die() 或退出
 // =====================================================
 bool read_n(socket_t s, void* buf, size_t n){
@@ -140,7 +350,15 @@ bool read_n(socket_t s, void* buf, size_t n){
                     ? std::numeric_limits<int>::max()
                     : static_cast<int>(left);
         int r = ::recv(s, reinterpret_cast<char*>(p), chunk, 0);
-        if (r == SOCKET_ERROR_T) die("recv");
+        if (r == SOCKET_ERROR_T){
+#ifdef _WIN32
+            if (WSAGetLastError() == WSAECONNRESET) return false;
+#else
+            if (errno == EINTR) continue;
+            if (errno == ECONNRESET) return false;
+#endif
+            die("recv");
+        }
         if (r == 0) return false; // 对端关闭
         p    += r;
         left -= static_cast<size_t>(r);
@@ -148,6 +366,29 @@ bool read_n(socket_t s, void* buf, size_t n){
     return true;
 }
 
+// =====================================================
+// recv_some(s, buf, n):
+//   - 一次 recv，读到多少算多少（缓冲读取用：一次取走内核里已到的若干帧）
+// 输出:  读到的字节数；0 = 对端关闭（含复位）
+// 错误:  同 read_n
+// =====================================================
+size_t recv_some(socket_t s, void* buf, size_t n){
+    int chunk = (n > static_cast<size_t>(std::numeric_limits<int>::max()))
+                ? std::numeric_limits<int>::max()
+                : static_cast<int>(n);
+    while (true){
+        int r = ::recv(s, reinterpret_cast<char*>(buf), chunk, 0);
+        if (r != SOCKET_ERROR_T) return static_cast<size_t>(r);
+#ifdef _WIN32
+        if (WSAGetLastError() == WSAECONNRESET) return 0;
+#else
+        if (errno == EINTR) continue;
+        if (errno == ECONNRESET) return 0;
+#endif
+        die("recv");
+    }
+}
+
 // =====================================================
 // send_frame(s, frame):
 //   - 发送完整的一帧（frame 已经包含 4B 长度前缀）
@@ -167,15 +408,32 @@ void send_frame(socket_t s, const std::vector<uint8_t>& frame){
 // 输出:  RawFrame 对象（含 type、req_id、method、payload）
 // =====================================================
 std::optional<RawFrame> recv_frame(socket_t s){
+    std::vector<uint8_t> body;
+    if (!recv_body(s, body)) return std::nullopt;
+    return parse_body_to_frame(body);
+}
+
+// =====================================================
+// recv_body(s, body):
+//   - 读 4 字节长度，再把 body_len 个字节读进调用方的 body
+//   - body 跨帧复用（resize 不缩容），稳态下不再分配
+//   - 不做解析：调用方可用 parse_body_to_view 零拷贝解析
+// 输出:  true = 读到完整一帧；false = 对端关闭连接
+// 失败:  长度前缀超过 MAX_BODY_LEN → throw runtime_error
+// =====================================================
+bool recv_body(socket_t s, std::vector<uint8_t>& body){
     uint8_t len4[4];
-    if (!read_n(s, len4, 4)) return std::nullopt;
+    if (!read_n(s, len4, 4)) return false;
+    body.resize(decode_body_len(len4));
+    return read_n(s, body.data(), body.size());
+}
+
+uint32_t decode_body_len(const uint8_t len4[4]){
     uint32_t body_len = (uint32_t(len4[0])<<24) | (uint32_t(len4[1])<<16)
                       | (uint32_t(len4[2])<<8)  |  uint32_t(len4[3]);
-
-    std::vector<uint8_t> body(body_len);
-    if (!read_n(s, body.data(), body.size())) return std::nullopt;
-
-    return parse_body_to_frame(body);
+    // 拒绝异常长度前缀：大结果应走流式调用，而不是一帧几个 GB
+    if (body_len > MAX_BODY_LEN) throw std::runtime_error("frame too large");
+    return body_len;
 }
 
 } // namespace rpc
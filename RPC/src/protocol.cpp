@@ -1,4 +1,8 @@
 #include "rpc/protocol.h"
+#include "rpc/byteorder.h"
+#include "rpc/varint.h"
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
 
 namespace rpc {
@@ -7,25 +11,27 @@ namespace rpc {
 // 基础 BE（Big Endian，大端序）读写函数
 // ==========================================================
 
+// 写入函数统一写到裸指针 p（调用方已按 *_size() 预留好空间），返回写入后的位置
+
 // 写入 32 位无符号整数（大端序）
-static void put_u32_be(std::vector<uint8_t>& out, uint32_t v){
-    out.push_back((v>>24)&0xFF); out.push_back((v>>16)&0xFF);
-    out.push_back((v>>8)&0xFF);  out.push_back((v    )&0xFF);
+static uint8_t* put_u32_be(uint8_t* p, uint32_t v){
+    p[0]=(v>>24)&0xFF; p[1]=(v>>16)&0xFF; p[2]=(v>>8)&0xFF; p[3]=v&0xFF;
+    return p+4;
 }
 
 // 写入 16 位无符号整数（大端序）
-static void put_u16_be(std::vector<uint8_t>& out, uint16_t v){
-    out.push_back((v>>8)&0xFF); out.push_back((v   )&0xFF);
+static uint8_t* put_u16_be(uint8_t* p, uint16_t v){
+    p[0]=(v>>8)&0xFF; p[1]=v&0xFF;
+    return p+2;
 }
 
 // 写入 64 位有符号整数（大端序）
 //   - 实际转为 uint64_t，再按字节切割
-static void put_i64_be(std::vector<uint8_t>& out, int64_t v){
+static uint8_t* put_i64_be(uint8_t* p, int64_t v){
     uint64_t u = (uint64_t)v;
-    out.push_back((u>>56)&0xFF); out.push_back((u>>48)&0xFF);
-    out.push_back((u>>40)&0xFF); out.push_back((u>>32)&0xFF);
-    out.push_back((u>>24)&0xFF); out.push_back((u>>16)&0xFF);
-    out.push_back((u>>8 )&0xFF); out.push_back((u    )&0xFF);
+    p[0]=(u>>56)&0xFF; p[1]=(u>>48)&0xFF; p[2]=(u>>40)&0xFF; p[3]=(u>>32)&0xFF;
+    p[4]=(u>>24)&0xFF; p[5]=(u>>16)&0xFF; p[6]=(u>>8 )&0xFF; p[7]=u&0xFF;
+    return p+8;
 }
 
 // 读出 32 位无符号整数（大端序）
@@ -45,80 +51,366 @@ static int64_t get_i64_be(const uint8_t* p){
     return (int64_t)u;
 }
 
+// ==========================================================
+// 长度字段：v1 为 4B 大端，v2 为 varint
+// ==========================================================
+static size_t len_size(size_t len, uint8_t ver){
+    return ver == VERSION_V2 ? varint_size(len) : 4;
+}
+
+static uint8_t* put_len(uint8_t* p, size_t len, uint8_t ver){
+    return ver == VERSION_V2 ? put_varint(p, len) : put_u32_be(p, (uint32_t)len);
+}
+
+// 读长度到 out，返回消费字节数；字节不足 → throw runtime_error(what)
+static size_t get_len(const uint8_t* p, size_t n, uint8_t ver, uint64_t& out, const char* what){
+    if (ver == VERSION_V2) return get_varint(p, n, out);
+    if (n < 4) throw std::runtime_error(what);
+    out = get_u32_be(p);
+    return 4;
+}
+
 // ==========================================================
 // Value 编解码
-//   - 支持类型：INT64, STRING
 //   - 格式：[1B type][data...]
+//       INT64      v1：8B 大端；v2：zigzag varint
+//       DOUBLE     8B 大端（IEEE754 位模式，两个版本相同）
+//       BOOL       1B（0/1）
+//       STRING/BYTES  [len][内容]
+//       ARRAY      [count][Value]...
+//       MAP        [count]([klen][key][Value])...
+//       INT64_ARRAY/F64_ARRAY  [count][count 个 8B 大端元素]（批量转换）
+//     其中 len/count：v1 为 4B 大端，v2 为 varint
 // ==========================================================
 
-// 把 Value 编码成字节流并写入 out
-void encode_value(std::vector<uint8_t>& out, const Value& v){
-    out.push_back((uint8_t)v.type);  // 写入 ValueType
-    if (v.type == ValueType::INT64){
-        put_i64_be(out, v.i64);
-    } else if (v.type == ValueType::STRING){
-        put_u32_be(out, (uint32_t)v.str.size());             // 长度
-        out.insert(out.end(), v.str.begin(), v.str.end());   // 字符串内容
-    } else {
-        throw std::runtime_error("unknown ValueType");
+// 容器嵌套上限：防止恶意数据让递归解码爆栈
+static constexpr int MAX_DEPTH = 64;
+
+// ----------------------------------------------------------
+// 单值直接编码：encode_value_to 与类型化接口（typed.h）共用，保证两边字节一致
+// ----------------------------------------------------------
+size_t encoded_size_int(int64_t v, uint8_t ver){
+    return 1 + (ver == VERSION_V2 ? varint_size(zigzag_encode(v)) : 8);
+}
+
+uint8_t* encode_int_to(uint8_t* p, int64_t v, uint8_t ver){
+    *p++ = (uint8_t)ValueType::INT64;
+    return ver == VERSION_V2 ? put_varint(p, zigzag_encode(v)) : put_i64_be(p, v);
+}
+
+uint8_t* encode_double_to(uint8_t* p, double v){
+    *p++ = (uint8_t)ValueType::DOUBLE;
+    store_be64_array(p, &v, 1);
+    return p + 8;
+}
+
+uint8_t* encode_bool_to(uint8_t* p, bool v){
+    *p++ = (uint8_t)ValueType::BOOL;
+    *p++ = v ? 1 : 0;
+    return p;
+}
+
+size_t encoded_size_bytes(size_t len, uint8_t ver){
+    return 1 + len_size(len, ver) + len;
+}
+
+// 写 [len][bytes]
+static uint8_t* put_bytes(uint8_t* p, std::string_view b, uint8_t ver){
+    p = put_len(p, b.size(), ver);
+    if (!b.empty()) std::memcpy(p, b.data(), b.size());
+    return p + b.size();
+}
+
+uint8_t* encode_bytes_to(uint8_t* p, ValueType t, std::string_view b, uint8_t ver){
+    *p++ = (uint8_t)t;
+    return put_bytes(p, b, ver);
+}
+
+size_t encoded_size_array8(size_t count, uint8_t ver){
+    return 1 + len_size(count, ver) + count * 8;
+}
+
+uint8_t* encode_i64_array_to(uint8_t* p, const int64_t* a, size_t count, uint8_t ver){
+    *p++ = (uint8_t)ValueType::INT64_ARRAY;
+    p = put_len(p, count, ver);
+    store_be64_array(p, a, count);                   // 整段批量转换
+    return p + count * 8;
+}
+
+uint8_t* encode_f64_array_to(uint8_t* p, const double* a, size_t count, uint8_t ver){
+    *p++ = (uint8_t)ValueType::F64_ARRAY;
+    p = put_len(p, count, ver);
+    store_be64_array(p, a, count);
+    return p + count * 8;
+}
+
+size_t argc_size(size_t argc, uint8_t ver){ return len_size(argc, ver); }
+uint8_t* encode_argc_to(uint8_t* p, size_t argc, uint8_t ver){ return put_len(p, argc, ver); }
+
+size_t decode_argc(const uint8_t* p, size_t n, uint8_t ver, uint64_t& argc){
+    return get_len(p, n, ver, argc, "req payload too short");
+}
+
+// Value 编码后的字节数（单趟编码先用它算总长）
+size_t encoded_size(const Value& v, uint8_t ver){
+    switch (v.type()){
+    case ValueType::INT64:
+        return encoded_size_int(v.i64(), ver);
+    case ValueType::DOUBLE:
+        return 1 + 8;
+    case ValueType::BOOL:
+        return 1 + 1;
+    case ValueType::STRING:
+    case ValueType::BYTES:
+        return encoded_size_bytes(v.str().size(), ver);
+    case ValueType::ARRAY: {
+        size_t n = 1 + len_size(v.arr().size(), ver);
+        for (auto& e : v.arr()) n += encoded_size(e, ver);
+        return n;
+    }
+    case ValueType::MAP: {
+        size_t n = 1 + len_size(v.map().size(), ver);
+        for (auto& kv : v.map())
+            n += len_size(kv.first.size(), ver) + kv.first.size() + encoded_size(kv.second, ver);
+        return n;
+    }
+    case ValueType::INT64_ARRAY:
+        return encoded_size_array8(v.i64s().size(), ver);
+    case ValueType::F64_ARRAY:
+        return encoded_size_array8(v.f64s().size(), ver);
     }
+    throw std::runtime_error("unknown ValueType");
 }
 
-// 从字节流解析出一个 Value
-// 返回：Value 对象 + 消费的字节数
-std::pair<Value,size_t> decode_value(const uint8_t* p, size_t n){
+// 把 Value 直接写到 p（需预留 encoded_size(v) 字节），返回末尾
+uint8_t* encode_value_to(uint8_t* p, const Value& v, uint8_t ver){
+    switch (v.type()){
+    case ValueType::INT64:
+        return encode_int_to(p, v.i64(), ver);
+    case ValueType::DOUBLE:
+        return encode_double_to(p, v.f64());
+    case ValueType::BOOL:
+        return encode_bool_to(p, v.boolean());
+    case ValueType::STRING:
+    case ValueType::BYTES:
+        return encode_bytes_to(p, v.type(), v.str(), ver);   // 长度 + 内容
+    case ValueType::ARRAY:
+        *p++ = (uint8_t)ValueType::ARRAY;
+        p = put_len(p, v.arr().size(), ver);
+        for (auto& e : v.arr()) p = encode_value_to(p, e, ver);
+        return p;
+    case ValueType::MAP:
+        *p++ = (uint8_t)ValueType::MAP;
+        p = put_len(p, v.map().size(), ver);
+        for (auto& kv : v.map()){
+            p = put_bytes(p, kv.first, ver);
+            p = encode_value_to(p, kv.second, ver);
+        }
+        return p;
+    case ValueType::INT64_ARRAY:
+        return encode_i64_array_to(p, v.i64s().data(), v.i64s().size(), ver);
+    case ValueType::F64_ARRAY:
+        return encode_f64_array_to(p, v.f64s().data(), v.f64s().size(), ver);
+    }
+    throw std::runtime_error("unknown ValueType");
+}
+
+// 把 Value 编码成字节流并追加到 out（一次扩容 + 直接写入）
+void encode_value(std::vector<uint8_t>& out, const Value& v, uint8_t ver){
+    size_t base = out.size();
+    out.resize(base + encoded_size(v, ver));
+    encode_value_to(out.data() + base, v, ver);
+}
+
+// 读 [len][bytes] 为视图，返回消费字节数
+static size_t get_bytes(const uint8_t* p, size_t n, uint8_t ver, std::string_view& out){
+    uint64_t len;
+    size_t off = get_len(p, n, ver, len, "decode_value: need len");
+    if (n - off < len) throw std::runtime_error("decode_value: need str bytes");
+    out = std::string_view((const char*)p+off, (size_t)len);
+    return off + (size_t)len;
+}
+
+// 读 [count]，并用“每个元素至少 min_elem 字节”校验 count 不超过剩余长度
+static size_t get_count(const uint8_t* p, size_t n, uint8_t ver, size_t min_elem, uint64_t& count){
+    size_t off = get_len(p, n, ver, count, "decode_value: need count");
+    if (count > (n - off) / min_elem) throw std::runtime_error("decode_value: count too large");
+    return off;
+}
+
+static std::pair<ValueView,size_t> decode_view_impl(const uint8_t* p, size_t n, uint8_t ver, int depth){
     if (n < 1) throw std::runtime_error("decode_value: not enough bytes");
-    auto t = (ValueType)p[0];
+    if (depth > MAX_DEPTH) throw std::runtime_error("decode_value: nested too deep");
+    ValueView v;
+    v.type = (ValueType)p[0];
+    v.ver  = ver;
     size_t off = 1;
 
-    if (t == ValueType::INT64){
-        if (n < off + 8) throw std::runtime_error("decode_value: need int64");
-        int64_t x = get_i64_be(p+off);
-        off += 8;
-        return { Value::make_int(x), off };
+    switch (v.type){
+    case ValueType::INT64:
+        if (ver == VERSION_V2){
+            uint64_t u;
+            off += get_varint(p+off, n-off, u);
+            v.i64 = zigzag_decode(u);
+        } else {
+            if (n < off + 8) throw std::runtime_error("decode_value: need int64");
+            v.i64 = get_i64_be(p+off);
+            off += 8;
+        }
+        return { v, off };
+
+    case ValueType::DOUBLE:
+        if (n < off + 8) throw std::runtime_error("decode_value: need double");
+        load_be64_array(&v.f64, p+off, 1);
+        return { v, off + 8 };
 
-    } else if (t == ValueType::STRING){
-        if (n < off + 4) throw std::runtime_error("decode_value: need len");
-        uint32_t len = get_u32_be(p+off);
-        off += 4;
-        if (n < off + len) throw std::runtime_error("decode_value: need str bytes");
-        std::string s((const char*)p+off, len);
-        off += len;
-        return { Value::make_str(std::move(s)), off };
+    case ValueType::BOOL:
+        if (n < off + 1) throw std::runtime_error("decode_value: need bool");
+        v.i64 = p[off] ? 1 : 0;
+        return { v, off + 1 };
+
+    case ValueType::STRING:
+    case ValueType::BYTES:
+        off += get_bytes(p+off, n-off, ver, v.str);
+        return { v, off };
+
+    case ValueType::INT64_ARRAY:
+    case ValueType::F64_ARRAY: {
+        uint64_t count;
+        off += get_count(p+off, n-off, ver, 8, count);
+        v.count = (size_t)count;
+        v.str = std::string_view((const char*)p+off, v.count * 8);   // 原始元素字节
+        return { v, off + v.count * 8 };
+    }
+
+    case ValueType::ARRAY:
+    case ValueType::MAP: {
+        // 逐个跳过元素以确定总长（同时校验），内容留给 to_value() 再物化
+        uint64_t count;
+        off += get_count(p+off, n-off, ver, 1, count);
+        for (uint64_t i = 0; i < count; ++i){
+            if (v.type == ValueType::MAP){
+                std::string_view key;
+                off += get_bytes(p+off, n-off, ver, key);
+            }
+            off += decode_view_impl(p+off, n-off, ver, depth+1).second;
+        }
+        v.count = (size_t)count;
+        v.raw = std::string_view((const char*)p, off);
+        return { v, off };
+    }
     }
 
     throw std::runtime_error("decode_value: bad type");
 }
 
+// 从字节流解析出一个 Value 视图（STRING/BYTES/定长数组指向 p 内部，不拷贝）
+// 返回：ValueView + 消费的字节数
+std::pair<ValueView,size_t> decode_value_view(const uint8_t* p, size_t n, uint8_t ver){
+    return decode_view_impl(p, n, ver, 0);
+}
+
+static std::pair<Value,size_t> decode_owned_impl(const uint8_t* p, size_t n, uint8_t ver, int depth,
+                                                 std::pmr::memory_resource* mr){
+    if (n < 1) throw std::runtime_error("decode_value: not enough bytes");
+    auto t = (ValueType)p[0];
+    if (t != ValueType::ARRAY && t != ValueType::MAP){
+        auto [view, used] = decode_view_impl(p, n, ver, depth);
+        return { view.to_value(mr), used };
+    }
+    if (depth > MAX_DEPTH) throw std::runtime_error("decode_value: nested too deep");
+
+    uint64_t count;
+    size_t off = 1 + get_count(p+1, n-1, ver, 1, count);
+    if (t == ValueType::ARRAY){
+        Value::Array arr(mr);
+        arr.reserve((size_t)count);
+        for (uint64_t i = 0; i < count; ++i){
+            auto [e, used] = decode_owned_impl(p+off, n-off, ver, depth+1, mr);
+            off += used;
+            arr.push_back(std::move(e));
+        }
+        return { Value::make_array(std::move(arr)), off };
+    }
+    Value::Map map(mr);                                  // 键随容器一起从 mr 分配
+    map.reserve((size_t)count);
+    for (uint64_t i = 0; i < count; ++i){
+        std::string_view key;
+        off += get_bytes(p+off, n-off, ver, key);
+        auto [e, used] = decode_owned_impl(p+off, n-off, ver, depth+1, mr);
+        off += used;
+        map.emplace_back(key, std::move(e));
+    }
+    return { Value::make_map(std::move(map)), off };
+}
+
+// 从字节流解析出一个 Value（拥有内存的版本；变长内容从 mr 分配）
+// 返回：Value 对象 + 消费的字节数
+std::pair<Value,size_t> decode_value(const uint8_t* p, size_t n, uint8_t ver,
+                                     std::pmr::memory_resource* mr){
+    return decode_owned_impl(p, n, ver, 0, mr);
+}
+
 // ==========================================================
 // Request/Response payload 编解码
 // ==========================================================
 
 // -------- Request 编码格式 --------
-// [4B argc][arg1][arg2]...
-// 每个 arg 用 encode_value() 编码
-std::vector<uint8_t> Request::encode_payload() const {
-    std::vector<uint8_t> out;
-    put_u32_be(out, (uint32_t)args.size());
-    for (auto& v : args) encode_value(out, v);
+// [argc][arg1][arg2]...      argc：v1 为 4B 大端，v2 为 varint
+// 每个 arg 用 encode_value_to() 编码
+size_t args_payload_size(const std::vector<Value>& args, uint8_t ver){
+    size_t n = len_size(args.size(), ver);
+    for (auto& v : args) n += encoded_size(v, ver);
+    return n;
+}
+
+uint8_t* encode_args_to(uint8_t* p, const std::vector<Value>& args, uint8_t ver){
+    p = put_len(p, args.size(), ver);
+    for (auto& v : args) p = encode_value_to(p, v, ver);
+    return p;
+}
+
+size_t Request::payload_size(uint8_t ver) const { return args_payload_size(args, ver); }
+
+uint8_t* Request::encode_payload_to(uint8_t* p, uint8_t ver) const {
+    return encode_args_to(p, args, ver);
+}
+
+std::vector<uint8_t> Request::encode_payload(uint8_t ver) const {
+    std::vector<uint8_t> out(payload_size(ver));
+    encode_payload_to(out.data(), ver);
     return out;
 }
 
 // -------- Response 编码格式 --------
-// [2B status][4B err_msg_len][err_msg?][1B has_result][result?]
-std::vector<uint8_t> Response::encode_payload() const {
-    std::vector<uint8_t> out;
-    put_u16_be(out, status);
+// v1: [2B status][4B err_msg_len][err_msg?][1B has_result][result?]
+// v2: [varint status][varint err_msg_len][err_msg?][1B has_result][result?]
+size_t Response::payload_size(uint8_t ver) const {
+    size_t err_len = status != 0 ? err_msg.size() : 0;
+    size_t n = (ver == VERSION_V2 ? varint_size(status) : 2) + len_size(err_len, ver) + err_len + 1;
+    if (has_result) n += encoded_size(result, ver);
+    return n;
+}
+
+uint8_t* Response::encode_payload_to(uint8_t* p, uint8_t ver) const {
+    p = ver == VERSION_V2 ? put_varint(p, status) : put_u16_be(p, status);
 
     if (status != 0){
-        put_u32_be(out, (uint32_t)err_msg.size());
-        out.insert(out.end(), err_msg.begin(), err_msg.end());
+        p = put_len(p, err_msg.size(), ver);
+        if (!err_msg.empty()) std::memcpy(p, err_msg.data(), err_msg.size());
+        p += err_msg.size();
     } else {
-        put_u32_be(out, 0);  // 没有错误消息
+        p = put_len(p, 0, ver);  // 没有错误消息
     }
 
-    out.push_back(has_result ? 1 : 0);
-    if (has_result) encode_value(out, result);
+    *p++ = has_result ? 1 : 0;
+    if (has_result) p = encode_value_to(p, result, ver);
+    return p;
+}
+
+std::vector<uint8_t> Response::encode_payload(uint8_t ver) const {
+    std::vector<uint8_t> out(payload_size(ver));
+    encode_payload_to(out.data(), ver);
     return out;
 }
 
@@ -126,48 +418,98 @@ std::vector<uint8_t> Response::encode_payload() const {
 // 输入：req_id + method + payload
 // 输出：Request 对象（含参数向量）
 Request parse_request_payload(uint32_t req_id, const std::string& method,
-                              const std::vector<uint8_t>& pl){
-    Request r; r.req_id=req_id; r.method=method;
-    const uint8_t* p = pl.data(); size_t n = pl.size();
+                              const std::vector<uint8_t>& pl, uint8_t ver){
+    return parse_request_payload(req_id, std::string_view(method), pl.data(), pl.size(), ver);
+}
 
-    if (n < 4) throw std::runtime_error("req payload too short");
-    uint32_t argc = get_u32_be(p); p+=4; n-=4;
+Request parse_request_payload(uint32_t req_id, std::string_view method,
+                              const uint8_t* p, size_t n, uint8_t ver){
+    Request r;
+    parse_request_payload(req_id, method, p, n, r, std::pmr::get_default_resource(), ver);
+    return r;
+}
+
+// 解析到 out（复用 out.method/out.args 的容量）；参数的变长内容从 mr 分配
+void parse_request_payload(uint32_t req_id, std::string_view method, const uint8_t* p, size_t n,
+                           Request& out, std::pmr::memory_resource* mr, uint8_t ver){
+    out.req_id = req_id;
+    out.method.assign(method.data(), method.size());
+    out.args.clear();
 
-    r.args.reserve(argc);
-    for (uint32_t i=0;i<argc;++i){
-        auto [val, used] = decode_value(p, n);
-        r.args.push_back(std::move(val));
+    uint64_t argc;
+    size_t used0 = get_len(p, n, ver, argc, "req payload too short");
+    p+=used0; n-=used0;
+
+    // argc 来自网络：每个参数至少 1 字节，先用剩余长度限制 reserve
+    out.args.reserve(std::min<size_t>(argc, n));
+    for (uint64_t i=0;i<argc;++i){
+        auto [val, used] = decode_value(p, n, ver, mr);
+        out.args.push_back(std::move(val));
+        p += used; n -= used;
+    }
+    if (n != 0) throw std::runtime_error("extra bytes in req payload");
+}
+
+// -------- Request payload 零拷贝解码 --------
+// 输入：req_id + method 视图 + payload 指针/长度
+// 输出：写入 out；out.args 先 clear 再填充，容量跨请求复用
+// 注意：out 中所有 string_view 指向 p，p 失效后不可再用
+void parse_request_view(uint32_t req_id, std::string_view method,
+                        const uint8_t* p, size_t n, RequestView& out, uint8_t ver){
+    out.req_id = req_id;
+    out.method = method;
+    out.args.clear();
+
+    uint64_t argc;
+    size_t used0 = get_len(p, n, ver, argc, "req payload too short");
+    p+=used0; n-=used0;
+
+    for (uint64_t i=0;i<argc;++i){
+        auto [val, used] = decode_value_view(p, n, ver);
+        out.args.push_back(val);
         p += used; n -= used;
     }
     if (n != 0) throw std::runtime_error("extra bytes in req payload");
-    return r;
 }
 
 // -------- Response payload 解码 --------
 // 输入：req_id + payload
 // 输出：Response 对象（含 status、err_msg、result）
-Response parse_response_payload(uint32_t req_id, const std::vector<uint8_t>& pl){
-    Response rsp; rsp.req_id=req_id;
-    const uint8_t* p = pl.data(); size_t n = pl.size();
+Response parse_response_payload(uint32_t req_id, const std::vector<uint8_t>& pl, uint8_t ver){
+    return parse_response_payload(req_id, pl.data(), pl.size(), ver);
+}
 
-    if (n < 2+4+1) throw std::runtime_error("rsp payload too short");
+Response parse_response_payload(uint32_t req_id, const uint8_t* pl, size_t n, uint8_t ver){
+    Response rsp; rsp.req_id=req_id;
+    const uint8_t* p = pl;
 
-    rsp.status = get_u16_be(p); p+=2; n-=2;
+    if (ver == VERSION_V2){
+        uint64_t st;
+        size_t used = get_varint(p, n, st);
+        if (st > 0xFFFF) throw std::runtime_error("rsp bad status");
+        rsp.status = (uint16_t)st; p+=used; n-=used;
+    } else {
+        if (n < 2) throw std::runtime_error("rsp payload too short");
+        rsp.status = get_u16_be(p); p+=2; n-=2;
+    }
 
-    uint32_t err_len = get_u32_be(p); p+=4; n-=4;
+    uint64_t err_len;
+    size_t used = get_len(p, n, ver, err_len, "rsp payload too short");
+    p+=used; n-=used;
     if (err_len>0){
         if (n < err_len) throw std::runtime_error("rsp err too long");
-        rsp.err_msg.assign((const char*)p, err_len);
+        rsp.err_msg.assign((const char*)p, (size_t)err_len);
         p+=err_len; n-=err_len;
     }
 
+    if (n < 1) throw std::runtime_error("rsp payload too short");
     uint8_t has = *p; p+=1; n-=1;
     rsp.has_result = (has != 0);
 
     if (rsp.has_result){
-        auto [val, used] = decode_value(p, n);
+        auto [val, vused] = decode_value(p, n, ver);
         rsp.result = std::move(val);
-        p += used; n -= used;
+        p += vused; n -= vused;
     }
     if (n != 0) throw std::runtime_error("extra bytes in rsp payload");
     return rsp;
@@ -0,0 +1,450 @@
+#include "rpc/reactor.h"
+#include "rpc/buffer_pool.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace rpc {
+
+// =====================================================
+// Reactor: epoll 事件循环
+// 职责：
+//   - 接受新连接并设为非阻塞、注册到 epoll
+//   - 增量读取字节流，按 [4B body_len][body] 切出完整帧
+//   - 对每一帧调用 on_frame_，响应字节追加到连接的发送队列
+//   - 接收其它线程 post() 过来的异步响应（eventfd 唤醒）
+//   - 一轮事件处理完后，每个有新响应的连接只 sendmsg 一次（写不完就等 EPOLLOUT）：
+//     流水线上的多个请求、同一轮里 worker 交回的响应都合并成一次系统调用、尽量凑满报文段
+//   - 背压：待发送超过 OUT_HIGH_WATER 时暂停该连接的读取与切帧（取消 EPOLLIN），
+//     发到 OUT_LOW_WATER 以下再恢复；恢复时先处理已收下但还没切的帧
+//   - 对端半关闭：取消 EPOLLIN，已收下的帧照常处理；响应发完、异步回包（hold）都到齐后才关闭
+//
+// 与一连接一线程模式相比：
+//   - 一个线程服务全部连接，空闲连接几乎零开销
+//   - 未启用工作线程池时 handler 在事件循环线程里同步执行，慢 handler 会拖慢其它连接
+// =====================================================
+
+static constexpr int    MAX_EVENTS = 256;
+static constexpr size_t READ_CHUNK = 64 * 1024;
+static constexpr int    MAX_IOV    = 64;         // 一次 sendmsg 最多带的段数
+static constexpr size_t POST_COPY_MAX = 4096;    // post 交回的响应小于此值时复制进当前段，否则整段挂上
+static constexpr size_t OUT_HIGH_WATER = 4u << 20;   // 待发送超过它就暂停读取
+static constexpr size_t OUT_LOW_WATER  = 1u << 20;   // 降到它以下恢复读取
+static constexpr size_t MAX_READ_PER_EVENT = 16 * READ_CHUNK;   // 一次可读事件最多读这么多，其余留给下一轮
+
+static uint32_t get_u32_be(const uint8_t* p){
+    return (uint32_t(p[0])<<24)|(uint32_t(p[1])<<16)|(uint32_t(p[2])<<8)|uint32_t(p[3]);
+}
+
+Reactor::Reactor(socket_t listen_fd, FrameHandler on_frame)
+    : listen_fd_(listen_fd), on_frame_(std::move(on_frame)) {
+    epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0) die("epoll_create1");
+
+    set_nonblock(listen_fd_);
+    epoll_event ev{};
+    ev.events  = EPOLLIN;
+    ev.data.fd = listen_fd_;
+    if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, listen_fd_, &ev) < 0) die("epoll_ctl ADD listen");
+
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) die("eventfd");
+    ev.events  = EPOLLIN;
+    ev.data.fd = wake_fd_;
+    if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, wake_fd_, &ev) < 0) die("epoll_ctl ADD eventfd");
+}
+
+// 析构：关闭所有客户端连接与 epoll/eventfd（监听 fd 归 RpcServer 管）
+Reactor::~Reactor(){
+    for (auto& kv : conns_) CLOSESOCK(kv.first);
+    if (wake_fd_ >= 0) ::close(wake_fd_);
+    if (epfd_ >= 0) ::close(epfd_);
+}
+
+// =====================================================
+// post(conn, bytes)
+// 功能：任意线程调用；把响应挂到 posted_，写 eventfd 唤醒事件循环
+//       真正的追加/发送在 on_wakeup 中由事件循环线程完成
+// =====================================================
+void Reactor::post(ConnRef conn, std::vector<uint8_t> bytes){
+    bool first;
+    {
+        std::lock_guard<std::mutex> lk(post_mu_);
+        first = posted_.empty() && tasks_.empty();
+        posted_.push_back(Posted{conn, std::move(bytes)});
+    }
+    if (first) wake();               // 已有未处理的唤醒就不必重复写
+}
+
+// hold(conn)：事件循环线程调用，连接已关闭则忽略
+void Reactor::hold(ConnRef conn){
+    auto it = conns_.find(conn.fd);
+    if (it != conns_.end() && it->second.id == conn.id) ++it->second.holds;
+}
+
+// unhold(conn)：同 post 走 posted_，保证排在该任务之前 post 的回包之后处理
+void Reactor::unhold(ConnRef conn){
+    bool first;
+    {
+        std::lock_guard<std::mutex> lk(post_mu_);
+        first = posted_.empty() && tasks_.empty();
+        posted_.push_back(Posted{conn, {}, true});
+    }
+    if (first) wake();
+}
+
+// dispatch(fn)：同 post，fn 在 on_wakeup 中由事件循环线程执行
+void Reactor::dispatch(std::function<void()> fn){
+    bool first;
+    {
+        std::lock_guard<std::mutex> lk(post_mu_);
+        first = posted_.empty() && tasks_.empty();
+        tasks_.push_back(std::move(fn));
+    }
+    if (first) wake();
+}
+
+void Reactor::wake(){
+    uint64_t one = 1;
+    note_syscall();
+    ssize_t w = ::write(wake_fd_, &one, sizeof(one));
+    (void)w;                         // EAGAIN 表示计数已非零，事件循环一定会醒
+}
+
+// =====================================================
+// on_wakeup()
+// 功能：清空 eventfd 计数，取走全部任务与 posted_：先执行 dispatch 来的任务，
+//       再把 posted_ 按连接挂到发送队列，留到本轮结束时 flush（任务中产生的回包会再唤醒一次）
+//       连接已关闭或 fd 已被新连接复用（id 不同）则丢弃
+//       unhold 登记：归还一个 hold，半关闭的连接若已无事可做则关闭
+// =====================================================
+void Reactor::on_wakeup(){
+    uint64_t cnt;
+    do note_syscall(); while (::read(wake_fd_, &cnt, sizeof(cnt)) > 0);
+
+    // 两个队列在同一把锁下一起取走：否则在两次取走之间到达的任务可能等不到下一次唤醒
+    {
+        std::lock_guard<std::mutex> lk(post_mu_);
+        wake_tasks_.swap(tasks_);
+        wake_batch_.swap(posted_);
+    }
+    for (auto& fn : wake_tasks_) fn();
+    wake_tasks_.clear();
+
+    // 小响应复制进当前段后把缓冲区还给池（多半是 worker 从池里取的）；大响应整段挂上，发完再还
+    for (auto& item : wake_batch_){
+        auto it = conns_.find(item.conn.fd);
+        if (it == conns_.end() || it->second.id != item.conn.id){
+            if (!item.unhold) BufferPool::release(std::move(item.bytes));
+            continue;
+        }
+        Conn& c = it->second;
+        if (item.unhold){
+            if (c.holds) --c.holds;
+            if (finished(c)) close_conn(c.fd);
+            continue;
+        }
+        if (item.bytes.size() < POST_COPY_MAX){
+            c.out.back().insert(c.out.back().end(), item.bytes.begin(), item.bytes.end());
+            BufferPool::release(std::move(item.bytes));
+        }else{
+            c.out.push_back(std::move(item.bytes));
+        }
+        mark_dirty(c);
+    }
+    wake_batch_.clear();
+}
+
+// =====================================================
+// run()
+// 功能：事件主循环（水平触发）
+//   - 监听 fd 可读 → on_accept
+//   - 客户端可读 → on_readable；可写 → flush
+//   - EPOLLHUP/EPOLLERR 也走可读路径，由 recv 返回值判断关闭；已半关闭的连接直接关闭（写不出去了）
+//   - 本轮事件处理完 → flush_dirty
+// =====================================================
+void Reactor::run(){
+    epoll_event events[MAX_EVENTS];
+    while (true){
+        note_syscall();
+        int n = ::epoll_wait(epfd_, events, MAX_EVENTS, -1);
+        if (n < 0){
+            if (errno == EINTR) continue;
+            die("epoll_wait");
+        }
+        for (int i = 0; i < n; ++i){
+            socket_t fd = events[i].data.fd;
+            uint32_t ev = events[i].events;
+            if (fd == listen_fd_){ on_accept(); continue; }
+            if (fd == wake_fd_){ on_wakeup(); continue; }
+
+            auto it = conns_.find(fd);
+            if (it == conns_.end()) continue; // 本轮已被关闭
+            Conn& c = it->second;
+
+            if (c.eof && (ev & (EPOLLHUP | EPOLLERR))){ close_conn(fd); continue; }
+            if (ev & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+                on_readable(c);
+                if (conns_.find(fd) == conns_.end()) continue;
+            }
+            if (ev & EPOLLOUT){
+                if (!flush(c) || finished(c)) close_conn(fd);
+            }
+        }
+        flush_dirty();
+        resume_reading();
+    }
+}
+
+// =====================================================
+// on_accept()
+// 功能：取尽 accept 队列，每个新连接设非阻塞并注册 EPOLLIN
+// 失败：EAGAIN 表示已取尽；其它错误打日志后返回（下轮再试）
+// =====================================================
+void Reactor::on_accept(){
+    while (true){
+        note_syscall();
+        socket_t cfd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd < 0){
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept4");
+            return;
+        }
+
+        epoll_event ev{};
+        ev.events  = EPOLLIN;
+        ev.data.fd = cfd;
+        note_syscall();
+        if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, cfd, &ev) < 0){
+            perror("epoll_ctl ADD client");
+            CLOSESOCK(cfd);
+            continue;
+        }
+        Conn& c = conns_[cfd];
+        c.fd = cfd;
+        c.events = EPOLLIN;
+        c.id = next_conn_id_++;
+        c.in = BufferPool::acquire();
+        c.out.push_back(BufferPool::acquire());
+        if (io_){
+            io_->connections.fetch_add(1, std::memory_order_relaxed);
+            io_->accepted.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+// =====================================================
+// on_readable(c)
+// 功能：
+//   1) 循环 recv 直到 EAGAIN（或本次已读 MAX_READ_PER_EVENT，余下的水平触发下一轮再读），追加到 c.in
+//   2) handle_input 切帧、回调
+// 边界：
+//   - 读取已暂停（背压）或对端已半关闭：什么都不做
+//   - recv 出错 → 关闭连接；返回 0 → 记下 eof
+// =====================================================
+void Reactor::on_readable(Conn& c){
+    if (c.paused || c.eof) return;
+    socket_t fd = c.fd;
+    uint8_t buf[READ_CHUNK];
+    size_t got = 0;
+    while (got < MAX_READ_PER_EVENT){
+        note_syscall();
+        ssize_t r = ::recv(fd, buf, sizeof(buf), 0);
+        if (r > 0){
+            if (io_) io_->bytes_in.fetch_add((uint64_t)r, std::memory_order_relaxed);
+            c.in.insert(c.in.end(), buf, buf + r);
+            got += (size_t)r;
+            if ((size_t)r < sizeof(buf)) break; // 大概率已读空，省一次 EAGAIN
+            continue;
+        }
+        if (r == 0){ c.eof = true; break; }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        close_conn(fd);
+        return;
+    }
+    handle_input(c);
+}
+
+// =====================================================
+// handle_input(c)
+// 功能：
+//   1) 从 c.in 头部切出完整帧 → parse_body_to_view → on_frame_
+//      （视图直接指向 c.in，回调返回前 c.in 不会被修改）
+//   2) 待发送超过高水位：暂停读取，剩下的帧留在 c.in，恢复后再切
+//   3) 丢弃已消费前缀；若产生了响应，记为 dirty，本轮结束时与其它响应一起 flush
+//   4) eof 且没有暂停（帧已切完）：取消 EPOLLIN，已无待发送与待回的异步任务则立即关闭，
+//      否则由 flush / unhold 在最后一个字节发出后关闭
+// 边界：长度前缀超过 MAX_BODY_LEN 或帧解析失败 → 视为协议错误，关闭连接
+// 返回：false 表示连接已关闭
+// =====================================================
+bool Reactor::handle_input(Conn& c){
+    socket_t fd = c.fd;
+    size_t off = 0;
+    std::vector<uint8_t>& out = c.out.back();   // on_frame 期间 post 只入队，不会改动 c.out
+    size_t out_before = out.size();
+    try{
+        while (c.in.size() - off >= 4){
+            if (c.pending() >= OUT_HIGH_WATER){
+                c.paused = true;
+                update_events(c, c.want_write);
+                break;
+            }
+            uint32_t body_len = get_u32_be(c.in.data() + off);
+            if (body_len > MAX_BODY_LEN) throw std::runtime_error("frame too large");
+            if (c.in.size() - off - 4 < body_len) break; // 半帧，等下次可读
+
+            RawFrameView rf = parse_body_to_view(c.in.data() + off + 4, body_len);
+            off += 4 + body_len;
+            on_frame_(ConnRef{fd, c.id}, rf, out);
+        }
+    }catch(const std::exception& e){
+        std::cerr << "[reactor] protocol error fd=" << fd << ": " << e.what() << "\n";
+        close_conn(fd);
+        return false;
+    }
+    if (off) c.in.erase(c.in.begin(), c.in.begin() + (std::ptrdiff_t)off);
+
+    if (out.size() != out_before) mark_dirty(c);
+    if (c.eof && !c.paused){
+        update_events(c, c.want_write);
+        if (finished(c)){
+            close_conn(fd);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Reactor::finished(const Conn& c){
+    return c.eof && !c.paused && c.holds == 0 && c.pending() == 0;
+}
+
+// 本轮 flush 后降到低水位的连接：EPOLLIN 已恢复，但已收下的帧可能不会再触发可读事件，
+// 这里直接切；切出的响应立即 flush，可能再次暂停/恢复，直到没有可恢复的连接
+void Reactor::resume_reading(){
+    while (!resumed_.empty()){
+        std::vector<ConnRef> batch;
+        batch.swap(resumed_);
+        for (const ConnRef& ref : batch){
+            auto it = conns_.find(ref.fd);
+            if (it == conns_.end() || it->second.id != ref.id || it->second.paused) continue;
+            handle_input(it->second);
+        }
+        flush_dirty();
+    }
+}
+
+void Reactor::mark_dirty(Conn& c){
+    if (c.dirty) return;
+    c.dirty = true;
+    dirty_.push_back(ConnRef{c.fd, c.id});
+}
+
+// 本轮产生了响应的连接各 flush 一次；正在等 EPOLLOUT 的留给可写事件
+void Reactor::flush_dirty(){
+    for (const ConnRef& ref : dirty_){
+        auto it = conns_.find(ref.fd);
+        if (it == conns_.end() || it->second.id != ref.id) continue;   // 本轮已关闭
+        Conn& c = it->second;
+        c.dirty = false;
+        if (!c.want_write && (!flush(c) || finished(c))) close_conn(ref.fd);
+    }
+    dirty_.clear();
+}
+
+// =====================================================
+// flush(c)
+// 功能：把发送队列中未发送的段尽量写出，每次 sendmsg 最多带 MAX_IOV 段
+//   - 全部写完：只留第一段（清空）复用，其余还给池，取消 EPOLLOUT
+//   - 遇到 EAGAIN：记下发到哪一段的哪个位置，关注 EPOLLOUT
+// 返回：false 表示 sendmsg 出错（连接应关闭）
+// =====================================================
+bool Reactor::flush(Conn& c){
+    while (c.out_seg < c.out.size()){
+        iovec iov[MAX_IOV];
+        int n = 0;
+        for (size_t i = c.out_seg; i < c.out.size() && n < MAX_IOV; ++i){
+            size_t off = i == c.out_seg ? c.out_off : 0;
+            if (c.out[i].size() > off) iov[n++] = iovec{c.out[i].data() + off, c.out[i].size() - off};
+        }
+        if (n == 0) break;                         // 剩下的都是空段
+
+        msghdr msg{};
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = (size_t)n;
+        note_syscall();
+        ssize_t w = ::sendmsg(c.fd, &msg, MSG_NOSIGNAL);
+        if (w > 0){
+            if (io_) io_->bytes_out.fetch_add((uint64_t)w, std::memory_order_relaxed);
+            // 按写出的字节数推进 (out_seg, out_off)，顺带跳过空段
+            size_t left = (size_t)w;
+            while (left > 0){
+                size_t rem = c.out[c.out_seg].size() - c.out_off;
+                if (left < rem){ c.out_off += left; break; }
+                left -= rem;
+                ++c.out_seg;
+                c.out_off = 0;
+            }
+            continue;
+        }
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            maybe_resume(c);
+            update_events(c, true);
+            return true;
+        }
+        return false;
+    }
+    for (size_t i = 1; i < c.out.size(); ++i) BufferPool::release(std::move(c.out[i]));
+    c.out.resize(1);
+    c.out[0].clear();
+    c.out_seg = 0;
+    c.out_off = 0;
+    maybe_resume(c);
+    update_events(c, false);
+    return true;
+}
+
+// 暂停中且已降到低水位：恢复读取（EPOLLIN 由随后的 update_events 加回），本轮结束时切已收下的帧
+void Reactor::maybe_resume(Conn& c){
+    if (!c.paused || c.pending() > OUT_LOW_WATER) return;
+    c.paused = false;
+    resumed_.push_back(ConnRef{c.fd, c.id});
+}
+
+void Reactor::update_events(Conn& c, bool want_write){
+    c.want_write = want_write;
+    uint32_t events = (c.paused || c.eof ? 0u : (uint32_t)EPOLLIN) | (want_write ? (uint32_t)EPOLLOUT : 0u);
+    if (events == c.events) return;
+    epoll_event ev{};
+    ev.events  = events;
+    ev.data.fd = c.fd;
+    note_syscall();
+    if (::epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev) < 0) perror("epoll_ctl MOD");
+    c.events = events;
+}
+
+void Reactor::close_conn(socket_t fd){
+    auto it = conns_.find(fd);
+    if (it == conns_.end()) return;
+    uint64_t id = it->second.id;
+    ::epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+    CLOSESOCK(fd);
+    note_syscall(2);
+    BufferPool::release(std::move(it->second.in));
+    for (auto& seg : it->second.out) BufferPool::release(std::move(seg));
+    conns_.erase(it);
+    if (io_) io_->connections.fetch_sub(1, std::memory_order_relaxed);
+    if (on_close_) on_close_(ConnRef{fd, id});
+}
+
+} // namespace rpc
+
+#endif // __linux__
@@ -0,0 +1,104 @@
+#include "rpc/response_cache.h"
+#include "rpc/frame.h"
+#include <algorithm>
+#include <functional>
+
+namespace rpc {
+
+// =====================================================
+// ResponseCache: 分片 LRU
+//   查找：拼出 key（复用线程局部缓冲区）→ 哈希选分片 → 分片锁内查表
+//         过期 → 删除并按未命中处理；命中 → 移到链头，在锁内直接编帧（不复制出 payload）
+//   插入：已有同 key 则替换；新条目放链头，分片超出容量时从链尾淘汰
+// 每条按 key + payload + 固定开销计费，开销粗略覆盖链表节点与哈希桶
+// =====================================================
+
+static constexpr size_t NODE_OVERHEAD = 96;
+
+// key = VERSION(1B) + 请求 payload；v1/v2 的响应编码不同，不能共用条目
+static std::string_view make_key(uint8_t ver, const uint8_t* args, size_t n){
+    thread_local std::string key;
+    key.assign(1, (char)ver);
+    key.append((const char*)args, n);
+    return key;
+}
+
+static size_t shard_of(std::string_view key){
+    return std::hash<std::string_view>{}(key) % ResponseCache::SHARDS;
+}
+
+ResponseCache::ResponseCache(std::chrono::milliseconds ttl, size_t max_bytes)
+    : ttl_(ttl), shard_bytes_(max_bytes / SHARDS), shards_(new Shard[SHARDS]) {}
+
+size_t ResponseCache::charge(const Node& n){
+    return n.key.size() + n.payload.size() + NODE_OVERHEAD;
+}
+
+// 调用方持有 s.mu
+void ResponseCache::erase(Shard& s, Lru::iterator it){
+    s.bytes -= charge(*it);
+    s.index.erase(std::string_view(it->key));
+    s.lru.erase(it);
+}
+
+bool ResponseCache::lookup(uint8_t ver, const uint8_t* args, size_t args_len, uint32_t req_id,
+                           std::vector<uint8_t>& out){
+    std::string_view key = make_key(ver, args, args_len);
+    Shard& s = shards_[shard_of(key)];
+    std::lock_guard<std::mutex> lk(s.mu);
+    auto it = s.index.find(key);
+    if (it == s.index.end()){
+        ++s.misses;
+        return false;
+    }
+    Lru::iterator node = it->second;
+    if (clock::now() >= node->expires){
+        erase(s, node);
+        ++s.misses;
+        return false;
+    }
+    s.lru.splice(s.lru.begin(), s.lru, node);
+    append_encoded_response_frame(req_id, node->payload.data(), node->payload.size(), out, ver);
+    ++s.hits;
+    return true;
+}
+
+void ResponseCache::insert(uint8_t ver, const uint8_t* args, size_t args_len,
+                           const uint8_t* rsp_payload, size_t rsp_len){
+    std::string_view key = make_key(ver, args, args_len);
+    if (key.size() + rsp_len + NODE_OVERHEAD > shard_bytes_) return;
+
+    // 节点在锁外构造好（两次分配），锁内只做链表/哈希表操作
+    Lru fresh;
+    fresh.push_front(Node{std::string(key), std::vector<uint8_t>(rsp_payload, rsp_payload + rsp_len),
+                          clock::now() + ttl_});
+    size_t cost = charge(fresh.front());
+
+    Shard& s = shards_[shard_of(key)];
+    std::lock_guard<std::mutex> lk(s.mu);
+    auto it = s.index.find(key);
+    if (it != s.index.end()) erase(s, it->second);     // 并发未命中的请求各自算了一遍：留最新的
+    while (!s.lru.empty() && s.bytes + cost > shard_bytes_){
+        erase(s, std::prev(s.lru.end()));
+        ++s.evictions;
+    }
+    s.lru.splice(s.lru.begin(), fresh);
+    s.index.emplace(std::string_view(s.lru.front().key), s.lru.begin());
+    s.bytes += cost;
+}
+
+ResponseCache::Stats ResponseCache::stats() const {
+    Stats st;
+    for (size_t i = 0; i < SHARDS; ++i){
+        const Shard& s = shards_[i];
+        std::lock_guard<std::mutex> lk(s.mu);
+        st.hits      += s.hits;
+        st.misses    += s.misses;
+        st.evictions += s.evictions;
+        st.entries   += s.lru.size();
+        st.bytes     += s.bytes;
+    }
+    return st;
+}
+
+} // namespace rpc
@@ -1,134 +1,1181 @@
 #include "rpc/server.h"
+#include "rpc/arena.h"
+#include "rpc/buffer_pool.h"
 #include "rpc/net.h"
+#include "rpc/reactor.h"
+#include "rpc/transport.h"
+#include "rpc/uring_reactor.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#ifdef __linux__
+  #include <pthread.h>
+  #include <sched.h>
+#endif
 
 namespace rpc {
 
 // =====================================================
 // RpcServer: 简易 RPC 服务端
 // 职责：
-//   - 监听指定端口，接受客户端 TCP 连接
+//   - 监听指定端口（或 UNIX socket / 共享内存端点），接受客户端连接
 //   - 解析收到的请求帧 → 调用已注册的方法 → 回包
-//   - 每个客户端连接由独立线程处理（演示用）
+//   - THREAD_PER_CONN：每个客户端连接由独立线程处理（演示用）
+//   - EPOLL：所有连接由一个 Reactor 事件循环处理（见 reactor.cpp）
+//   - URING：同上，I/O 走 io_uring（见 uring_reactor.cpp）
+//   - 多事件循环（set_reactors）：N 个线程各跑一个事件循环，SO_REUSEPORT 由内核分配连接
+//   - 可选工作线程池：handler 不在 I/O 线程执行，响应乱序写回
+//   - 流式调用：同一 req_id 下多帧收发，按额度做流控（见 StreamState）
+//   - 截止时间：帧头超时在收到时换算为本地截止时间，出队执行前检查，过期回 status=4
+//   - 统计：每个请求在接收时 on_start、回包前 on_finish（见 metrics.cpp），__stats 查询
+//   - 协程方法：在 I/O 线程启动，挂起期间不占线程，完成后回包（见 start_coro）
 //
 // 输入来源：客户端发来的二进制帧（frame）
-// 输出对象：返回的二进制帧（response frame）写回到 TCP 连接
+// 输出对象：返回的二进制帧（response frame）写回到同一连接
 // =====================================================
 
-RpcServer::RpcServer(uint16_t port) : port_(port) {}
+// 本服务端支持的特性位（__hello 协商时与客户端请求的取交集）
+static constexpr uint32_t SERVER_FEATURES = FEATURE_METHOD_ID | FEATURE_BATCH | FEATURE_DEADLINE;
+// 客户端开启方法 ID 后，__stats 按 ID 发送
+static constexpr uint32_t STATS_METHOD_ID = method_id_of(STATS_METHOD);
+// 一连接一线程模式下攒着不写的响应上限：超过就先写出，不等接收缓冲区读空
+static constexpr size_t MAX_DEFERRED_OUT = 64 * 1024;
 
-// 析构：关闭监听 fd（若已打开）
-RpcServer::~RpcServer(){ if (listen_fd_>=0) close_fd(listen_fd_); }
+using clock_type = ServerMetrics::clock;
+
+// 构造错误响应（未知方法 / 忙 / 过载）
+static Response error_response(uint32_t req_id, uint8_t status, std::string msg){
+    Response rsp;
+    rsp.req_id = req_id;
+    rsp.status = status;
+    rsp.err_msg = std::move(msg);
+    rsp.has_result = false;
+    return rsp;
+}
+
+static Response unknown_method(uint32_t req_id, std::string_view method, uint32_t method_id){
+    return error_response(req_id, 1, method_id ? "unknown method id: " + std::to_string(method_id)
+                                               : "unknown method: " + std::string(method));
+}
+
+// 帧头超时 → 本地截止时间（以收到帧的时刻为起点）；不带超时 → 无截止时间
+static Deadline deadline_of(const RawFrameView& rf, clock_type::time_point received){
+    if (rf.timeout_ms == NO_TIMEOUT) return Deadline{};
+    return received + std::chrono::milliseconds(rf.timeout_ms);
+}
+
+static bool expired(Deadline d){
+    return has_deadline(d) && std::chrono::steady_clock::now() >= d;
+}
+
+// 一连接一线程模式下的连接写端：I/O 线程与 worker 共享
+// 合并写：同一时刻只有一个线程在写 socket，其间别的线程交来的帧追加到 pending 后立即返回，
+// 由正在写的线程写完手头的一批后整批带走；并发完成的响应因此合并成一次 write
+// 帧不会交错；最后一个持有者释放时关闭连接
+// 写失败（对端已走）只标记关闭，不能让迟到的 worker 响应拖垮整个进程
+struct ConnWriter {
+    ConnWriter(std::shared_ptr<Conn> c, IoCounters& counters) : conn(std::move(c)), io(counters) {}
+    void write(const std::vector<uint8_t>& frame){
+        std::unique_lock<std::mutex> lk(mu);
+        if (closed) return;
+        if (writing){
+            pending.insert(pending.end(), frame.begin(), frame.end());
+            return;
+        }
+        writing = true;
+        const uint8_t* p = frame.data();
+        size_t n = frame.size();
+        while (true){
+            lk.unlock();
+            bool ok = conn->write(p, n);
+            lk.lock();
+            if (ok) io.bytes_out.fetch_add(n, std::memory_order_relaxed);
+            else closed = true;
+            if (closed || pending.empty()) break;
+            batch.swap(pending);     // batch 只由持有 writing 的线程访问
+            pending.clear();
+            p = batch.data();
+            n = batch.size();
+        }
+        pending.clear();
+        writing = false;
+    }
+    void mark_closed(){
+        std::lock_guard<std::mutex> lk(mu);
+        closed = true;               // 对端已关闭：迟到的 worker 响应直接丢弃
+    }
+    std::shared_ptr<Conn> conn;
+    IoCounters& io;
+    std::mutex mu;
+    bool closed{false};
+    bool writing{false};             // 有线程正在 conn->write（不持锁）
+    std::vector<uint8_t> pending;    // 写的期间交来的帧
+    std::vector<uint8_t> batch;      // 正在写的那一批（与 pending 交换复用容量）
+};
+
+// =====================================================
+// StreamState: 一个进行中的流
+//   服务端流（upload=false）：credit 为还能发送的块数，STREAM_CREDIT 增加，write 减少
+//   客户端流（upload=true） ：q 为已到达未消费的块，最多 STREAM_WINDOW 块
+//   cancelled：连接关闭 / 对端取消 / 对端违反流控
+// =====================================================
+struct StreamState {
+    std::mutex mu;
+    std::condition_variable cv;
+    bool upload{false};
+    uint64_t credit{STREAM_WINDOW};
+    std::deque<Value> q;
+    bool ended{false};
+    bool cancelled{false};
+};
+
+StreamWriter::StreamWriter(uint32_t req_id, uint8_t ver,
+                           std::function<void(std::vector<uint8_t>&&)> reply,
+                           std::shared_ptr<StreamState> st)
+    : req_id_(req_id), ver_(ver), reply_(std::move(reply)), st_(std::move(st)) {}
+
+// 额度为 0 时阻塞；拿到额度后在锁外编码并发送
+bool StreamWriter::write(const Value& chunk){
+    {
+        std::unique_lock<std::mutex> lk(st_->mu);
+        st_->cv.wait(lk, [this]{ return st_->credit > 0 || st_->cancelled; });
+        if (st_->cancelled) return false;
+        --st_->credit;
+    }
+    std::vector<uint8_t> bytes = BufferPool::acquire();
+    append_stream_data_frame(req_id_, chunk, bytes, ver_);
+    reply_(std::move(bytes));
+    return true;
+}
+
+bool StreamWriter::cancelled() const {
+    std::lock_guard<std::mutex> lk(st_->mu);
+    return st_->cancelled;
+}
+
+StreamReader::StreamReader(uint32_t req_id, uint8_t ver,
+                           std::function<void(std::vector<uint8_t>&&)> reply,
+                           std::shared_ptr<StreamState> st)
+    : req_id_(req_id), ver_(ver), reply_(std::move(reply)), st_(std::move(st)) {}
+
+// 队列为空时阻塞；每消费半个窗口回一次额度（批量回，减少控制帧）
+bool StreamReader::next(Value& out){
+    {
+        std::unique_lock<std::mutex> lk(st_->mu);
+        st_->cv.wait(lk, [this]{ return !st_->q.empty() || st_->ended || st_->cancelled; });
+        if (st_->q.empty()) return false;
+        out = std::move(st_->q.front());
+        st_->q.pop_front();
+    }
+    if (++consumed_ >= STREAM_WINDOW / 2){
+        std::vector<uint8_t> bytes = BufferPool::acquire();
+        append_stream_credit_frame(req_id_, consumed_, bytes, ver_);
+        reply_(std::move(bytes));
+        consumed_ = 0;
+    }
+    return true;
+}
+
+RpcServer::RpcServer(uint16_t port, ServeMode mode)
+    : RpcServer(Endpoint::tcp("0.0.0.0", port), mode) {}
+
+RpcServer::RpcServer(Endpoint ep, ServeMode mode) : ep_(std::move(ep)), mode_(mode) {
+    tables_.push_back(std::make_unique<DispatchTable>());
+    table_.store(tables_.back().get(), std::memory_order_release);
+}
+
+// 析构：停止统计输出线程，关闭监听 socket（若已打开；UNIX/SHM 的 socket 文件随之删除）
+RpcServer::~RpcServer(){
+    {
+        std::lock_guard<std::mutex> lk(dump_mu_);
+        stop_dump_ = true;
+    }
+    dump_cv_.notify_all();
+    if (dumper_.joinable()) dumper_.join();
+    listener_.reset();
+}
 
 // =====================================================
 // register_method(name, handler)
 // 功能：注册一个 RPC 方法及其处理函数
 // 输入：name 方法名；handler 签名为 Response(const Request&)
+//       opt.max_concurrency 该方法的并发上限（0 = 不限）
 // 输出：无；内部会覆盖同名方法
-// 线程安全：用互斥锁保护 handlers_
+// 失败：方法 ID（名字哈希）与另一个已注册方法冲突 → throw runtime_error
+// 线程安全：注册之间用 mu_ 串行；与请求处理并发安全（见 install）
+// =====================================================
+void RpcServer::register_method(const std::string& name, Handler h, MethodOptions opt){
+    auto e = make_entry(name, opt, true);
+    e->h = std::move(h);
+    install(std::move(e));
+}
+
+// =====================================================
+// register_method_view(name, handler)
+// 功能：注册零拷贝 handler，签名为 Response(const RequestView&)
+//       参数中的 method/字符串都是指向接收缓冲区的 string_view，
+//       只读参数的 handler 整个请求路径不产生堆分配
+// =====================================================
+void RpcServer::register_method_view(const std::string& name, ViewHandler h, MethodOptions opt){
+    auto e = make_entry(name, opt, true);
+    e->vh = std::move(h);
+    install(std::move(e));
+}
+
+// =====================================================
+// register_method_raw(name, handler)
+// 功能：注册原始 handler，签名为 Response(const RawFrameView&)，payload 由 handler 自己解析
+//       bind 生成的类型化 handler 就注册在这里
+// =====================================================
+void RpcServer::register_method_raw(const std::string& name, RawHandler h, MethodOptions opt){
+    auto e = make_entry(name, opt, true);
+    e->rh = std::move(h);
+    install(std::move(e));
+}
+
+// =====================================================
+// register_server_stream(name, handler) / register_client_stream(name, handler)
+// 功能：注册流式方法
+//   服务端流：handler 经 StreamWriter 逐块发送，返回值随 STREAM_END 发出
+//   客户端流：handler 经 StreamReader 逐块读取上传数据，返回值作为普通响应
+// 注意：流式方法不能放进 BATCH（该项回 status=2）
+// =====================================================
+void RpcServer::register_server_stream(const std::string& name, ServerStreamHandler h,
+                                       MethodOptions opt){
+    auto e = make_entry(name, opt);
+    e->ssh = std::move(h);
+    install(std::move(e));
+}
+
+void RpcServer::register_client_stream(const std::string& name, ClientStreamHandler h,
+                                       MethodOptions opt){
+    auto e = make_entry(name, opt);
+    e->csh = std::move(h);
+    install(std::move(e));
+}
+
+#ifdef TINY_RPC_COROUTINES
+// =====================================================
+// register_coro(name, handler)
+// 功能：注册协程方法，handler 返回 Task<Response>
+//   在收到请求的 I/O 线程上启动（不进线程池），co_await 下游调用时挂起；
+//   事件循环模式下恢复也回到事件循环线程，上千个并发扇出调用只占一个线程
+// 注意：协程方法同流式方法一样不能放进 BATCH
+// =====================================================
+void RpcServer::register_coro(const std::string& name, CoroHandler h, MethodOptions opt){
+    auto e = make_entry(name, opt);
+    e->ch = std::move(h);
+    install(std::move(e));
+}
+#endif
+
+std::shared_ptr<RpcServer::Entry> RpcServer::make_entry(const std::string& name,
+                                                        const MethodOptions& opt, bool cacheable){
+    auto e = std::make_shared<Entry>();
+    e->name = name;
+    e->id   = method_id_of(name);
+    e->max_concurrency = opt.max_concurrency;
+    if (cacheable && opt.cache_ttl.count() > 0)
+        e->cache = std::make_unique<ResponseCache>(opt.cache_ttl, opt.cache_max_bytes);
+    e->slot = metrics_.add_method(name);
+    return e;
+}
+
 // =====================================================
-void RpcServer::register_method(const std::string& name, Handler h){
+// set_workers(threads, queue_capacity)
+// 功能：创建工作线程池；之后 handler 都在池中执行
+// 注意：应在 serve() 之前调用（请求路径读取 pool_ 不加锁）
+// =====================================================
+void RpcServer::set_workers(size_t threads, size_t queue_capacity){
+    pool_ = threads ? std::make_unique<ThreadPool>(threads, queue_capacity) : nullptr;
+}
+
+// 各事件循环的 I/O 计数在这里一次建好：serve() 期间 stats() 可能在任意线程读取
+void RpcServer::set_reactors(size_t n, bool pin_cpus){
+    reactors_ = std::max<size_t>(n, 1);
+    pin_cpus_ = pin_cpus;
+    reactor_io_.clear();
+    if (reactors_ > 1)
+        for (size_t i = 0; i < reactors_; ++i) reactor_io_.push_back(std::make_unique<ReactorIo>());
+}
+
+// 合并各线程分片与各事件循环的 I/O 计数，补上线程池排队数
+StatsSnapshot RpcServer::stats() const {
+    StatsSnapshot s = metrics_.snapshot();
+    for (auto& r : reactor_io_){
+        s.connections += r->io.connections.load(std::memory_order_relaxed);
+        s.accepted    += r->io.accepted.load(std::memory_order_relaxed);
+        s.bytes_in    += r->io.bytes_in.load(std::memory_order_relaxed);
+        s.bytes_out   += r->io.bytes_out.load(std::memory_order_relaxed);
+        s.syscalls    += r->io.syscalls.load(std::memory_order_relaxed);
+    }
+    s.queue_depth = pool_ ? pool_->queue_depth() : 0;
+    return s;
+}
+
+// 周期性统计输出：附带与上一次快照之间的调用速率，找热点方法
+void RpcServer::dump_loop(){
+    StatsSnapshot prev = stats();
+    std::unique_lock<std::mutex> lk(dump_mu_);
+    while (!dump_cv_.wait_for(lk, dump_interval_, [this]{ return stop_dump_; })){
+        lk.unlock();
+        StatsSnapshot cur = stats();
+        std::cerr << cur.to_text(&prev);
+        prev = std::move(cur);
+        lk.lock();
+    }
+}
+
+// =====================================================
+// install(e)
+// 功能：copy-on-write 更新分发表
+//   1) 在 mu_ 下复制当前表，替换/加入 e，重建两个索引
+//   2) release-store 新表指针；正在处理的请求继续用旧表，旧表保留到析构
+// =====================================================
+void RpcServer::install(std::shared_ptr<const Entry> e){
     std::lock_guard<std::mutex> lk(mu_);
-    handlers_[name] = std::move(h);
+    const DispatchTable* cur = table_.load(std::memory_order_relaxed);
+
+    auto next = std::make_unique<DispatchTable>();
+    for (auto& old : cur->entries){
+        if (old->name == e->name) continue;        // 同名覆盖
+        if (old->id == e->id)
+            throw std::runtime_error("method id collision: " + old->name + " vs " + e->name);
+        next->entries.push_back(old);
+    }
+    next->entries.push_back(std::move(e));
+    for (auto& x : next->entries){
+        next->by_name.emplace(x->name, x.get());
+        next->by_id.emplace(x->id, x.get());
+    }
+
+    tables_.push_back(std::move(next));
+    table_.store(tables_.back().get(), std::memory_order_release);
 }
 
 // =====================================================
 // serve()
-// 功能：启动服务端主循环
-// 步骤：tcp_listen -> 打印监听日志 -> accept 循环
-//       每来一个连接就开线程 handle_client
-//
-// 输入：无（使用构造传入的 port_）
-// 输出：无（阻塞运行；如需退出可在外层中断进程或扩展退出条件）
-// 失败：底层 socket 出错会 die() 退出；accept 失败则打日志继续
+// 功能：启动服务端主循环，按 mode_ 选择实现
+//   - THREAD_PER_CONN → serve_threaded()
+//   - EPOLL           → serve_reactor<Reactor>()（非 Linux 平台回退为一连接一线程）
+//   - URING           → serve_reactor<UringReactor>()（未编译 / 内核不支持时回退 EPOLL）
+//   - EPOLL/URING 且 set_reactors(n > 1)、TCP 端点 → serve_sharded()；其它情况只用一个事件循环
 // =====================================================
 void RpcServer::serve(){
-    listen_fd_ = tcp_listen(port_);
-    std::cout << "[server] listening on 0.0.0.0:" << port_ << "\n";
+    bool event_loop = mode_ == ServeMode::EPOLL || mode_ == ServeMode::URING;
+    bool sharded = false;
+#ifdef __linux__
+    sharded = event_loop && reactors_ > 1 && ep_.kind == TransportKind::TCP;
+#endif
+    if (reactors_ > 1 && !sharded)
+        std::cerr << "[server] multiple reactors need epoll/uring mode on a TCP endpoint (Linux), using one\n";
+    if (!sharded) listener_ = listen_on(ep_);
+    if (dump_interval_.count() > 0 && !dumper_.joinable())
+        dumper_ = std::thread(&RpcServer::dump_loop, this);
+#ifdef __linux__
+    if (sharded){
+        serve_sharded();
+        return;
+    }
+    if (event_loop && listener_->supports_reactor()){
+        run_event_loop(listener_->fd(), metrics_.io, 0);
+        return;
+    }
+    if (event_loop)
+        std::cerr << "[server] event loop does not apply to shm transport, using threads\n";
+#else
+    if (event_loop)
+        std::cerr << "[server] event loop modes unavailable on this platform, using threads\n";
+#endif
+    std::cout << "[server] listening on " << ep_.str() << "\n";
+    serve_threaded();
+}
+
+// =====================================================
+// serve_threaded()
+// 功能：accept 循环，每来一个连接就开线程：先完成传输层握手（SHM），再 handle_client
+// 失败：底层 socket 出错会 die() 退出；accept / 共享内存握手失败则打日志继续
+// =====================================================
+void RpcServer::serve_threaded(){
     while (true){
-        sockaddr_in cli{}; socklen_t len = sizeof(cli);
-        int cfd = ::accept(listen_fd_, (sockaddr*)&cli, &len);
-        if (cfd < 0) { perror("accept"); continue; }
-        // 生产环境建议使用线程池或事件驱动；这里演示用每连接一线程
-        std::thread(&RpcServer::handle_client, this, cfd).detach();
+        Listener::Handshake hs = listener_->accept();
+        if (!hs) continue;
+        // 生产环境建议使用线程池或事件驱动（见 serve_epoll）；这里演示用每连接一线程
+        // 传输层握手（SHM）也在连接线程上做，慢客户端不耽误 accept 下一个连接
+        std::thread([this, hs = std::move(hs)]{
+            std::shared_ptr<Conn> c = hs();
+            if (c) handle_client(std::move(c));
+        }).detach();
     }
 }
 
+#ifdef __linux__
+// 进程可用的 CPU 编号（按编号顺序）；取不到返回空
+static std::vector<int> allowed_cpus(){
+    std::vector<int> cpus;
+    cpu_set_t set;
+    if (::sched_getaffinity(0, sizeof(set), &set) != 0){
+        perror("sched_getaffinity");
+        return cpus;
+    }
+    for (int c = 0; c < CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, &set)) cpus.push_back(c);
+    return cpus;
+}
+
+// 把当前线程绑到 cpu；失败只打日志（照常运行，只是不绑核）
+static void pin_to_cpu(int cpu, size_t index){
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(cpu, &one);
+    int rc = ::pthread_setaffinity_np(::pthread_self(), sizeof(one), &one);
+    if (rc != 0)
+        std::cerr << "[server] pin reactor " << index << " to cpu " << cpu << ": " << std::strerror(rc) << "\n";
+}
+#endif
+
+// =====================================================
+// serve_sharded()
+// 功能：thread-per-core 多事件循环
+//   1) 先在 ep_.host:ep_.port 上建好 reactors_ 个 SO_REUSEPORT 监听 socket（bind 失败时 die()，此时还没有线程在跑）
+//   2) 第 0 个事件循环在当前线程运行，其余各开一个线程；pin_cpus_ 时第 i 个绑到第 i 个可用 CPU
+//   3) 每个事件循环有自己的连接表、发送队列与 I/O 计数，连接从 accept 到关闭只在一个线程上；
+//      请求路径上共享的只有只读的分发表（统计按线程分片，见 ServerMetrics）
+// 事件循环不返回（与单事件循环相同），线程随进程退出
+// =====================================================
+void RpcServer::serve_sharded(){
+#ifdef __linux__
+    std::vector<socket_t> fds;
+    for (size_t i = 0; i < reactors_; ++i) fds.push_back(tcp_listen(ep_.host, ep_.port, true));
+    std::vector<int> cpus = pin_cpus_ ? allowed_cpus() : std::vector<int>();
+
+    std::vector<std::thread> loops;
+    for (size_t i = 1; i < reactors_; ++i){
+        loops.emplace_back([this, &fds, &cpus, i]{
+            if (!cpus.empty()) pin_to_cpu(cpus[i % cpus.size()], i);
+            run_event_loop(fds[i], reactor_io_[i]->io, i);
+        });
+    }
+    if (!cpus.empty()) pin_to_cpu(cpus[0], 0);
+    run_event_loop(fds[0], reactor_io_[0]->io, 0);
+
+    for (auto& t : loops) t.join();
+    for (socket_t fd : fds) close_fd(fd);
+#endif
+}
+
+// URING 先试 io_uring：构造失败（未编译 / 内核不支持）时回退 epoll，此时尚未接受任何连接
+void RpcServer::run_event_loop(socket_t listen_fd, IoCounters& io, size_t index){
+#ifdef __linux__
+    if (mode_ == ServeMode::URING){
+        try{
+            serve_reactor<UringReactor>(listen_fd, io, index);
+            return;
+        }catch(const std::exception& e){
+            std::cerr << "[server] io_uring unavailable (" << e.what() << "), using epoll\n";
+        }
+    }
+    serve_reactor<Reactor>(listen_fd, io, index);
+#else
+    (void)listen_fd; (void)io; (void)index;
+#endif
+}
+
 // =====================================================
-// handle_client(cfd)
-// 功能：单连接读写循环
+// serve_reactor<R>(listen_fd, io, index)
+// 功能：把监听 fd 交给 R（Reactor / UringReactor），由单线程事件循环处理它接受的全部连接
+//       每解析出一帧就回调 process_frame，响应追加到连接发送缓冲区
+// 失败：R 的构造函数抛出（如内核不支持 io_uring）时原样抛给 run_event_loop，此时尚未接受任何连接
+// =====================================================
+template <class R>
+void RpcServer::serve_reactor(socket_t listen_fd, IoCounters& io, size_t index){
+#ifdef __linux__
+    // 连接上下文只在事件循环线程里增删，按连接 id 索引（fd 会被复用）
+    std::unordered_map<uint64_t, ConnPtr> conns;
+    R* rp = nullptr;
+    R r(listen_fd, [this, &rp, &conns](Reactor::ConnRef ref, const RawFrameView& rf,
+                                     std::vector<uint8_t>& out){
+        ConnPtr& conn = conns[ref.id];
+        if (!conn){
+            conn = std::make_shared<ConnCtx>();
+            // worker/流线程的响应经 eventfd 交回事件循环线程
+            conn->reply = [rp, ref](std::vector<uint8_t>&& bytes){ rp->post(ref, std::move(bytes)); };
+            conn->hold = [rp, ref]{ rp->hold(ref); };
+            conn->unhold = [rp, ref]{ rp->unhold(ref); };
+        }
+        process_frame(rf, out, conn);
+    });
+    r.set_io_counters(&io);
+    r.set_on_close([&conns](Reactor::ConnRef ref){
+        auto it = conns.find(ref.id);
+        if (it == conns.end()) return;
+        cancel_streams(*it->second);
+        conns.erase(it);
+    });
+    rp = &r;
+#ifdef TINY_RPC_COROUTINES
+    // 协程在事件循环线程上挂起：响应到达后经 dispatch 回到这里恢复
+    Executor loop = [&r](std::function<void()> fn){ r.dispatch(std::move(fn)); };
+    ExecutorScope scope(&loop);
+#endif
+    // 多个事件循环同时启动：整行拼好再输出，避免交错
+    std::string banner = "[server] listening on " + ep_.str() +
+                         (std::is_same<R, UringReactor>::value ? " (io_uring" : " (epoll");
+    if (reactors_ > 1) banner += ", reactor " + std::to_string(index);
+    std::cout << banner + ")\n";
+    r.run();
+#else
+    (void)listen_fd; (void)io; (void)index;
+#endif
+}
+
+// =====================================================
+// handle_client(c)
+// 功能：单连接读写循环（一连接一线程模式）
 // 流程：
-//   1) 读取一帧 -> 解析为 RawFrame
-//   2) 若是 REQUEST：解析 payload → 定位 handler → 执行 → 回包
-//   3) 非 REQUEST 或解析异常：返回错误 Response
-//   4) 对端关闭：结束循环，关闭 cfd
+//   1) 读取一帧 body 到复用缓冲区 -> 零拷贝解析为 RawFrameView
+//   2) 交给 process_frame 生成响应帧
+//   3) 有响应则写回；接收缓冲区里还有后续请求时先攒着，读空后一次写出
+//   4) 对端关闭：结束循环，最后一个 worker 回包后释放连接
 //
-// 输入：cfd 客户端连接的 fd（演示用 int，跨平台建议 socket_t）
-// 输出：无（通过 send_frame 写回响应）
-// 返回：void
-// 边界/异常：
-//   - recv_frame 返回 nullopt 视为对端关闭
-//   - 任意解析/业务异常都会被 catch，封装成 status=2 的错误响应
+// 输入：c 客户端连接（TCP / UNIX socket / 共享内存）
+// 输出：无（响应经共享的 ConnWriter 写回，worker 与 I/O 线程共用）
+// 边界：
+//   - recv_body 返回 false 视为对端关闭
+//   - 帧头非法（magic/version/长度）视为协议错误，关闭连接
 // =====================================================
-void RpcServer::handle_client(int cfd){
-    std::cout << "[server] new client fd=" << cfd << "\n";
+void RpcServer::handle_client(std::shared_ptr<Conn> c){
+    const std::string who = c->describe();
+    std::cout << "[server] new client " << who << "\n";
+    IoCounters& io = metrics_.io;
+    io.connections.fetch_add(1, std::memory_order_relaxed);
+    io.accepted.fetch_add(1, std::memory_order_relaxed);
+    auto writer = std::make_shared<ConnWriter>(c, io); // 连接在最后一个 worker 回包后才关闭
+    auto conn = std::make_shared<ConnCtx>();
+    conn->reply = [writer](std::vector<uint8_t>&& bytes){
+        writer->write(bytes);
+        BufferPool::release(std::move(bytes));
+    };
+    // 两者都跨帧复用，取自缓冲区池，连接结束时归还
+    std::vector<uint8_t> body = BufferPool::acquire(), frame = BufferPool::acquire();
     while (true){
-        // 读取一帧（含长度前缀），转为 RawFrame
-        auto rf_opt = recv_frame(cfd);
-        if (!rf_opt){
-            std::cout << "[server] client closed fd=" << cfd << "\n";
+        RawFrameView rf;
+        try{
+            // 读取一帧 body（不含长度前缀）
+            if (!recv_body(*c, body)){
+                std::cout << "[server] client closed " << who << "\n";
+                break;
+            }
+            io.bytes_in.fetch_add(4 + body.size(), std::memory_order_relaxed);
+            rf = parse_body_to_view(body.data(), body.size());
+        }catch(const std::exception& e){
+            std::cerr << "[server] protocol error " << who << ": " << e.what() << "\n";
             break;
         }
-        auto rf = *rf_opt;
 
+        // 流水线上下一帧已经完整收到：响应先攒在 frame 里，之后一次写出；
+        // 只收到半帧（大帧还在路上）时先写出，不让响应等着 recv_body 阻塞
+        process_frame(rf, frame, conn);
+        if (!frame.empty() && (!frame_buffered(*c) || frame.size() >= MAX_DEFERRED_OUT)){
+            writer->write(frame);
+            frame.clear();
+        }
+    }
+    if (!frame.empty()) writer->write(frame);   // 对端已半关闭：攒着的响应尽力写完
+    writer->mark_closed();
+    BufferPool::release(std::move(body));
+    BufferPool::release(std::move(frame));
+    cancel_streams(*conn);
+    io.connections.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// 可缓存方法的成功响应：frame 末尾刚追加的就是它的响应帧，payload 在最后 payload_size 字节
+void RpcServer::remember(const Entry& e, uint8_t ver, const uint8_t* args, size_t args_len,
+                         const Response& rsp, const std::vector<uint8_t>& frame){
+    if (!e.cache || rsp.status != 0) return;
+    size_t n = rsp.payload_size(ver);
+    e.cache->insert(ver, args, args_len, frame.data() + frame.size() - n, n);
+}
+
+// =====================================================
+// process_frame(rf, out, reply)
+// 功能：处理一帧（两种服务模式共用）
+// 流程：
+//   0) __hello：版本协商，直接回复；__stats：返回统计；BATCH 帧交给 process_batch
+//      流式帧（DATA/CREDIT/END）路由到本连接上进行中的流
+//   1) 若是 REQUEST：无锁读取分发表，按方法 ID 或 method 视图查找（不构造 std::string）
+//   2) 可缓存方法先查响应缓存，命中直接回缓存的响应字节；未命中时成功响应在编码后记入缓存
+//      方法并发上限：超出 → status=3（busy）
+//   3) 流式方法：start_stream（独立线程）；协程方法：start_coro（当前线程启动）
+//      帧头带超时时先换算出截止时间，随请求一起交给 execute（出队时检查）
+//      无线程池：内联 execute，响应追加到 out
+//      有线程池：把帧复制为 RawFrame 入队；worker 执行后编码并调用 reply 回包
+//      队列已满 → status=3（overloaded），内联回复
+//   其它类型打日志，不回包
+// 边界/异常：
+//   - 未知方法 → status=1
+//   - 任意解析/业务异常都会被 catch，封装成 status=2 的错误响应
+//   响应沿用请求帧的版本：v1 客户端永远只会收到 v1 帧
+// =====================================================
+void RpcServer::process_frame(const RawFrameView& rf, std::vector<uint8_t>& out,
+                              const ConnPtr& conn){
+    switch (rf.type){
+    case MsgType::BATCH:
+        process_batch(rf, out, conn);
+        return;
+    case MsgType::STREAM_DATA:
+    case MsgType::STREAM_CREDIT:
+    case MsgType::STREAM_END:
+        route_stream_frame(rf, *conn);
+        return;
+    default:
+        break;
+    }
+    if (rf.type != MsgType::REQUEST){
+        // 收到非请求类型帧（比如客户端实现错误）
+        std::cerr << "[server] unexpected frame type\n";
+        return;
+    }
+
+    // 0) 保留方法：版本与特性协商。回 version | (features << 8)
+    if (rf.method == HELLO_METHOD){
+        Response rsp;
+        try{
+            thread_local RequestView view;
+            parse_request_view(rf.req_id, rf.method, rf.payload, rf.payload_len, view, rf.version);
+            int64_t want  = as_i64(view.args, 0);
+            int64_t ver   = std::max<int64_t>(VERSION, std::min<int64_t>(want, MAX_VERSION));
+            int64_t feats = view.args.size() > 1 ? as_i64(view.args, 1) & SERVER_FEATURES : 0;
+            rsp.status = 0;
+            rsp.has_result = true;
+            rsp.result = Value::make_int(ver | (feats << 8));
+            rsp.req_id = rf.req_id;
+        }catch(const std::exception& e){
+            rsp = error_response(rf.req_id, 2, std::string("server exception: ") + e.what());
+        }
+        append_response_frame(rsp, out, rf.version);
+        return;
+    }
+    if (rf.method == STATS_METHOD || (rf.method_id && rf.method_id == STATS_METHOD_ID)){
+        Response rsp;
+        rsp.req_id = rf.req_id;
+        rsp.status = 0;
+        rsp.has_result = true;
+        rsp.result = stats().to_value();
+        append_response_frame(rsp, out, rf.version);
+        return;
+    }
+
+    auto received = clock_type::now();
+    Deadline deadline = deadline_of(rf, received);
+
+    // 1) 查找处理函数
+    const Entry* e = lookup(rf.method, rf.method_id);
+    if (!e){
+        metrics_.on_unknown();
+        append_response_frame(unknown_method(rf.req_id, rf.method, rf.method_id), out, rf.version);
+        return;
+    }
+    metrics_.on_start(e->slot);
+
+    // 2) 可缓存方法：命中则直接回已编码的响应（不占并发名额，不解码、不执行、不编码）
+    if (e->cache && e->cache->lookup(rf.version, rf.payload, rf.payload_len, rf.req_id, out)){
+        metrics_.on_cached(e->slot, received);
+        return;
+    }
+
+    // 2') 方法并发上限：先占位，超出则回 busy
+    if (!acquire(*e)){
+        metrics_.on_finish(e->slot, 3, received);
+        append_response_frame(error_response(rf.req_id, 3, "method busy: " + e->name),
+                              out, rf.version);
+        return;
+    }
+
+    // 3) 流式方法：名额在流结束时归还
+    if (e->ssh || e->csh){
+        start_stream(rf, e, out, conn, received, deadline);
+        return;
+    }
+#ifdef TINY_RPC_COROUTINES
+    // 3') 协程方法：不进线程池，挂起时不占线程
+    if (e->ch){
+        start_coro(rf, e, out, conn, received, deadline);
+        return;
+    }
+#endif
+
+    // 3a) 内联执行
+    if (!pool_){
+        Response rsp = execute(*e, rf, deadline);
+        metrics_.on_finish(e->slot, rsp.status, received);
+        append_response_frame(rsp, out, rf.version);
+        remember(*e, rf.version, rf.payload, rf.payload_len, rsp, out);
+        release(*e);
+        return;
+    }
+
+    // 3b) 交给线程池：帧视图只在本次回调内有效，payload 复制到池化缓冲区后入队
+    //     Entry 所在的分发表不回收，worker 持有裸指针是安全的
+    //     任务只捕获一个裸指针，std::function 不必再为闭包分配；响应同样编码进池化缓冲区
+    struct PoolJob {
+        RpcServer* self;
+        const Entry* e;
+        ConnPtr conn;
+        std::vector<uint8_t> payload;
+        MsgType type;
+        uint32_t req_id;
+        uint8_t version;
+        uint32_t method_id;
+        ServerMetrics::clock::time_point received;
+        Deadline deadline;
+    };
+    auto* job = new PoolJob{this, e, conn, BufferPool::acquire(rf.payload_len), rf.type,
+                            rf.req_id, rf.version, rf.method_id, received, deadline};
+    job->payload.assign(rf.payload, rf.payload + rf.payload_len);
+    conn->begin_async();
+    bool queued = pool_->try_submit([job]{
+        std::unique_ptr<PoolJob> j(job);
+        RawFrameView v{j->type, j->req_id, j->e->name, j->payload.data(),
+                       j->payload.size(), j->version, j->method_id};
+        Response rsp = j->self->execute(*j->e, v, j->deadline);
+        j->self->metrics_.on_finish(j->e->slot, rsp.status, j->received);
+        std::vector<uint8_t> bytes = BufferPool::acquire();
+        append_response_frame(rsp, bytes, v.version);
+        remember(*j->e, v.version, v.payload, v.payload_len, rsp, bytes);
+        BufferPool::release(std::move(j->payload));
+        j->self->release(*j->e);
+        j->conn->reply(std::move(bytes));
+        j->conn->end_async();
+    });
+    if (!queued){
+        conn->end_async();
+        BufferPool::release(std::move(job->payload));
+        delete job;
+        metrics_.on_finish(e->slot, 3, received);
+        release(*e);
+        append_response_frame(error_response(rf.req_id, 3, "server overloaded"), out, rf.version);
+    }
+}
+
+// 一批请求在线程池中执行时的共享状态：最后完成的一项负责编码并回包（并归还 hold）
+struct BatchState {
+    uint32_t batch_id{};
+    uint8_t version{};
+    std::vector<uint8_t> payload;        // 整批 payload 的拷贝，items 指向这里
+    std::vector<BatchItemView> items;
+    std::vector<Response> rsps;          // 与 items 按下标对应，各项只写自己的槽位
+    std::atomic<size_t> left{0};
+    std::function<void(std::vector<uint8_t>&&)> reply;
+    std::function<void()> end_async;
+
+    void done_one(){
+        if (left.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        std::vector<uint8_t> bytes = BufferPool::acquire();
+        append_batch_response_frame(batch_id, rsps, bytes, version);
+        reply(std::move(bytes));
+        end_async();
+    }
+};
+
+// =====================================================
+// process_batch(rf, out, conn)
+// 功能：处理 BATCH 帧：N 个请求 → 一帧里按序的 N 个响应
+//   - 无线程池：逐项内联执行，响应帧追加到 out
+//   - 有线程池：每项单独入队并行执行，最后完成的一项编码整批并经 conn->reply 回包
+//   - 各项独立：未知方法/busy/overloaded/异常只影响该项的 status
+//   - 批内不处理 __hello（按未知方法回复）
+//   - 批次帧头的超时对每一项生效，各项执行前分别检查
+// 失败：批量 payload 格式错误 → 回一个 status=2 的普通 RESPONSE（req_id 为批次 id）
+// =====================================================
+void RpcServer::process_batch(const RawFrameView& rf, std::vector<uint8_t>& out,
+                              const ConnPtr& conn){
+    auto received = clock_type::now();
+    Deadline deadline = deadline_of(rf, received);
+    auto bad_batch = [&](const std::exception& ex){
+        append_response_frame(error_response(rf.req_id, 2, std::string("bad batch: ") + ex.what()),
+                              out, rf.version);
+    };
+
+    // 执行一项：查表 → 并发上限 → execute；项的 req_id 取批次 id
+    auto run_item = [this, &rf, received, deadline](const BatchItemView& it, const Entry* e) -> Response {
+        if (!e){
+            metrics_.on_unknown();
+            return unknown_method(rf.req_id, it.method, it.method_id);
+        }
+        metrics_.on_start(e->slot);
+        Response rsp;
+        if (acquire(*e)){
+            rsp = execute(*e, RawFrameView{MsgType::REQUEST, rf.req_id, e->name, it.payload,
+                                           it.payload_len, rf.version, it.method_id},
+                          deadline);
+            release(*e);
+        }else{
+            rsp = error_response(rf.req_id, 3, "method busy: " + e->name);
+        }
+        metrics_.on_finish(e->slot, rsp.status, received);
+        return rsp;
+    };
+
+    if (!pool_){
+        thread_local std::vector<BatchItemView> items;
+        thread_local std::vector<Response> rsps;
         try{
-            if (rf.type == MsgType::REQUEST){
-                // 1) 解析请求 payload → Request
-                Request req = parse_request_payload(rf.req_id, rf.method, rf.payload);
-
-                // 2) 查找处理函数（加锁保护 handlers_）
-                Handler h;
-                {
-                    std::lock_guard<std::mutex> lk(mu_);
-                    auto it = handlers_.find(req.method);
-                    if (it != handlers_.end()) h = it->second;
-                }
-
-                // 3) 调用或返回“未知方法”
-                Response rsp;
-                if (!h){
-                    rsp.req_id = req.req_id;
-                    rsp.status = 1;
-                    rsp.err_msg = "unknown method: " + req.method;
-                    rsp.has_result = false;
-                }else{
-                    rsp = h(req);            // 业务代码可能抛异常 → 外层 catch
-                    rsp.req_id = req.req_id; // 保证回包 req_id 对齐
-                }
-
-                // 4) 编码为 response frame 并发送
-                std::vector<uint8_t> frame;
-                build_response_frame(rsp, frame);
-                send_frame(cfd, frame);
+            parse_batch_requests(rf.payload, rf.payload_len, rf.version, items);
+        }catch(const std::exception& ex){ bad_batch(ex); return; }
+        rsps.clear();
+        for (auto& it : items) rsps.push_back(run_item(it, lookup(it.method, it.method_id)));
+        append_batch_response_frame(rf.req_id, rsps, out, rf.version);
+        return;
+    }
+
+    auto st = std::make_shared<BatchState>();
+    st->batch_id = rf.req_id;
+    st->version  = rf.version;
+    st->payload.assign(rf.payload, rf.payload + rf.payload_len);
+    try{
+        parse_batch_requests(st->payload.data(), st->payload.size(), st->version, st->items);
+    }catch(const std::exception& ex){ bad_batch(ex); return; }
+    if (st->items.empty()){
+        append_batch_response_frame(rf.req_id, {}, out, rf.version);
+        return;
+    }
+    st->rsps.resize(st->items.size());
+    st->left = st->items.size();
+    st->reply = conn->reply;
+    st->end_async = [conn]{ conn->end_async(); };
+    conn->begin_async();
+
+    for (size_t i = 0; i < st->items.size(); ++i){
+        const BatchItemView& it = st->items[i];
+        const Entry* e = lookup(it.method, it.method_id);
+        if (!e){
+            metrics_.on_unknown();
+            st->rsps[i] = unknown_method(rf.req_id, it.method, it.method_id);
+            st->done_one();
+            continue;
+        }
+        metrics_.on_start(e->slot);
+        // 入队时不占并发名额（执行时才占），避免排队中的项把方法“占满”
+        bool queued = pool_->try_submit([this, st, i, e, received, deadline]{
+            const BatchItemView& item = st->items[i];
+            RawFrameView v{MsgType::REQUEST, st->batch_id, e->name, item.payload,
+                           item.payload_len, st->version, item.method_id};
+            if (acquire(*e)){
+                st->rsps[i] = execute(*e, v, deadline);
+                release(*e);
             }else{
-                // 收到非响应类型帧（比如客户端实现错误）
-                std::cerr << "[server] unexpected frame type\n";
+                st->rsps[i] = error_response(st->batch_id, 3, "method busy: " + e->name);
             }
-        }catch(const std::exception& e){
-            // 将异常封装为错误响应（status=2）
-            Response rsp;
-            rsp.req_id = rf.req_id;
-            rsp.status = 2;
-            rsp.err_msg = std::string("server exception: ") + e.what();
-            rsp.has_result = false;
+            metrics_.on_finish(e->slot, st->rsps[i].status, received);
+            st->done_one();
+        });
+        if (!queued){
+            metrics_.on_finish(e->slot, 3, received);
+            st->rsps[i] = error_response(rf.req_id, 3, "server overloaded");
+            st->done_one();
+        }
+    }
+}
 
-            std::vector<uint8_t> frame;
-            build_response_frame(rsp, frame);
-            send_frame(cfd, frame);
+// =====================================================
+// lookup(method, method_id)
+// 功能：无锁读取当前分发表，method_id 非 0 按 ID 查，否则按名字查
+// 输出：找不到或没有 handler → nullptr
+// =====================================================
+const RpcServer::Entry* RpcServer::lookup(std::string_view method, uint32_t method_id) const {
+    const DispatchTable* t = table_.load(std::memory_order_acquire);
+    const Entry* e = nullptr;
+    if (method_id){
+        auto it = t->by_id.find(method_id);
+        if (it != t->by_id.end()) e = it->second;
+    }else{
+        auto it = t->by_name.find(method);
+        if (it != t->by_name.end()) e = it->second;
+    }
+#ifdef TINY_RPC_COROUTINES
+    if (e && e->ch) return e;
+#endif
+    return (e && (e->h || e->vh || e->rh || e->ssh || e->csh)) ? e : nullptr;
+}
+
+// 占用一个并发名额；已达 max_concurrency 则退回并返回 false（0 = 不限）
+bool RpcServer::acquire(const Entry& e){
+    if (!e.max_concurrency) return true;
+    if (e.inflight.fetch_add(1, std::memory_order_acq_rel) < e.max_concurrency) return true;
+    e.inflight.fetch_sub(1, std::memory_order_acq_rel);
+    return false;
+}
+
+void RpcServer::release(const Entry& e){
+    if (e.max_concurrency) e.inflight.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+// =====================================================
+// execute(e, rf, deadline)
+// 功能：按 handler 类型解析参数并调用
+//   已过截止时间：调用方早已放弃，不解析也不执行，回 status=4（代价只有一次取时钟）
+//   截止时间写入 Request/RequestView，handler 经 remaining() 读取剩余预算
+//   零拷贝 handler：解析为 RequestView（复用线程局部的 args 容量）
+//   原始/类型化 handler：直接交给帧视图，由 handler 自己从 payload 解码
+//   普通 handler：解析为拥有内存的 Request
+//   method 取表中的名字（按 ID 调用时帧里没有名字；表不回收，视图一直有效）
+// 输出：req_id 已对齐的 Response；任何异常 → status=2
+// =====================================================
+Response RpcServer::execute(const Entry& e, const RawFrameView& rf, Deadline deadline){
+    if (expired(deadline))
+        return error_response(rf.req_id, STATUS_DEADLINE_EXCEEDED, "deadline exceeded");
+    Response rsp;
+    try{
+        if (e.vh){
+            thread_local RequestView view;
+            parse_request_view(rf.req_id, e.name, rf.payload, rf.payload_len, view, rf.version);
+            view.deadline = deadline;
+            rsp = e.vh(view);        // 业务代码可能抛异常 → 下方 catch
+        }else if (e.rh){
+            rsp = e.rh(rf);          // 类型化 handler：直接从 payload 解码到形参
+        }else if (e.h){
+            // 参数解码进本次请求的 arena，handler 返回后随 arena 一次释放；
+            // 响应里的 Value 是 handler 新建/拷贝的，不引用 arena。req 的容量跨请求复用
+            thread_local Request req;
+            RequestArena arena;
+            struct ArgsGuard {               // 异常路径上也要在 arena 之前清空参数
+                Request& r;
+                ~ArgsGuard(){ r.args.clear(); }
+            } guard{req};
+            parse_request_payload(rf.req_id, e.name, rf.payload, rf.payload_len, req, &arena,
+                                  rf.version);
+            req.deadline = deadline;
+            rsp = e.h(req);
+        }else{
+            throw std::runtime_error("streaming/coroutine method cannot be called here: " + e.name);
+        }
+        rsp.req_id = rf.req_id;      // 保证回包 req_id 对齐
+    }catch(const std::exception& ex){
+        // 将异常封装为错误响应（status=2）
+        rsp = error_response(rf.req_id, 2, std::string("server exception: ") + ex.what());
+    }
+    return rsp;
+}
+
+// =====================================================
+// start_stream(rf, e, out, conn, received, deadline)
+// 功能：开始一个流式调用
+//   0) 全服务端进行中的流已达 max_streams_ → 回 status=3，不起线程
+//   1) 把参数解析成拥有内存的 Request（帧视图只在本次回调内有效）
+//   2) 在 conn->streams 登记 req_id → StreamState，后续 DATA/CREDIT/END 据此路由
+//   3) 起独立线程执行 handler（会在额度/数据上阻塞，不能占 I/O 线程或线程池）
+//   4) handler 返回后注销流、归还并发名额与流名额，再发结束帧：
+//      服务端流 → STREAM_END（带结束状态）；客户端流 → 普通 RESPONSE
+// 失败：参数解析失败 / req_id 与进行中的流重复 → 内联回 status=2
+// 截止时间只作为 req.deadline 交给 handler，流不会被强制中断
+// =====================================================
+void RpcServer::start_stream(const RawFrameView& rf, const Entry* e, std::vector<uint8_t>& out,
+                             const ConnPtr& conn, clock_type::time_point received,
+                             Deadline deadline){
+    size_t active = streams_.fetch_add(1, std::memory_order_acq_rel);   // 不限时也计数：结束时统一归还
+    if (max_streams_ && active >= max_streams_){
+        streams_.fetch_sub(1, std::memory_order_acq_rel);
+        metrics_.on_finish(e->slot, 3, received);
+        release(*e);
+        append_response_frame(error_response(rf.req_id, 3, "too many streams"), out, rf.version);
+        return;
+    }
+    Request req;
+    try{
+        req = parse_request_payload(rf.req_id, e->name, rf.payload, rf.payload_len, rf.version);
+        req.deadline = deadline;
+    }catch(const std::exception& ex){
+        streams_.fetch_sub(1, std::memory_order_acq_rel);
+        metrics_.on_finish(e->slot, 2, received);
+        release(*e);
+        append_response_frame(error_response(rf.req_id, 2, std::string("server exception: ") + ex.what()),
+                              out, rf.version);
+        return;
+    }
+
+    auto st = std::make_shared<StreamState>();
+    st->upload = (bool)e->csh;
+    {
+        std::lock_guard<std::mutex> lk(conn->mu);
+        if (!conn->streams.emplace(rf.req_id, st).second){
+            streams_.fetch_sub(1, std::memory_order_acq_rel);
+            metrics_.on_finish(e->slot, 2, received);
+            release(*e);
+            append_response_frame(error_response(rf.req_id, 2, "duplicate stream id"), out, rf.version);
+            return;
+        }
+    }
+
+    uint8_t ver = rf.version;
+    std::thread([this, e, conn, st, ver, received, req = std::move(req)]{
+        uint32_t id = req.req_id;
+        Response rsp;
+        try{
+            if (e->ssh){
+                StreamWriter w(id, ver, conn->reply, st);
+                rsp = e->ssh(req, w);
+            }else{
+                StreamReader r(id, ver, conn->reply, st);
+                rsp = e->csh(req, r);
+            }
+            rsp.req_id = id;
+        }catch(const std::exception& ex){
+            rsp = error_response(id, 2, std::string("server exception: ") + ex.what());
+        }
+        {
+            std::lock_guard<std::mutex> lk(conn->mu);
+            conn->streams.erase(id);
+        }
+        metrics_.on_finish(e->slot, rsp.status, received);
+        release(*e);
+        streams_.fetch_sub(1, std::memory_order_acq_rel);
+
+        std::vector<uint8_t> bytes = BufferPool::acquire();
+        if (e->ssh) append_stream_end_frame(rsp, bytes, ver);
+        else        append_response_frame(rsp, bytes, ver);
+        conn->reply(std::move(bytes));
+    }).detach();
+}
+
+#ifdef TINY_RPC_COROUTINES
+// 协程 handler 的回包由谁发：start_coro 启动协程后、协程完成时各做一次 exchange，
+// 后到的一方负责发送——协程同步完成则追加到本轮的 out，否则经 conn->reply 异步回包
+struct CoroReply {
+    enum : int { RUNNING = 0, DONE = 1, DETACHED = 2 };
+    std::atomic<int> phase{RUNNING};
+    std::vector<uint8_t> bytes;          // 编码好的响应帧；DONE 之后只读
+};
+
+// =====================================================
+// start_coro(rf, e, out, conn, received, deadline)
+// 功能：开始一个协程调用
+//   1) 已过截止时间 → 不启动，回 status=4；参数解析为拥有内存的 Request（帧视图只在本次回调内有效）
+//   2) spawn(run_coro(...))：在当前线程运行到第一次挂起（或直接完成）
+//   3) 协程已完成 → 响应追加到 out；否则由协程完成时异步回包
+// 失败：参数解析失败 → 内联回 status=2
+// =====================================================
+void RpcServer::start_coro(const RawFrameView& rf, const Entry* e, std::vector<uint8_t>& out,
+                           const ConnPtr& conn, clock_type::time_point received,
+                           Deadline deadline){
+    Request req;
+    Response err;
+    if (expired(deadline)){
+        err = error_response(rf.req_id, STATUS_DEADLINE_EXCEEDED, "deadline exceeded");
+    }else{
+        try{
+            req = parse_request_payload(rf.req_id, e->name, rf.payload, rf.payload_len, rf.version);
+            req.deadline = deadline;
+        }catch(const std::exception& ex){
+            err = error_response(rf.req_id, 2, std::string("server exception: ") + ex.what());
+        }
+    }
+    if (err.status != 0){
+        metrics_.on_finish(e->slot, err.status, received);
+        release(*e);
+        append_response_frame(err, out, rf.version);
+        return;
+    }
+
+    // 先 hold：协程同步完成则这里归还，否则由 run_coro 异步回包后归还
+    auto hand = std::make_shared<CoroReply>();
+    conn->begin_async();
+    spawn(run_coro(e, std::move(req), conn, rf.version, received, hand));
+    if (hand->phase.exchange(CoroReply::DETACHED, std::memory_order_acq_rel) == CoroReply::DONE){
+        out.insert(out.end(), hand->bytes.begin(), hand->bytes.end());
+        conn->end_async();
+    }
+}
+
+// 协程体：执行 handler，异常转换为 status=2；完成后记统计、归还名额，按 CoroReply 交接回包
+Task<void> RpcServer::run_coro(const Entry* e, Request req, ConnPtr conn, uint8_t ver,
+                               clock_type::time_point received, std::shared_ptr<CoroReply> hand){
+    Response rsp;
+    try{
+        rsp = co_await e->ch(req);
+        rsp.req_id = req.req_id;
+    }catch(const std::exception& ex){
+        rsp = error_response(req.req_id, 2, std::string("server exception: ") + ex.what());
+    }
+    metrics_.on_finish(e->slot, rsp.status, received);
+    release(*e);
+    append_response_frame(rsp, hand->bytes, ver);
+    if (hand->phase.exchange(CoroReply::DONE, std::memory_order_acq_rel) == CoroReply::DETACHED){
+        conn->reply(std::move(hand->bytes));
+        conn->end_async();
+    }
+}
+#endif
+
+// =====================================================
+// route_stream_frame(rf, conn)
+// 功能：把对端发来的流式帧交给进行中的流
+//   STREAM_CREDIT → 服务端流增加额度
+//   STREAM_DATA   → 客户端流入队（超过窗口视为违反流控，取消该流）
+//   STREAM_END    → 客户端流：上传结束；服务端流：客户端取消
+// 边界：找不到 req_id（流已结束）直接丢弃；payload 非法则取消该流
+// =====================================================
+void RpcServer::route_stream_frame(const RawFrameView& rf, ConnCtx& conn){
+    std::shared_ptr<StreamState> st;
+    {
+        std::lock_guard<std::mutex> lk(conn.mu);
+        auto it = conn.streams.find(rf.req_id);
+        if (it == conn.streams.end()) return;
+        st = it->second;
+    }
+
+    // 先在锁外解码，再在锁内更新状态
+    Value v;
+    bool bad = false;
+    if (rf.type != MsgType::STREAM_END){
+        try{
+            auto dec = decode_value(rf.payload, rf.payload_len, rf.version);
+            if (dec.second != rf.payload_len) throw std::runtime_error("extra bytes in stream frame");
+            v = std::move(dec.first);
+            if (rf.type == MsgType::STREAM_CREDIT && (v.type() != ValueType::INT64 || v.i64() <= 0))
+                throw std::runtime_error("bad stream credit");
+        }catch(const std::exception& ex){
+            std::cerr << "[server] bad stream frame id=" << rf.req_id << ": " << ex.what() << "\n";
+            bad = true;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(st->mu);
+        if (bad){
+            st->cancelled = true;
+        }else if (rf.type == MsgType::STREAM_CREDIT){
+            if (!st->upload) st->credit += (uint64_t)v.i64();
+        }else if (rf.type == MsgType::STREAM_DATA){
+            if (!st->upload || st->ended || st->q.size() >= STREAM_WINDOW) st->cancelled = true;
+            else st->q.push_back(std::move(v));
+        }else{
+            if (st->upload) st->ended = true;
+            else            st->cancelled = true;
+        }
+    }
+    st->cv.notify_all();
+}
+
+// 连接关闭：取消该连接上所有进行中的流，阻塞在 write/next 上的 handler 随即返回
+void RpcServer::cancel_streams(ConnCtx& conn){
+    std::vector<std::shared_ptr<StreamState>> all;
+    {
+        std::lock_guard<std::mutex> lk(conn.mu);
+        for (auto& kv : conn.streams) all.push_back(kv.second);
+    }
+    for (auto& st : all){
+        {
+            std::lock_guard<std::mutex> lk(st->mu);
+            st->cancelled = true;
         }
+        st->cv.notify_all();
     }
-    // 连接退出：关闭 fd
-    close_fd(cfd);
 }
 
 } // namespace rpc
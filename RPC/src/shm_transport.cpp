@@ -0,0 +1,348 @@
+#include "rpc/transport.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <thread>
+#ifdef __linux__
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <sys/eventfd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+namespace rpc {
+
+#ifdef __linux__
+
+// =====================================================
+// 共享内存传输
+//
+// 布局（客户端创建 memfd 并封住大小，握手时连同 4 个 eventfd 经 SCM_RIGHTS 交给服务端）：
+//   [RingHeader c2s][c2s 数据 RING_BYTES][RingHeader s2c][s2c 数据 RING_BYTES]
+// 每条环只有一个生产者（写端由调用方加锁串行化）和一个消费者（接收线程），
+// head/tail 是单调递增的字节位置，取模用掩码，无需锁。
+//
+// 唤醒：消费者读空后先自旋一会儿，仍无数据才置 reader_waiting 并阻塞在 eventfd 上；
+// 生产者发布 tail 后只有看到 reader_waiting 才写 eventfd。对端忙时整条路径没有系统调用。
+// 两边都是“写自己的标志 → 全屏障 → 读对方的位置”，不会出现双方都以为对方会唤醒自己。
+// 写满时对称地用 writer_waiting + 另一个 eventfd 等空位。
+//
+// 关闭：握手 socket 保持打开，阻塞时一并 poll 它；任一端 shutdown/退出，
+// 对端 poll 到挂断，读完环里剩余的数据后返回关闭。
+//
+// head/tail 在对端可写的内存里：每次取用都先检查 tail - head <= 环大小，不成立说明对端
+// 写坏了环头（有意或无意），立即关闭连接，不拿它去算拷贝范围。
+// =====================================================
+
+static constexpr size_t SHM_RING_BYTES = size_t(1) << 20;      // 每个方向 1MB
+static constexpr size_t SHM_MAX_RING_BYTES = size_t(64) << 20;
+static constexpr char SHM_MAGIC[8] = { 'R', 'P', 'C', 'S', 'H', 'M', '1', '\0' };
+
+struct RingHeader {
+    alignas(64) std::atomic<uint64_t> head{0};           // 已消费位置（消费者写）
+    alignas(64) std::atomic<uint64_t> tail{0};           // 已发布位置（生产者写）
+    alignas(64) std::atomic<uint32_t> reader_waiting{0}; // 消费者即将阻塞，需要 eventfd 唤醒
+    std::atomic<uint32_t> writer_waiting{0};             // 生产者即将阻塞（环已满）
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shm ring needs lock-free 64-bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shm ring needs lock-free 32-bit atomics");
+
+// 握手消息：客户端 → 服务端，附带 fd：[memfd, c2s_data, c2s_space, s2c_data, s2c_space]
+struct ShmHello {
+    char magic[8];
+    uint64_t ring_bytes;
+};
+static constexpr int SHM_FDS = 5;
+
+static size_t shm_map_len(size_t ring_bytes){ return 2 * (sizeof(RingHeader) + ring_bytes); }
+
+static inline void cpu_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// 单核机器上自旋只会拖延对端，直接睡眠
+static int spin_iterations(){
+    static const int n = std::thread::hardware_concurrency() > 1 ? 4000 : 0;
+    return n;
+}
+
+// 发布位置后调用：对端登记了等待才写 eventfd
+static void wake_if_waiting(std::atomic<uint32_t>& waiting, int efd){
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed)){
+        uint64_t one = 1;
+        (void)!::write(efd, &one, sizeof(one));
+    }
+}
+
+class ShmConn : public Conn {
+public:
+    // efds 按握手顺序：[c2s_data, c2s_space, s2c_data, s2c_space]；client 决定哪条环是发送方向
+    ShmConn(socket_t ctl, uint8_t* base, size_t ring_bytes, bool client, const int efds[4])
+        : ctl_(ctl), base_(base), cap_(ring_bytes) {
+        auto* c2s = reinterpret_cast<RingHeader*>(base);
+        auto* s2c = reinterpret_cast<RingHeader*>(base + sizeof(RingHeader) + ring_bytes);
+        for (int i = 0; i < 4; ++i) efds_[i] = efds[i];
+        tx_ = client ? c2s : s2c;
+        rx_ = client ? s2c : c2s;
+        tx_data_efd_  = client ? efds[0] : efds[2];
+        tx_space_efd_ = client ? efds[1] : efds[3];
+        rx_data_efd_  = client ? efds[2] : efds[0];
+        rx_space_efd_ = client ? efds[3] : efds[1];
+    }
+    ~ShmConn() override {
+        ::munmap(base_, shm_map_len(cap_));
+        for (int fd : efds_) ::close(fd);
+        close_fd(ctl_);
+    }
+
+    bool write(const void* buf, size_t n) override {
+        const uint8_t* p = static_cast<const uint8_t*>(buf);
+        uint8_t* data = data_of(tx_);
+        while (n > 0){
+            if (shut_.load(std::memory_order_relaxed)) return false;
+            uint64_t tail = tx_->tail.load(std::memory_order_relaxed);
+            uint64_t used = tail - tx_->head.load(std::memory_order_acquire);
+            if (used > cap_) return corrupt();
+            uint64_t space = cap_ - used;
+            if (space == 0){
+                if (!wait(tx_->writer_waiting, tx_space_efd_, [&]{
+                        return tx_->head.load(std::memory_order_acquire) + cap_ != tail; }))
+                    return false;
+                continue;
+            }
+            size_t k = (size_t)std::min<uint64_t>(n, space);
+            size_t off = (size_t)(tail & (cap_ - 1));
+            size_t first = std::min(k, cap_ - off);
+            std::memcpy(data + off, p, first);
+            std::memcpy(data, p + first, k - first);
+            tx_->tail.store(tail + k, std::memory_order_release);
+            wake_if_waiting(tx_->reader_waiting, tx_data_efd_);
+            p += k;
+            n -= k;
+        }
+        return true;
+    }
+
+    bool read(void* buf, size_t n) override {
+        uint8_t* p = static_cast<uint8_t*>(buf);
+        const uint8_t* data = data_of(rx_);
+        while (n > 0){
+            uint64_t head = rx_->head.load(std::memory_order_relaxed);
+            uint64_t avail = rx_->tail.load(std::memory_order_acquire) - head;
+            if (avail > cap_) return corrupt();
+            if (avail == 0){
+                if (!wait(rx_->reader_waiting, rx_data_efd_, [&]{
+                        return rx_->tail.load(std::memory_order_acquire) != head; }))
+                    return false;
+                continue;
+            }
+            size_t k = (size_t)std::min<uint64_t>(n, avail);
+            size_t off = (size_t)(head & (cap_ - 1));
+            size_t first = std::min(k, cap_ - off);
+            std::memcpy(p, data + off, first);
+            std::memcpy(p + first, data, k - first);
+            rx_->head.store(head + k, std::memory_order_release);
+            wake_if_waiting(rx_->writer_waiting, rx_space_efd_);
+            p += k;
+            n -= k;
+        }
+        return true;
+    }
+
+    // 握手 socket 双向关闭：本端阻塞中的 poll 与对端都会看到挂断
+    void shutdown() override {
+        shut_.store(true, std::memory_order_release);
+        shutdown_fd(ctl_);
+    }
+
+    std::string describe() const override { return "shm fd=" + std::to_string(ctl_); }
+
+private:
+    uint8_t* data_of(RingHeader* r) const { return reinterpret_cast<uint8_t*>(r) + sizeof(RingHeader); }
+
+    // 环头位置越界：对端不可信，关闭连接（之后的读写都返回 false，对端看到挂断）
+    bool corrupt(){
+        shutdown();
+        return false;
+    }
+
+    // 等待 ready()：先自旋，再登记 waiting、复查、阻塞在 efd 与握手 socket 上
+    // 返回 false：本端已 shutdown，或对端已关闭且 ready() 仍不成立
+    template <class Ready>
+    bool wait(std::atomic<uint32_t>& waiting, int efd, Ready ready){
+        for (int i = spin_iterations(); i > 0; --i){
+            if (ready()) return true;
+            cpu_relax();
+        }
+        while (true){
+            if (shut_.load(std::memory_order_acquire)) return false;
+            waiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ready()){
+                waiting.store(0, std::memory_order_relaxed);
+                return true;
+            }
+            pollfd pfd[2] = { { efd, POLLIN, 0 }, { ctl_, POLLIN, 0 } };
+            int r = ::poll(pfd, 2, -1);
+            waiting.store(0, std::memory_order_relaxed);
+            if (r < 0 && errno != EINTR) return false;
+            if (r > 0 && (pfd[0].revents & POLLIN)){
+                uint64_t v;
+                (void)!::read(efd, &v, sizeof(v));   // 非阻塞 eventfd：清零计数
+            }
+            if (ready()) return true;
+            // 握手之后 ctl 上不再有数据：可读即 EOF（对端关闭），HUP/ERR 即本端或对端 shutdown
+            if (r > 0 && pfd[1].revents) return false;
+        }
+    }
+
+    socket_t ctl_;
+    uint8_t* base_;
+    size_t cap_;
+    int efds_[4];
+    RingHeader* tx_;
+    RingHeader* rx_;
+    int tx_data_efd_, tx_space_efd_, rx_data_efd_, rx_space_efd_;
+    std::atomic<bool> shut_{false};
+};
+
+static void close_all(const int* fds, int n){
+    for (int i = 0; i < n; ++i) if (fds[i] >= 0) ::close(fds[i]);
+}
+
+// 握手期间的收发加超时：对端卡住时不能一直占着服务端的连接线程或连接方
+static void set_handshake_timeout(socket_t s, int seconds){
+    timeval tv{ seconds, 0 };
+    ::setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+// =====================================================
+// shm_try_connect(path, timeout_ms)
+//   1) 连上 path 处的 UNIX socket（握手 + 之后感知关闭；timeout_ms 见 unix_try_connect）
+//   2) 创建 memfd（两条环）并加 SHRINK/GROW/SEAL 封印，与 4 个 eventfd，初始化环头
+//      封住大小后服务端映射的区域不会被截短（否则访问越界的页会 SIGBUS）
+//   3) sendmsg 发 ShmHello + SCM_RIGHTS，等服务端回 1 字节确认
+// 失败：任一步出错返回空（资源全部释放）
+// =====================================================
+std::unique_ptr<Conn> shm_try_connect(const std::string& path, int timeout_ms){
+    socket_t ctl = unix_try_connect(path, timeout_ms);
+    if (ctl == INVALID_SOCKET_T) return nullptr;
+
+    const size_t len = shm_map_len(SHM_RING_BYTES);
+    int fds[SHM_FDS] = { -1, -1, -1, -1, -1 };
+    void* base = MAP_FAILED;
+    bool ok = false;
+    do{
+        fds[0] = ::memfd_create("tiny_rpc_shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fds[0] < 0 || ::ftruncate(fds[0], (off_t)len) < 0) break;
+        if (::fcntl(fds[0], F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) break;
+        base = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+        if (base == MAP_FAILED) break;
+        new (base) RingHeader();
+        new (static_cast<uint8_t*>(base) + sizeof(RingHeader) + SHM_RING_BYTES) RingHeader();
+
+        bool efd_ok = true;
+        for (int i = 1; i < SHM_FDS; ++i){
+            fds[i] = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            efd_ok = efd_ok && fds[i] >= 0;
+        }
+        if (!efd_ok) break;
+
+        ShmHello hello{};
+        std::memcpy(hello.magic, SHM_MAGIC, sizeof(SHM_MAGIC));
+        hello.ring_bytes = SHM_RING_BYTES;
+        iovec iov{ &hello, sizeof(hello) };
+        alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int) * SHM_FDS)] = {};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl;
+        msg.msg_controllen = sizeof(ctrl);
+        cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int) * SHM_FDS);
+        std::memcpy(CMSG_DATA(cm), fds, sizeof(int) * SHM_FDS);
+
+        set_handshake_timeout(ctl, 2);
+        if (::sendmsg(ctl, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(hello)) break;
+        char ack = 0;
+        if (::recv(ctl, &ack, 1, 0) != 1 || ack != 'K') break;
+        ok = true;
+    }while (false);
+
+    if (!ok){
+        if (base != MAP_FAILED) ::munmap(base, len);
+        close_all(fds, SHM_FDS);
+        close_fd(ctl);
+        return nullptr;
+    }
+    ::close(fds[0]);                       // 映射建立后 memfd 本身不再需要
+    return std::make_unique<ShmConn>(ctl, static_cast<uint8_t*>(base), SHM_RING_BYTES, true, fds + 1);
+}
+
+// =====================================================
+// shm_accept(ctl)
+//   收 ShmHello + 5 个 fd，校验魔数、环大小（2 的幂）、memfd 已封住不可缩小且实际大小相符后映射，回 'K'
+// 失败：返回空，关闭 ctl 与收到的全部 fd
+// =====================================================
+std::unique_ptr<Conn> shm_accept(socket_t ctl){
+    set_handshake_timeout(ctl, 2);
+
+    ShmHello hello{};
+    iovec iov{ &hello, sizeof(hello) };
+    alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int) * SHM_FDS)] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    ssize_t r = ::recvmsg(ctl, &msg, MSG_CMSG_CLOEXEC);
+
+    int fds[SHM_FDS] = { -1, -1, -1, -1, -1 };
+    cmsghdr* cm = r > 0 ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (cm && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS){
+        size_t n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        std::memcpy(fds, CMSG_DATA(cm), sizeof(int) * std::min<size_t>(n, SHM_FDS));
+    }
+
+    const size_t cap = (size_t)hello.ring_bytes;
+    bool valid = r == (ssize_t)sizeof(hello) && !(msg.msg_flags & MSG_CTRUNC) &&
+                 std::memcmp(hello.magic, SHM_MAGIC, sizeof(SHM_MAGIC)) == 0 &&
+                 cap >= 64 && cap <= SHM_MAX_RING_BYTES && (cap & (cap - 1)) == 0 &&
+                 std::all_of(fds, fds + SHM_FDS, [](int fd){ return fd >= 0; });
+    // 先查封印再查大小：没有 F_SEAL_SHRINK 的 memfd 可能在映射后被对端 ftruncate 截短
+    int seals = valid ? ::fcntl(fds[0], F_GET_SEALS) : -1;
+    valid = valid && seals >= 0 && (seals & F_SEAL_SHRINK);
+    struct stat st{};
+    valid = valid && ::fstat(fds[0], &st) == 0 && (size_t)st.st_size == shm_map_len(cap);
+
+    void* base = valid ? ::mmap(nullptr, shm_map_len(cap), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0)
+                       : MAP_FAILED;
+    char ack = 'K';
+    if (base == MAP_FAILED || ::send(ctl, &ack, 1, MSG_NOSIGNAL) != 1){
+        if (base != MAP_FAILED) ::munmap(base, shm_map_len(cap));
+        close_all(fds, SHM_FDS);
+        close_fd(ctl);
+        return nullptr;
+    }
+    ::close(fds[0]);
+    return std::make_unique<ShmConn>(ctl, static_cast<uint8_t*>(base), cap, false, fds + 1);
+}
+
+#else  // !__linux__
+
+std::unique_ptr<Conn> shm_try_connect(const std::string&, int){ return nullptr; }
+std::unique_ptr<Conn> shm_accept(socket_t ctl){ close_fd(ctl); return nullptr; }
+
+#endif
+
+} // namespace rpc
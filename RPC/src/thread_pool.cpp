@@ -0,0 +1,63 @@
+#include "rpc/thread_pool.h"
+
+namespace rpc {
+
+// =====================================================
+// ThreadPool: 固定大小的工作线程池
+// 职责：
+//   - 把 handler 的执行与连接 I/O 线程分离
+//   - 队列有上限：满了就拒绝，由调用方回“过载”响应，内存不会无界增长
+// =====================================================
+
+ThreadPool::ThreadPool(size_t threads, size_t queue_capacity)
+    : capacity_(queue_capacity) {
+    if (threads == 0) threads = 1;
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+        workers_.emplace_back(&ThreadPool::worker_loop, this);
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+// =====================================================
+// try_submit(t)
+// 输出：true = 已入队；false = 队列已满或线程池已停止
+// =====================================================
+bool ThreadPool::try_submit(Task t){
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (stop_ || q_.size() >= capacity_) return false;
+        q_.push_back(std::move(t));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+size_t ThreadPool::queue_depth(){
+    std::lock_guard<std::mutex> lk(mu_);
+    return q_.size();
+}
+
+// 工作线程：取任务执行；stop_ 后把剩余任务做完再退出
+void ThreadPool::worker_loop(){
+    while (true){
+        Task t;
+        {
+            std::unique_lock<std::mutex> lk(mu_);
+            cv_.wait(lk, [this]{ return stop_ || !q_.empty(); });
+            if (q_.empty()) return;
+            t = std::move(q_.front());
+            q_.pop_front();
+        }
+        t();
+    }
+}
+
+} // namespace rpc
@@ -0,0 +1,200 @@
+#include "rpc/transport.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace rpc {
+
+Endpoint Endpoint::tcp(std::string host, uint16_t port){
+    Endpoint ep;
+    ep.host = std::move(host);
+    ep.port = port;
+    return ep;
+}
+
+Endpoint Endpoint::uds(std::string path){
+    Endpoint ep;
+    ep.kind = TransportKind::UNIX;
+    ep.path = std::move(path);
+    return ep;
+}
+
+Endpoint Endpoint::shm(std::string path){
+    Endpoint ep;
+    ep.kind = TransportKind::SHM;
+    ep.path = std::move(path);
+    return ep;
+}
+
+// =====================================================
+// Endpoint::parse(s)
+//   "unix:/path" / "shm:/path" 按前缀识别，其余按 [host:]port 解析为 TCP
+// 失败：路径为空、端口不是 1..65535 的整数 → throw runtime_error
+// =====================================================
+Endpoint Endpoint::parse(const std::string& s){
+    Endpoint ep;
+    auto prefixed = [&s](const char* p){ return s.compare(0, std::char_traits<char>::length(p), p) == 0; };
+    if (prefixed("unix:") || prefixed("shm:")){
+        std::string path = s.substr(s.find(':') + 1);
+        if (path.empty()) throw std::runtime_error("bad endpoint (empty path): " + s);
+        return prefixed("unix:") ? uds(std::move(path)) : shm(std::move(path));
+    }
+
+    auto colon = s.rfind(':');
+    std::string port = colon == std::string::npos ? s : s.substr(colon + 1);
+    ep.host = colon == std::string::npos ? "127.0.0.1" : s.substr(0, colon);
+    if (ep.host.empty() || port.empty() || port.size() > 5 ||
+        port.find_first_not_of("0123456789") != std::string::npos)
+        throw std::runtime_error("bad endpoint: " + s);
+    unsigned long p = std::stoul(port);
+    if (p == 0 || p > 65535) throw std::runtime_error("bad endpoint (port): " + s);
+    ep.port = (uint16_t)p;
+    return ep;
+}
+
+std::string Endpoint::str() const {
+    switch (kind){
+    case TransportKind::UNIX: return "unix:" + path;
+    case TransportKind::SHM:  return "shm:" + path;
+    default:                  return host + ":" + std::to_string(port);
+    }
+}
+
+// =====================================================
+// SocketConn：TCP / UNIX 连接，写直接用 net.cpp 的可靠写
+// 读经过一个小接收缓冲区：一次 recv 取走内核里已到的若干帧，
+// 之后的帧头/小帧 body 直接从缓冲区复制，不再是每帧两次 recv
+// 大块（超过缓冲区一半）且缓冲区已取空时直接读进调用方缓冲区，省一次复制
+// =====================================================
+static constexpr size_t SOCKET_READ_BUF = 16 * 1024;
+
+class SocketConn : public Conn {
+public:
+    explicit SocketConn(socket_t fd) : fd_(fd), rbuf_(SOCKET_READ_BUF) {}
+    ~SocketConn() override { close_fd(fd_); }
+
+    bool write(const void* buf, size_t n) override { return try_write_n(fd_, buf, n); }
+    bool read(void* buf, size_t n) override {
+        uint8_t* p = static_cast<uint8_t*>(buf);
+        size_t have = std::min(n, rend_ - rpos_);
+        std::memcpy(p, rbuf_.data() + rpos_, have);
+        rpos_ += have;
+        p += have;
+        n -= have;
+        if (n == 0) return true;
+        rpos_ = rend_ = 0;
+        if (n >= SOCKET_READ_BUF / 2) return read_n(fd_, p, n);
+        while (rend_ < n){
+            size_t r = recv_some(fd_, rbuf_.data() + rend_, rbuf_.size() - rend_);
+            if (r == 0) return false;
+            rend_ += r;
+        }
+        std::memcpy(p, rbuf_.data(), n);
+        rpos_ = n;
+        return true;
+    }
+    size_t buffered() const override { return rend_ - rpos_; }
+    size_t peek(void* buf, size_t n) const override {
+        n = std::min(n, rend_ - rpos_);
+        std::memcpy(buf, rbuf_.data() + rpos_, n);
+        return n;
+    }
+    void shutdown() override { shutdown_fd(fd_); }
+    std::string describe() const override { return "fd=" + std::to_string(fd_); }
+
+private:
+    socket_t fd_;
+    std::vector<uint8_t> rbuf_;   // [rpos_, rend_) 为已收下未取走的字节
+    size_t rpos_{0};
+    size_t rend_{0};
+};
+
+std::unique_ptr<Conn> make_socket_conn(socket_t fd){
+    return std::make_unique<SocketConn>(fd);
+}
+
+std::unique_ptr<Conn> try_connect(const Endpoint& ep, int timeout_ms){
+    socket_t s = INVALID_SOCKET_T;
+    switch (ep.kind){
+    case TransportKind::SHM:  return shm_try_connect(ep.path, timeout_ms);
+    case TransportKind::UNIX: s = unix_try_connect(ep.path, timeout_ms); break;
+    default:                  s = tcp_try_connect(ep.host, ep.port, timeout_ms); break;
+    }
+    if (s == INVALID_SOCKET_T) return nullptr;
+    return make_socket_conn(s);
+}
+
+// =====================================================
+// SocketListener：三种传输都从一个监听 socket 开始
+//   TCP/UNIX：accept 到的 fd 就是数据通道
+//   SHM     ：accept 到的是握手 socket，在 shm_accept 中收下共享内存与 eventfd；
+//             握手放在返回的 Handshake 里，由连接自己的线程执行，accept 循环不等它
+// =====================================================
+class SocketListener : public Listener {
+public:
+    SocketListener(socket_t fd, std::string path, bool shm)
+        : fd_(fd), path_(std::move(path)), shm_(shm) {}
+    ~SocketListener() override {
+        close_fd(fd_);
+#ifndef _WIN32
+        if (!path_.empty()) ::unlink(path_.c_str());
+#endif
+    }
+
+    Handshake accept() override {
+        socket_t cfd = ::accept(fd_, nullptr, nullptr);
+        if (cfd == INVALID_SOCKET_T){ perror("accept"); return nullptr; }
+        if (!shm_) return [cfd]{ return make_socket_conn(cfd); };
+        return [cfd]{
+            auto c = shm_accept(cfd);
+            if (!c) std::cerr << "[transport] shm handshake failed\n";
+            return c;
+        };
+    }
+    socket_t fd() const override { return fd_; }
+    bool supports_reactor() const override { return !shm_; }
+
+private:
+    socket_t fd_;
+    std::string path_;     // UNIX/SHM：析构时删除 socket 文件
+    bool shm_;
+};
+
+std::unique_ptr<Listener> listen_on(const Endpoint& ep){
+    switch (ep.kind){
+    case TransportKind::UNIX:
+        return std::make_unique<SocketListener>(unix_listen(ep.path), ep.path, false);
+    case TransportKind::SHM:
+        return std::make_unique<SocketListener>(unix_listen(ep.path), ep.path, true);
+    default:
+        return std::make_unique<SocketListener>(tcp_listen(ep.host, ep.port), std::string(), false);
+    }
+}
+
+// =====================================================
+// recv_body(c, body) / recv_frame(c)：同 net.cpp 的 socket 版本
+// =====================================================
+bool recv_body(Conn& c, std::vector<uint8_t>& body){
+    uint8_t len4[4];
+    if (!c.read(len4, 4)) return false;
+    body.resize(decode_body_len(len4));
+    return c.read(body.data(), body.size());
+}
+
+bool frame_buffered(const Conn& c){
+    uint8_t len4[4];
+    if (c.buffered() < 4 || c.peek(len4, 4) != 4) return false;
+    uint64_t body_len = (uint64_t(len4[0])<<24) | (uint64_t(len4[1])<<16)
+                      | (uint64_t(len4[2])<<8)  |  uint64_t(len4[3]);
+    return c.buffered() >= 4 + body_len;
+}
+
+std::optional<RawFrame> recv_frame(Conn& c){
+    std::vector<uint8_t> body;
+    if (!recv_body(c, body)) return std::nullopt;
+    return parse_body_to_frame(body);
+}
+
+} // namespace rpc
@@ -0,0 +1,741 @@
+#include "rpc/uring_reactor.h"
+#include "rpc/buffer_pool.h"
+#include <stdexcept>
+
+#if defined(__linux__) && defined(TINY_RPC_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace rpc {
+
+// =====================================================
+// UringReactor: io_uring 事件循环
+// 主循环：
+//   1) 把本轮产生了响应的连接逐个准备发送 SQE（每连接同时只有一个发送在途，保证字节顺序）
+//   2) io_uring_enter：提交全部 SQE 并等待至少一个完成事件（一次系统调用）
+//   3) 处理完成事件：accept → 新连接 + 挂多发 recv；recv → 原地切帧、回调、归还缓冲区；
+//      send → 续发剩余字节或释放固定缓冲区；wake → 取走其它线程 post 的响应
+//
+// user_data 编码：高 8 位为操作类型，低 56 位为连接 id（accept/wake 为 0）
+//
+// 背压：待发送（out + 发送中）超过 OUT_HIGH_WATER 时停止切帧，并取消该连接的多发 recv；
+// 取消生效前到达的数据只拷进 c.in。发送完成后降到 OUT_LOW_WATER 以下再切 c.in 里的帧、重新挂 recv
+//
+// 关闭连接：先 shutdown(fd)，让在途的 recv/send 以出错或 0 字节结束，
+// 等该连接不再有在途操作后才 close(fd) 并释放缓冲区（内核可能还在读写它们）
+// =====================================================
+
+static constexpr unsigned SQ_ENTRIES     = 1024;
+static constexpr unsigned CQ_ENTRIES     = 8192;     // 多发操作一个 SQE 产生多个 CQE
+static constexpr unsigned RECV_BUFS      = 256;      // 提供缓冲环大小（2 的幂）
+static constexpr size_t   RECV_BUF_SIZE  = 16 * 1024;
+static constexpr uint16_t RECV_BGID      = 0;
+static constexpr unsigned SEND_SLABS     = 64;       // 预登记的固定发送缓冲区
+static constexpr size_t   SEND_SLAB_SIZE = 64 * 1024;
+static constexpr size_t   OUT_HIGH_WATER = 4u << 20;   // 待发送超过它就暂停接收
+static constexpr size_t   OUT_LOW_WATER  = 1u << 20;   // 降到它以下恢复接收
+
+enum : uint64_t {
+    OP_ACCEPT = 1,
+    OP_RECV   = 2,
+    OP_SEND   = 3,
+    OP_WAKE   = 4,
+    OP_CANCEL = 5,
+};
+static constexpr int      OP_SHIFT = 56;
+static constexpr uint64_t ID_MASK  = (uint64_t(1) << OP_SHIFT) - 1;
+
+static uint64_t tag(uint64_t op, uint64_t id){ return (op << OP_SHIFT) | (id & ID_MASK); }
+
+static int sys_io_uring_setup(unsigned entries, io_uring_params* p){
+    return (int)::syscall(__NR_io_uring_setup, entries, p);
+}
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags){
+    return (int)::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+static int sys_io_uring_register(int fd, unsigned op, void* arg, unsigned nr){
+    return (int)::syscall(__NR_io_uring_register, fd, op, arg, nr);
+}
+
+static uint32_t get_u32_be(const uint8_t* p){
+    return (uint32_t(p[0])<<24)|(uint32_t(p[1])<<16)|(uint32_t(p[2])<<8)|uint32_t(p[3]);
+}
+
+struct UringReactor::Impl {
+    struct Conn {
+        socket_t fd{INVALID_SOCKET_T};
+        uint64_t id{0};
+        std::vector<uint8_t> in;        // 跨缓冲区的半帧
+        std::vector<uint8_t> out;       // 待发送（下一次提交）
+        std::vector<uint8_t> sending;   // 非固定缓冲区发送中的字节（响应超过一个 slab 时）
+        int slab{-1};                   // 固定缓冲区发送中的槽位
+        size_t send_off{0}, send_len{0};
+        bool recv_armed{false};
+        bool send_inflight{false};
+        bool eof{false};                // 对端已关闭写方向：发完剩余响应、异步回包都到齐后关闭
+        uint32_t holds{0};              // 尚未回包的异步任务（hold - unhold）
+        bool closing{false};
+        bool queued{false};             // 已在 dirty_ 中
+        bool paused{false};             // 背压：暂停切帧，recv 已取消或取消中
+
+        size_t pending() const { return out.size() + (send_inflight ? send_len - send_off : 0); }
+    };
+
+    socket_t listen_fd;
+    FrameHandler on_frame;
+    CloseHandler on_close;
+    IoCounters* io{nullptr};
+
+    int ring_fd{-1};
+    void* sq_ptr{MAP_FAILED};
+    void* cq_ptr{MAP_FAILED};
+    size_t sq_len{0}, cq_len{0};
+    io_uring_sqe* sqes{static_cast<io_uring_sqe*>(MAP_FAILED)};
+    size_t sqes_len{0};
+    unsigned *sq_head{}, *sq_tail{}, *sq_mask{}, *sq_array{};
+    unsigned *cq_head{}, *cq_tail{}, *cq_mask{};
+    io_uring_cqe* cqes{};
+    unsigned sq_local_tail{0};
+    unsigned to_submit{0};
+
+    // 提供缓冲环按 io_uring_buf 数组访问：C++ 下 io_uring_buf_ring::bufs 的柔性数组声明
+    // 会被挪到偏移 8，与内核布局不符；环尾 tail 与 bufs[0].resv 共用同一位置
+    io_uring_buf* br{static_cast<io_uring_buf*>(MAP_FAILED)};
+    size_t br_len{0};
+    uint8_t* recv_bufs{static_cast<uint8_t*>(MAP_FAILED)};
+    uint16_t br_tail{0};
+
+    uint8_t* send_slabs{static_cast<uint8_t*>(MAP_FAILED)};
+    std::vector<int> free_slabs;
+
+    int wake_fd{-1};
+    uint64_t wake_buf{0};
+
+    uint64_t next_conn_id{1};
+    std::unordered_map<uint64_t, Conn> conns;     // 按 id（fd 会被复用）
+    std::vector<uint64_t> dirty;                  // 本轮有待发送字节的连接
+
+    struct Posted {
+        ConnRef conn;
+        std::vector<uint8_t> bytes;
+        bool unhold{false};                       // unhold() 的登记（bytes 为空）
+    };
+    std::mutex post_mu;                           // 保护 posted 与 tasks
+    std::vector<Posted> posted;
+    std::vector<std::function<void()>> tasks;
+    // on_wake_cqe 与上面两个队列交换用的空队列（只在事件循环线程访问），容量来回复用
+    std::vector<Posted> wake_batch;
+    std::vector<std::function<void()>> wake_tasks;
+
+    Impl(socket_t lfd, FrameHandler h) : listen_fd(lfd), on_frame(std::move(h)) {}
+    ~Impl();
+
+    void setup();
+    void probe_multishot_recv();
+    void note_syscall(){ if (io) io->syscalls.fetch_add(1, std::memory_order_relaxed); }
+    void wake();
+
+    io_uring_sqe* get_sqe();
+    void submit_and_wait(unsigned wait_nr);
+    void recycle(uint16_t bid);
+
+    void arm_accept();
+    void arm_wake();
+    void arm_recv(Conn& c);
+    void mark_dirty(Conn& c);
+    void start_send(Conn& c);
+    void flush_dirty();
+
+    void on_accept_cqe(const io_uring_cqe& cqe);
+    void on_recv_cqe(Conn& c, const io_uring_cqe& cqe);
+    void on_send_cqe(Conn& c, int res);
+    void on_wake_cqe();
+    void consume(Conn& c, const uint8_t* data, size_t n);
+    void pause_recv(Conn& c);
+    void maybe_resume(Conn& c);
+    void begin_close(Conn& c);
+    void maybe_finish_close(uint64_t id);
+
+    void run();
+};
+
+UringReactor::Impl::~Impl(){
+    for (auto& kv : conns) CLOSESOCK(kv.second.fd);
+    if (wake_fd >= 0) ::close(wake_fd);
+    if (ring_fd >= 0) ::close(ring_fd);   // 先关 ring：内核不再引用下面的缓冲区
+    if (sqes != MAP_FAILED) ::munmap(sqes, sqes_len);
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) ::munmap(cq_ptr, cq_len);
+    if (sq_ptr != MAP_FAILED) ::munmap(sq_ptr, sq_len);
+    if (br != MAP_FAILED) ::munmap(br, br_len);
+    if (recv_bufs != MAP_FAILED) ::munmap(recv_bufs, RECV_BUFS * RECV_BUF_SIZE);
+    if (send_slabs != MAP_FAILED) ::munmap(send_slabs, SEND_SLABS * SEND_SLAB_SIZE);
+}
+
+// =====================================================
+// setup()
+//   - io_uring_setup（单一提交线程 + 协作式任务运行，减少内核打断；老内核去掉这些标志重试）
+//   - 映射 SQ/CQ 环与 SQE 数组
+//   - 登记提供缓冲环（多发 recv 从中取缓冲区）与固定发送缓冲区
+//   - 试探多发 recv 是否可用（见 probe_multishot_recv）
+// 失败：throw runtime_error（内核太老、被 seccomp 禁用等），调用方回退 epoll
+// =====================================================
+void UringReactor::Impl::setup(){
+    io_uring_params p{};
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    p.cq_entries = CQ_ENTRIES;
+    ring_fd = sys_io_uring_setup(SQ_ENTRIES, &p);
+    if (ring_fd < 0 && errno == EINVAL){
+        p = io_uring_params{};
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = CQ_ENTRIES;
+        ring_fd = sys_io_uring_setup(SQ_ENTRIES, &p);
+    }
+    if (ring_fd < 0) throw std::runtime_error(std::string("io_uring_setup: ") + std::strerror(errno));
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP))
+        throw std::runtime_error("io_uring: kernel too old");
+
+    sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    sq_len = cq_len = std::max(sq_len, cq_len);
+    sq_ptr = ::mmap(nullptr, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) throw std::runtime_error("io_uring: mmap rings");
+    cq_ptr = sq_ptr;
+    sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) throw std::runtime_error("io_uring: mmap sqes");
+
+    auto* sq = static_cast<uint8_t*>(sq_ptr);
+    sq_head  = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sq_tail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sq_mask  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    cq_head  = reinterpret_cast<unsigned*>(sq + p.cq_off.head);
+    cq_tail  = reinterpret_cast<unsigned*>(sq + p.cq_off.tail);
+    cq_mask  = reinterpret_cast<unsigned*>(sq + p.cq_off.ring_mask);
+    cqes     = reinterpret_cast<io_uring_cqe*>(sq + p.cq_off.cqes);
+    for (unsigned i = 0; i < p.sq_entries; ++i) sq_array[i] = i;   // SQE 下标与环位置一一对应
+    sq_local_tail = *sq_tail;
+
+    // 提供缓冲环：环本身 + RECV_BUFS 个接收缓冲区
+    br_len = RECV_BUFS * sizeof(io_uring_buf);
+    br = static_cast<io_uring_buf*>(::mmap(nullptr, br_len, PROT_READ | PROT_WRITE,
+                                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    recv_bufs = static_cast<uint8_t*>(::mmap(nullptr, RECV_BUFS * RECV_BUF_SIZE, PROT_READ | PROT_WRITE,
+                                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (br == MAP_FAILED || recv_bufs == MAP_FAILED) throw std::runtime_error("io_uring: mmap buffers");
+    io_uring_buf_reg reg{};
+    reg.ring_addr = (uint64_t)(uintptr_t)br;
+    reg.ring_entries = RECV_BUFS;
+    reg.bgid = RECV_BGID;
+    if (sys_io_uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        throw std::runtime_error(std::string("io_uring: register buffer ring: ") + std::strerror(errno));
+    for (unsigned i = 0; i < RECV_BUFS; ++i) recycle((uint16_t)i);
+    probe_multishot_recv();
+
+    // 固定发送缓冲区
+    send_slabs = static_cast<uint8_t*>(::mmap(nullptr, SEND_SLABS * SEND_SLAB_SIZE, PROT_READ | PROT_WRITE,
+                                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (send_slabs == MAP_FAILED) throw std::runtime_error("io_uring: mmap send slabs");
+    std::vector<iovec> iov(SEND_SLABS);
+    for (unsigned i = 0; i < SEND_SLABS; ++i){
+        iov[i].iov_base = send_slabs + i * SEND_SLAB_SIZE;
+        iov[i].iov_len = SEND_SLAB_SIZE;
+        free_slabs.push_back((int)(SEND_SLABS - 1 - i));
+    }
+    if (sys_io_uring_register(ring_fd, IORING_REGISTER_BUFFERS, iov.data(), SEND_SLABS) < 0)
+        throw std::runtime_error(std::string("io_uring: register buffers: ") + std::strerror(errno));
+
+    // io_uring 对 O_NONBLOCK 的 fd 直接返回 EAGAIN，因此 eventfd 保持阻塞模式
+    wake_fd = ::eventfd(0, EFD_CLOEXEC);
+    if (wake_fd < 0) die("eventfd");
+}
+
+// =====================================================
+// probe_multishot_recv()
+//   提供缓冲环要 5.19，多发 recv 要 6.0：5.19 上环能登记成功，但每个 recv 完成事件都是
+//   -EINVAL，所有连接都会被关掉。在 socketpair 上挂一个多发 recv 试一次：
+//   对端写 1 字节后关闭，应先收到带 IORING_CQE_F_MORE 的数据完成事件，再收到结束事件
+// 失败：throw runtime_error，调用方回退 epoll
+// =====================================================
+void UringReactor::Impl::probe_multishot_recv(){
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+        throw std::runtime_error(std::string("io_uring: probe socketpair: ") + std::strerror(errno));
+    char b = 0;
+    bool wrote = ::write(sv[1], &b, 1) == 1;
+    ::close(sv[1]);
+    if (!wrote){
+        ::close(sv[0]);
+        throw std::runtime_error("io_uring: probe write");
+    }
+
+    io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = sv[0];
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BGID;
+    sqe->user_data = tag(OP_RECV, 0);       // 连接 id 从 1 开始，不会混淆
+
+    // 收到不带 F_MORE 的完成事件为止（出错或读到对端关闭都会结束多发）
+    bool ok = false, done = false;
+    int err = 0;
+    while (!done){
+        submit_and_wait(1);
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head){
+            const io_uring_cqe& cqe = cqes[head & *cq_mask];
+            if (cqe.flags & IORING_CQE_F_BUFFER) recycle((uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+            if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_MORE)) ok = true;
+            if (cqe.res < 0) err = -cqe.res;
+            if (!(cqe.flags & IORING_CQE_F_MORE)) done = true;
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+    ::close(sv[0]);
+    if (!ok)
+        throw std::runtime_error(std::string("io_uring: multishot recv unsupported") +
+                                 (err ? std::string(": ") + std::strerror(err) : std::string()));
+}
+
+// 取一个空闲 SQE；SQ 已满时先把已准备好的提交掉（不等待）
+io_uring_sqe* UringReactor::Impl::get_sqe(){
+    while (sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) > *sq_mask){
+        __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+        note_syscall();
+        int r = sys_io_uring_enter(ring_fd, to_submit, 0, 0);
+        if (r < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN) die("io_uring_enter");
+        if (r > 0) to_submit -= std::min<unsigned>(to_submit, (unsigned)r);
+    }
+    io_uring_sqe* sqe = &sqes[sq_local_tail & *sq_mask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++sq_local_tail;
+    ++to_submit;
+    return sqe;
+}
+
+// 提交全部待提交的 SQE 并等待至少 wait_nr 个完成事件：一次系统调用
+void UringReactor::Impl::submit_and_wait(unsigned wait_nr){
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    while (true){
+        note_syscall();
+        int r = sys_io_uring_enter(ring_fd, to_submit, wait_nr, IORING_ENTER_GETEVENTS);
+        if (r >= 0){
+            to_submit -= std::min<unsigned>(to_submit, (unsigned)r);
+            return;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EBUSY || errno == EAGAIN) return;   // CQ 积压：先去收割完成事件
+        die("io_uring_enter");
+    }
+}
+
+// 把接收缓冲区 bid 还给提供缓冲环
+void UringReactor::Impl::recycle(uint16_t bid){
+    io_uring_buf* b = &br[br_tail & (RECV_BUFS - 1)];
+    b->addr = (uint64_t)(uintptr_t)(recv_bufs + (size_t)bid * RECV_BUF_SIZE);
+    b->len = (uint32_t)RECV_BUF_SIZE;
+    b->bid = bid;
+    ++br_tail;
+    __atomic_store_n(&br[0].resv, br_tail, __ATOMIC_RELEASE);
+}
+
+void UringReactor::Impl::arm_accept(){
+    io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;       // 不带 SOCK_NONBLOCK：见 setup() 中 eventfd 的说明
+    sqe->user_data = tag(OP_ACCEPT, 0);
+}
+
+void UringReactor::Impl::arm_wake(){
+    io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wake_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&wake_buf;
+    sqe->len = sizeof(wake_buf);
+    sqe->user_data = tag(OP_WAKE, 0);
+}
+
+void UringReactor::Impl::arm_recv(Conn& c){
+    io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c.fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BGID;
+    sqe->user_data = tag(OP_RECV, c.id);
+    c.recv_armed = true;
+}
+
+void UringReactor::Impl::mark_dirty(Conn& c){
+    if (c.queued || c.out.empty()) return;
+    c.queued = true;
+    dirty.push_back(c.id);
+}
+
+// 发出 c.out：放得进一个固定缓冲区就拷进去用 WRITE_FIXED，否则整段移到 sending 用 SEND
+void UringReactor::Impl::start_send(Conn& c){
+    if (c.send_inflight || c.closing || c.out.empty()) return;
+    io_uring_sqe* sqe = get_sqe();
+    if (c.out.size() <= SEND_SLAB_SIZE && !free_slabs.empty()){
+        c.slab = free_slabs.back();
+        free_slabs.pop_back();
+        uint8_t* dst = send_slabs + (size_t)c.slab * SEND_SLAB_SIZE;
+        std::memcpy(dst, c.out.data(), c.out.size());
+        c.send_len = c.out.size();
+        c.out.clear();
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->addr = (uint64_t)(uintptr_t)dst;
+        sqe->buf_index = (uint16_t)c.slab;
+    }else{
+        c.sending.swap(c.out);
+        c.out.clear();
+        c.send_len = c.sending.size();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->addr = (uint64_t)(uintptr_t)c.sending.data();
+        sqe->msg_flags = MSG_NOSIGNAL;
+    }
+    c.send_off = 0;
+    sqe->fd = c.fd;
+    sqe->len = (uint32_t)c.send_len;
+    sqe->user_data = tag(OP_SEND, c.id);
+    c.send_inflight = true;
+}
+
+void UringReactor::Impl::flush_dirty(){
+    for (uint64_t id : dirty){
+        auto it = conns.find(id);
+        if (it == conns.end()) continue;
+        it->second.queued = false;
+        start_send(it->second);
+    }
+    dirty.clear();
+}
+
+void UringReactor::Impl::on_accept_cqe(const io_uring_cqe& cqe){
+    if (!(cqe.flags & IORING_CQE_F_MORE)) arm_accept();     // 多发 accept 被内核终止：重新挂上
+    if (cqe.res < 0){
+        if (cqe.res != -EINTR && cqe.res != -ECONNABORTED && cqe.res != -EAGAIN)
+            std::cerr << "[uring] accept: " << std::strerror(-cqe.res) << "\n";
+        return;
+    }
+    uint64_t id = next_conn_id++;
+    Conn& c = conns[id];
+    c.fd = cqe.res;
+    c.id = id;
+    c.in  = BufferPool::acquire();
+    c.out = BufferPool::acquire();
+    arm_recv(c);
+    if (io){
+        io->connections.fetch_add(1, std::memory_order_relaxed);
+        io->accepted.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// =====================================================
+// consume(c, data, n)
+//   c.in 为空时直接在内核填好的缓冲区里切帧（视图指向提供缓冲区，回调返回前不归还），
+//   只把结尾的半帧拷进 c.in；否则先拼到 c.in 再切
+//   暂停中只收下数据；切帧前发现待发送超过 OUT_HIGH_WATER 则暂停，余下的留在 c.in
+// 失败：长度前缀过大或帧解析失败 → throw（调用方关闭连接）
+// =====================================================
+void UringReactor::Impl::consume(Conn& c, const uint8_t* data, size_t n){
+    if (c.paused){
+        c.in.insert(c.in.end(), data, data + n);
+        return;
+    }
+    const uint8_t* p = data;
+    size_t len = n;
+    if (!c.in.empty()){
+        c.in.insert(c.in.end(), data, data + n);
+        p = c.in.data();
+        len = c.in.size();
+    }
+    size_t off = 0;
+    size_t out_before = c.out.size();
+    while (len - off >= 4){
+        if (c.pending() >= OUT_HIGH_WATER){ pause_recv(c); break; }
+        uint32_t body_len = get_u32_be(p + off);
+        if (body_len > MAX_BODY_LEN) throw std::runtime_error("frame too large");
+        if (len - off - 4 < body_len) break;
+        RawFrameView rf = parse_body_to_view(p + off + 4, body_len);
+        off += 4 + body_len;
+        on_frame(ConnRef{c.fd, c.id}, rf, c.out);
+    }
+    if (p == data) c.in.assign(data + off, data + n);
+    else if (off) c.in.erase(c.in.begin(), c.in.begin() + (std::ptrdiff_t)off);
+    if (c.out.size() != out_before) mark_dirty(c);
+}
+
+// 暂停接收：取消在途的多发 recv（最终完成事件带 -ECANCELED），暂停期间不再重新挂上
+void UringReactor::Impl::pause_recv(Conn& c){
+    c.paused = true;
+    if (!c.recv_armed) return;
+    io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = tag(OP_RECV, c.id);
+    sqe->user_data = tag(OP_CANCEL, c.id);
+}
+
+// 待发送降到 OUT_LOW_WATER 以下：先切暂停期间收下的帧，仍未暂停再重新挂 recv
+void UringReactor::Impl::maybe_resume(Conn& c){
+    if (!c.paused || c.closing || c.pending() > OUT_LOW_WATER) return;
+    c.paused = false;
+    if (!c.in.empty()){
+        try{
+            consume(c, nullptr, 0);
+        }catch(const std::exception& e){
+            std::cerr << "[uring] protocol error fd=" << c.fd << ": " << e.what() << "\n";
+            begin_close(c);
+            return;
+        }
+        if (c.paused) return;
+    }
+    if (!c.recv_armed && !c.eof) arm_recv(c);
+}
+
+void UringReactor::Impl::on_recv_cqe(Conn& c, const io_uring_cqe& cqe){
+    bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+    if (!more) c.recv_armed = false;
+    if (cqe.res > 0){
+        uint16_t bid = (uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        if (io) io->bytes_in.fetch_add((uint64_t)cqe.res, std::memory_order_relaxed);
+        if (!c.closing){
+            try{
+                consume(c, recv_bufs + (size_t)bid * RECV_BUF_SIZE, (size_t)cqe.res);
+            }catch(const std::exception& e){
+                std::cerr << "[uring] protocol error fd=" << c.fd << ": " << e.what() << "\n";
+                begin_close(c);
+            }
+        }
+        recycle(bid);
+        if (!more && !c.closing && !c.paused) arm_recv(c);
+        return;
+    }
+    // 缓冲区暂时用尽（已处理的会陆续归还）或被 pause_recv 取消：未暂停就重新挂上
+    if (cqe.res == -ENOBUFS || cqe.res == -ECANCELED){
+        if (!more && !c.closing && !c.paused) arm_recv(c);
+        return;
+    }
+    // 0 = 对端关闭；其它负值 = 出错
+    if (cqe.res == 0 && !c.closing){
+        c.eof = true;
+        if (c.send_inflight || !c.out.empty() || c.holds) return;   // 先把已产生的响应与异步回包写完
+    }
+    begin_close(c);
+}
+
+void UringReactor::Impl::on_send_cqe(Conn& c, int res){
+    if (res > 0){
+        if (io) io->bytes_out.fetch_add((uint64_t)res, std::memory_order_relaxed);
+        c.send_off += (size_t)res;
+    }
+    if (res > 0 && c.send_off < c.send_len && !c.closing){
+        // 短写：从断点续发同一块
+        io_uring_sqe* sqe = get_sqe();
+        const uint8_t* base = c.slab >= 0 ? send_slabs + (size_t)c.slab * SEND_SLAB_SIZE : c.sending.data();
+        sqe->opcode = c.slab >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_SEND;
+        sqe->fd = c.fd;
+        sqe->addr = (uint64_t)(uintptr_t)(base + c.send_off);
+        sqe->len = (uint32_t)(c.send_len - c.send_off);
+        if (c.slab >= 0) sqe->buf_index = (uint16_t)c.slab;
+        else sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = tag(OP_SEND, c.id);
+        return;
+    }
+    c.send_inflight = false;
+    if (c.slab >= 0){
+        free_slabs.push_back(c.slab);
+        c.slab = -1;
+    }
+    c.sending.clear();
+    if (res <= 0){ begin_close(c); return; }
+    maybe_resume(c);
+    if (c.closing) return;
+    if (!c.out.empty()){ mark_dirty(c); return; }
+    if (c.eof && !c.holds) begin_close(c);
+}
+
+void UringReactor::Impl::on_wake_cqe(){
+    arm_wake();
+    {
+        std::lock_guard<std::mutex> lk(post_mu);
+        wake_tasks.swap(tasks);
+        wake_batch.swap(posted);
+    }
+    for (auto& fn : wake_tasks) fn();
+    wake_tasks.clear();
+    // 追加完的响应缓冲区还给池（多半是 worker 从池里取的）
+    // unhold：归还一个 hold，半关闭的连接若已无事可做则关闭
+    for (auto& item : wake_batch){
+        auto it = conns.find(item.conn.id);
+        if (item.unhold){
+            if (it == conns.end()) continue;
+            Conn& c = it->second;
+            if (c.holds) --c.holds;
+            if (c.eof && !c.holds && !c.closing && !c.send_inflight && c.out.empty()) begin_close(c);
+            continue;
+        }
+        if (it != conns.end() && !it->second.closing){
+            Conn& c = it->second;
+            c.out.insert(c.out.end(), item.bytes.begin(), item.bytes.end());
+            mark_dirty(c);
+        }
+        BufferPool::release(std::move(item.bytes));
+    }
+    wake_batch.clear();
+}
+
+// 关闭的第一步：shutdown 让在途操作尽快结束；真正的 close 在 maybe_finish_close
+void UringReactor::Impl::begin_close(Conn& c){
+    if (!c.closing){
+        c.closing = true;
+        ::shutdown(c.fd, SHUT_RDWR);
+        note_syscall();
+    }
+    maybe_finish_close(c.id);
+}
+
+void UringReactor::Impl::maybe_finish_close(uint64_t id){
+    auto it = conns.find(id);
+    if (it == conns.end()) return;
+    Conn& c = it->second;
+    if (!c.closing || c.recv_armed || c.send_inflight) return;
+    socket_t fd = c.fd;
+    CLOSESOCK(fd);
+    note_syscall();
+    BufferPool::release(std::move(c.in));
+    BufferPool::release(std::move(c.out));
+    conns.erase(it);
+    if (io) io->connections.fetch_sub(1, std::memory_order_relaxed);
+    if (on_close) on_close(ConnRef{fd, id});
+}
+
+void UringReactor::Impl::run(){
+    arm_accept();
+    arm_wake();
+    while (true){
+        flush_dirty();
+        submit_and_wait(1);
+
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail){
+            io_uring_cqe cqe = cqes[head & *cq_mask];
+            ++head;
+            uint64_t op = cqe.user_data >> OP_SHIFT;
+            uint64_t id = cqe.user_data & ID_MASK;
+            if (op == OP_ACCEPT){ on_accept_cqe(cqe); continue; }
+            if (op == OP_WAKE){ on_wake_cqe(); continue; }
+            if (op == OP_CANCEL) continue;    // 结果体现在被取消的 recv 的完成事件里
+
+            auto it = conns.find(id);
+            if (it == conns.end()){
+                // 连接已释放：只需归还可能带着的接收缓冲区
+                if (cqe.flags & IORING_CQE_F_BUFFER) recycle((uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+                continue;
+            }
+            if (op == OP_RECV) on_recv_cqe(it->second, cqe);
+            else if (op == OP_SEND) on_send_cqe(it->second, cqe.res);
+            maybe_finish_close(id);
+
+            // 一轮事件很多时及时推进 CQ 头，把位置让给内核
+            if ((head & 63) == 0) __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+UringReactor::UringReactor(socket_t listen_fd, FrameHandler on_frame)
+    : impl_(std::make_unique<Impl>(listen_fd, std::move(on_frame))) {
+    impl_->setup();
+}
+
+UringReactor::~UringReactor() = default;
+
+void UringReactor::run(){ impl_->run(); }
+void UringReactor::set_on_close(CloseHandler h){ impl_->on_close = std::move(h); }
+void UringReactor::set_io_counters(IoCounters* io){ impl_->io = io; }
+
+// 同 Reactor::post / dispatch：挂到队列后写 eventfd，由事件循环线程在 wake 完成事件中取走
+void UringReactor::post(ConnRef conn, std::vector<uint8_t> bytes){
+    bool first;
+    {
+        std::lock_guard<std::mutex> lk(impl_->post_mu);
+        first = impl_->posted.empty() && impl_->tasks.empty();
+        impl_->posted.push_back(Impl::Posted{conn, std::move(bytes)});
+    }
+    if (first) impl_->wake();
+}
+
+void UringReactor::hold(ConnRef conn){
+    auto it = impl_->conns.find(conn.id);
+    if (it != impl_->conns.end()) ++it->second.holds;
+}
+
+void UringReactor::unhold(ConnRef conn){
+    bool first;
+    {
+        std::lock_guard<std::mutex> lk(impl_->post_mu);
+        first = impl_->posted.empty() && impl_->tasks.empty();
+        impl_->posted.push_back(Impl::Posted{conn, {}, true});
+    }
+    if (first) impl_->wake();
+}
+
+void UringReactor::dispatch(std::function<void()> fn){
+    bool first;
+    {
+        std::lock_guard<std::mutex> lk(impl_->post_mu);
+        first = impl_->posted.empty() && impl_->tasks.empty();
+        impl_->tasks.push_back(std::move(fn));
+    }
+    if (first) impl_->wake();
+}
+
+void UringReactor::Impl::wake(){
+    uint64_t one = 1;
+    note_syscall();
+    ssize_t w = ::write(wake_fd, &one, sizeof(one));
+    (void)w;
+}
+
+} // namespace rpc
+
+#else  // 未启用 TINY_RPC_IO_URING 或非 Linux
+
+namespace rpc {
+
+struct UringReactor::Impl {};
+
+UringReactor::UringReactor(socket_t, FrameHandler){
+    throw std::runtime_error("io_uring support not compiled in (TINY_RPC_IO_URING)");
+}
+UringReactor::~UringReactor() = default;
+void UringReactor::run(){}
+void UringReactor::set_on_close(CloseHandler){}
+void UringReactor::set_io_counters(IoCounters*){}
+void UringReactor::post(ConnRef, std::vector<uint8_t>){}
+void UringReactor::hold(ConnRef){}
+void UringReactor::unhold(ConnRef){}
+void UringReactor::dispatch(std::function<void()>){}
+
+} // namespace rpc
+
+#endif
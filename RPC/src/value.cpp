@@ -1,20 +1,137 @@
 #include "rpc/value.h"
+#include "rpc/byteorder.h"
+#include "rpc/protocol.h"
+#include <new>
 #include <stdexcept>
 
 namespace rpc {
 
+static_assert(sizeof(Value) <= 48, "Value should stay compact");
+
+// =====================================================
+// Value 的构造/赋值/析构
+//   union 里同一时刻只有 type_ 对应的成员是活的：先 reset() 析构旧成员，再按新类型构造
+//   拷贝：pmr 容器拷贝时取默认资源（普通堆），副本不依赖原 Value 的 arena
+//   移动：保留原分配器，源对象变为无类型
+// =====================================================
+void Value::reset() noexcept {
+    switch (type_){
+    case ValueType::STRING:
+    case ValueType::BYTES:       str_.~Str();     break;
+    case ValueType::ARRAY:       arr_.~Array();   break;
+    case ValueType::MAP:         map_.~Map();     break;
+    case ValueType::INT64_ARRAY: i64s_.~Int64s(); break;
+    case ValueType::F64_ARRAY:   f64s_.~F64s();   break;
+    default: break;
+    }
+    type_ = ValueType{};
+    i64_ = 0;
+}
+
+void Value::construct_from(const Value& o){
+    switch (o.type_){
+    case ValueType::STRING:
+    case ValueType::BYTES:       new (&str_) Str(o.str_);      break;
+    case ValueType::ARRAY:       new (&arr_) Array(o.arr_);    break;
+    case ValueType::MAP:         new (&map_) Map(o.map_);      break;
+    case ValueType::INT64_ARRAY: new (&i64s_) Int64s(o.i64s_); break;
+    case ValueType::F64_ARRAY:   new (&f64s_) F64s(o.f64s_);   break;
+    case ValueType::DOUBLE:      f64_ = o.f64_;                break;
+    default:                     i64_ = o.i64_;                break;
+    }
+    type_ = o.type_;
+}
+
+void Value::construct_from(Value&& o) noexcept {
+    switch (o.type_){
+    case ValueType::STRING:
+    case ValueType::BYTES:       new (&str_) Str(std::move(o.str_));      break;
+    case ValueType::ARRAY:       new (&arr_) Array(std::move(o.arr_));    break;
+    case ValueType::MAP:         new (&map_) Map(std::move(o.map_));      break;
+    case ValueType::INT64_ARRAY: new (&i64s_) Int64s(std::move(o.i64s_)); break;
+    case ValueType::F64_ARRAY:   new (&f64s_) F64s(std::move(o.f64s_));   break;
+    case ValueType::DOUBLE:      f64_ = o.f64_;                           break;
+    default:                     i64_ = o.i64_;                           break;
+    }
+    type_ = o.type_;
+    o.reset();
+}
+
+Value::Value(const Value& o) : i64_(0) { construct_from(o); }
+Value::Value(Value&& o) noexcept : i64_(0) { construct_from(std::move(o)); }
+
+Value& Value::operator=(const Value& o){
+    if (this != &o){
+        Value tmp(o);                // 先拷贝：拷贝抛异常时 *this 不变
+        reset();
+        construct_from(std::move(tmp));
+    }
+    return *this;
+}
+
+Value& Value::operator=(Value&& o) noexcept {
+    if (this != &o){
+        reset();
+        construct_from(std::move(o));
+    }
+    return *this;
+}
+
+// =====================================================
+// 访问函数：检查类型后返回引用/视图
+// =====================================================
+static void expect_type(ValueType have, ValueType want, const char* what){
+    if (have != want) throw std::runtime_error(std::string("value is not ") + what);
+}
+
+int64_t Value::i64() const { expect_type(type_, ValueType::INT64, "int64"); return i64_; }
+double Value::f64() const { expect_type(type_, ValueType::DOUBLE, "double"); return f64_; }
+bool Value::boolean() const { expect_type(type_, ValueType::BOOL, "bool"); return i64_ != 0; }
+
+std::string_view Value::str() const {
+    if (type_ != ValueType::STRING && type_ != ValueType::BYTES)
+        throw std::runtime_error("value is not string/bytes");
+    return str_;
+}
+
+const Value::Array& Value::arr() const { expect_type(type_, ValueType::ARRAY, "array"); return arr_; }
+const Value::Map& Value::map() const { expect_type(type_, ValueType::MAP, "map"); return map_; }
+const Value::Int64s& Value::i64s() const { expect_type(type_, ValueType::INT64_ARRAY, "int64 array"); return i64s_; }
+const Value::F64s& Value::f64s() const { expect_type(type_, ValueType::F64_ARRAY, "f64 array"); return f64s_; }
+
 // =====================================================
 // Value 工厂函数
-// 功能：构造不同类型的 Value（INT64 / STRING）
-// 输入：int64_t 或 std::string
+// 功能：构造不同类型的 Value
+// 输入：对应类型的 C++ 值（容器按值传入，内部 move）；字符串拷贝到 mr 分配的内存
 // 输出：封装好的 Value 对象
 // 失败：无
 // =====================================================
 Value Value::make_int(int64_t v){
-    Value x; x.type = ValueType::INT64; x.i64 = v; return x;
+    Value x; x.type_ = ValueType::INT64; x.i64_ = v; return x;
+}
+Value Value::make_str(std::string_view s, std::pmr::memory_resource* mr){
+    Value x; new (&x.str_) Str(s, mr); x.type_ = ValueType::STRING; return x;
+}
+Value Value::make_double(double v){
+    Value x; x.type_ = ValueType::DOUBLE; x.f64_ = v; return x;
+}
+Value Value::make_bool(bool v){
+    Value x; x.type_ = ValueType::BOOL; x.i64_ = v ? 1 : 0; return x;
+}
+Value Value::make_bytes(std::string_view b, std::pmr::memory_resource* mr){
+    Value x; new (&x.str_) Str(b, mr); x.type_ = ValueType::BYTES; return x;
+}
+Value Value::make_array(Array a){
+    Value x; new (&x.arr_) Array(std::move(a)); x.type_ = ValueType::ARRAY; return x;
 }
-Value Value::make_str(std::string s){
-    Value x; x.type = ValueType::STRING; x.str = std::move(s); return x;
+Value Value::make_map(Map m){
+    Value x; new (&x.map_) Map(std::move(m)); x.type_ = ValueType::MAP; return x;
+}
+Value Value::make_i64_array(Int64s a){
+    Value x; new (&x.i64s_) Int64s(std::move(a)); x.type_ = ValueType::INT64_ARRAY; return x;
+}
+Value Value::make_f64_array(F64s a){
+    Value x; new (&x.f64s_) F64s(std::move(a)); x.type_ = ValueType::F64_ARRAY; return x;
 }
 
 // =====================================================
@@ -28,24 +145,124 @@ Value Value::make_str(std::string s){
 // =====================================================
 int64_t as_i64(const std::vector<Value>& a, size_t i){
     if (i >= a.size()) throw std::runtime_error("missing arg");
-    if (a[i].type != ValueType::INT64) throw std::runtime_error("arg type not int64");
-    return a[i].i64;
+    if (a[i].type() != ValueType::INT64) throw std::runtime_error("arg type not int64");
+    return a[i].i64();
 }
 
 // =====================================================
 // as_str(args, i)
 // 功能：从参数数组中第 i 个位置读取 string
 // 输入：a 参数向量，i 位置
-// 输出：std::string（值返回，会拷贝一次）
+// 输出：指向 a[i] 内容的 string_view（不拷贝；需要保存时自行转成 std::string）
 // 失败：
 //   - i 越界 → throw runtime_error("missing arg")
 //   - 类型不为 STRING → throw runtime_error("arg type not string")
-// 说明：当前按值返回，简单直接；如需减少拷贝，见下方“可选优化”。
 // =====================================================
-std::string as_str(const std::vector<Value>& a, size_t i){
+std::string_view as_str(const std::vector<Value>& a, size_t i){
+    if (i >= a.size()) throw std::runtime_error("missing arg");
+    if (a[i].type() != ValueType::STRING) throw std::runtime_error("arg type not string");
+    return a[i].str();
+}
+
+// =====================================================
+// as_f64 / as_bool(args, i)
+// 功能：读取 DOUBLE / BOOL 参数，检查同上
+// =====================================================
+double as_f64(const std::vector<Value>& a, size_t i){
+    if (i >= a.size()) throw std::runtime_error("missing arg");
+    if (a[i].type() != ValueType::DOUBLE) throw std::runtime_error("arg type not double");
+    return a[i].f64();
+}
+
+bool as_bool(const std::vector<Value>& a, size_t i){
+    if (i >= a.size()) throw std::runtime_error("missing arg");
+    if (a[i].type() != ValueType::BOOL) throw std::runtime_error("arg type not bool");
+    return a[i].boolean();
+}
+
+// =====================================================
+// ValueView::to_value()
+// 功能：把视图物化为拥有内存的 Value
+//   - STRING/BYTES 拷贝一次内容
+//   - 定长数组一次 resize + 批量字节序转换
+//   - ARRAY/MAP 对 raw 递归解码
+// =====================================================
+Value ValueView::to_value(std::pmr::memory_resource* mr) const {
+    switch (type){
+    case ValueType::INT64:  return Value::make_int(i64);
+    case ValueType::STRING: return Value::make_str(str, mr);
+    case ValueType::BYTES:  return Value::make_bytes(str, mr);
+    case ValueType::DOUBLE: return Value::make_double(f64);
+    case ValueType::BOOL:   return Value::make_bool(i64 != 0);
+    case ValueType::INT64_ARRAY: {
+        Value::Int64s a(count, mr);
+        load_be64_array(a.data(), (const uint8_t*)str.data(), count);
+        return Value::make_i64_array(std::move(a));
+    }
+    case ValueType::F64_ARRAY: {
+        Value::F64s a(count, mr);
+        load_be64_array(a.data(), (const uint8_t*)str.data(), count);
+        return Value::make_f64_array(std::move(a));
+    }
+    case ValueType::ARRAY:
+    case ValueType::MAP:
+        return decode_value((const uint8_t*)raw.data(), raw.size(), ver, mr).first;
+    }
+    throw std::runtime_error("unknown ValueType");
+}
+
+// =====================================================
+// as_i64 / as_str_view（视图版本）
+// 功能：与上面相同的越界/类型检查，但字符串以 string_view 返回，不分配内存
+// 注意：返回的 string_view 只在本次 handler 调用期间有效
+// =====================================================
+int64_t as_i64(const std::vector<ValueView>& a, size_t i){
+    if (i >= a.size()) throw std::runtime_error("missing arg");
+    if (a[i].type != ValueType::INT64) throw std::runtime_error("arg type not int64");
+    return a[i].i64;
+}
+
+std::string_view as_str_view(const std::vector<ValueView>& a, size_t i){
     if (i >= a.size()) throw std::runtime_error("missing arg");
     if (a[i].type != ValueType::STRING) throw std::runtime_error("arg type not string");
     return a[i].str;
 }
 
+double as_f64(const std::vector<ValueView>& a, size_t i){
+    if (i >= a.size()) throw std::runtime_error("missing arg");
+    if (a[i].type != ValueType::DOUBLE) throw std::runtime_error("arg type not double");
+    return a[i].f64;
+}
+
+bool as_bool(const std::vector<ValueView>& a, size_t i){
+    if (i >= a.size()) throw std::runtime_error("missing arg");
+    if (a[i].type != ValueType::BOOL) throw std::runtime_error("arg type not bool");
+    return a[i].i64 != 0;
+}
+
+std::string_view as_bytes_view(const std::vector<ValueView>& a, size_t i){
+    if (i >= a.size()) throw std::runtime_error("missing arg");
+    if (a[i].type != ValueType::BYTES) throw std::runtime_error("arg type not bytes");
+    return a[i].str;
+}
+
+// =====================================================
+// copy_i64_array / copy_f64_array(args, i, out)
+// 功能：把定长数组视图批量转换到 out（resize 一次，不逐个 push_back）
+//       out 可跨请求复用，容量足够时不分配
+// =====================================================
+void copy_i64_array(const std::vector<ValueView>& a, size_t i, std::vector<int64_t>& out){
+    if (i >= a.size()) throw std::runtime_error("missing arg");
+    if (a[i].type != ValueType::INT64_ARRAY) throw std::runtime_error("arg type not int64 array");
+    out.resize(a[i].count);
+    load_be64_array(out.data(), (const uint8_t*)a[i].str.data(), a[i].count);
+}
+
+void copy_f64_array(const std::vector<ValueView>& a, size_t i, std::vector<double>& out){
+    if (i >= a.size()) throw std::runtime_error("missing arg");
+    if (a[i].type != ValueType::F64_ARRAY) throw std::runtime_error("arg type not f64 array");
+    out.resize(a[i].count);
+    load_be64_array(out.data(), (const uint8_t*)a[i].str.data(), a[i].count);
+}
+
 } // namespace rpc